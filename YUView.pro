@@ -13,6 +13,7 @@ SOURCES += \
     source/fileInfoWidget.cpp \
     source/fileSource.cpp \
     source/fileSourceHEVCAnnexBFile.cpp \
+    source/frameDiskCache.cpp \
     source/frameHandler.cpp \
     source/mainwindow.cpp \
     source/playbackController.cpp \
@@ -36,6 +37,7 @@ SOURCES += \
     source/showColorFrame.cpp \
     source/splitViewWidget.cpp \
     source/statisticHandler.cpp \
+    source/statisticsBinaryFile.cpp \
     source/statisticsExtensions.cpp \
     source/statisticsstylecontrol.cpp \
     source/statisticsStyleControl_ColorMapEditor.cpp \
@@ -47,9 +49,11 @@ SOURCES += \
     source/videoHandlerRGB.cpp \
     source/videoHandlerYUV.cpp \
     source/viewStateHandler.cpp \
+    source/yuvConversionSIMD.cpp \
     source/yuviewapp.cpp
 
 HEADERS += \
+    source/cachingDecoderPool.h \
     source/de265Decoder.h \
     source/FFmpegDecoder.h \
     source/FFMpegDecoderLibHandling.h \
@@ -57,6 +61,7 @@ HEADERS += \
     source/fileInfoWidget.h \
     source/fileSource.h \
     source/fileSourceHEVCAnnexBFile.h \
+    source/frameDiskCache.h \
     source/frameHandler.h \
     source/labelElided.h \
     source/mainwindow.h \
@@ -82,6 +87,7 @@ HEADERS += \
     source/signalsSlots.h \
     source/splitViewWidget.h \
     source/statisticHandler.h \
+    source/statisticsBinaryFile.h \
     source/statisticsExtensions.h \
     source/statisticsstylecontrol.h \
     source/statisticsStyleControl_ColorMapEditor.h \
@@ -93,6 +99,7 @@ HEADERS += \
     source/videoHandlerRGB.h \
     source/videoHandlerYUV.h \
     source/viewStateHandler.h \
+    source/yuvConversionSIMD.h \
     source/yuviewapp.h
 
 FORMS += \
@@ -34,11 +34,14 @@
 
 #include <cstring>
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDateTime>
 #include <QDir>
-#include <QProgressDialog>
+#include <QSaveFile>
 #include <QSettings>
-#include "mainwindow.h"
+#include <QStandardPaths>
+#include <QtConcurrent>
 #include "typedef.h"
 
 using namespace FFmpeg;
@@ -51,6 +54,9 @@ using namespace FFmpeg;
 #define DEBUG_FFMPEG(fmt,...) ((void)0)
 #endif
 
+// Increase this if the format of the saved key frame index changes
+#define FFMPEG_FRAME_INDEX_VERSION 1
+
 FFmpegDecoder::FFmpegDecoder()
 {
   // No error (yet)
@@ -63,12 +69,14 @@ FFmpegDecoder::FFmpegDecoder()
   videoCodec = nullptr;
   decCtx = nullptr;
   frame = nullptr;
-  nrFrames = -1;
+  index.reset(new frameIndex);
+  cancelBackgroundScan.store(0);
   endOfFile = false;
   frameRate = -1;
   colorConversionType = BT709;
   pkt = nullptr;
   streamCodecID = AV_CODEC_ID_NONE;
+  usedForCaching = false;
 
   // Initialize the file watcher and install it (if enabled)
   fileChanged = false;
@@ -84,6 +92,8 @@ FFmpegDecoder::FFmpegDecoder()
 
 FFmpegDecoder::~FFmpegDecoder()
 {
+  stopBackgroundScan();
+
   // Free all the allocated data structures
   if (pkt)
   {
@@ -183,6 +193,19 @@ bool FFmpegDecoder::openFile(QString fileName, FFmpegDecoder *otherDec)
   AVDictionary *opts = nullptr;
   ff.av_dict_set(&opts, "flags2", "+export_mvs", 0);
 
+  // Let libavcodec decode with multiple threads (frame and slice threading). The number of threads is the same
+  // setting that is used for libde265. The caching decoders already decode in parallel, so they share these threads.
+  QSettings settings;
+  settings.beginGroup("VideoCache");
+  int nrThreads = settings.value("DecoderThreads", getOptimalThreadCount()).toInt();
+  settings.endGroup();
+  if (usedForCaching)
+    nrThreads /= qMax(int(getOptimalThreadCount()), 1);
+  // 0 threads would mean that libavcodec selects the number of threads automatically
+  nrThreads = qMax(nrThreads, 1);
+  ff.av_dict_set(&opts, "threads", QString::number(nrThreads).toLatin1().constData(), 0);
+  ff.av_dict_set(&opts, "thread_type", "frame+slice", 0);
+
   // Open codec
   ret = ff.avcodec_open2(decCtx, videoCodec, &opts);
   if (ret < 0)
@@ -194,14 +217,21 @@ bool FFmpegDecoder::openFile(QString fileName, FFmpegDecoder *otherDec)
     return setOpeningError(QStringLiteral("Could not allocate frame (av_frame_alloc)."));
 
   if (otherDec)
+    // Use the key frame index of the other decoder. If it is still scanned in the background, new key frames will show up here as well.
+    index = otherDec->index;
+  else if (!loadFrameIndex())
   {
-    // Copy the key picture list and nrFrames from the other decoder
-    keyFrameList = otherDec->keyFrameList;
-    nrFrames = otherDec->nrFrames;
-  }
-  else
-    if (!scanBitstream())
+    // Scan the file in the background. Decoding can start as soon as the first key frame is known.
+    index->scanRunning = true;
+    cancelBackgroundScan.storeRelease(0);
+    backgroundScanFuture = QtConcurrent::run(this, &FFmpegDecoder::scanBitstreamInBackground);
+
+    QMutexLocker locker(&index->mutex);
+    while (index->keyFrameList.isEmpty() && index->scanRunning)
+      index->keyFramesAdded.wait(&index->mutex);
+    if (index->keyFrameList.isEmpty())
       return setOpeningError(QStringLiteral("Error scanning bitstream for key pictures."));
+  }
 
   // Initialize an empty packet
   assert(pkt == nullptr);
@@ -526,110 +556,198 @@ void FFmpegDecoder::loadFFmpegLibraries()
   errorString = ff.libErrorString();
 }
 
-bool FFmpegDecoder::scanBitstream()
+bool FFmpegDecoder::scanBitstream(AVFormatContext *scanCtx)
 {
   // Seek to the beginning of the stream.
   // The stream should be at the beginning when calling this function, but it does not hurt.
-  int ret = ff.av_seek_frame(fmt_ctx, videoStreamIdx, 0, AVSEEK_FLAG_BACKWARD);
+  int ret = ff.av_seek_frame(scanCtx, videoStreamIdx, 0, AVSEEK_FLAG_BACKWARD);
   if (ret != 0)
     // Seeking failed. Maybe the stream is not opened correctly?
     return false;
 
-  // Show a modal QProgressDialog while this operation is running.
-  // If the user presses cancel, we will cancel and return false (opening the file failed).
-  // First, get a pointer to the main window to use as a parent for the modal parsing progress dialog.
-  QWidgetList l = QApplication::topLevelWidgets();
-  QWidget *mainWindow = nullptr;
-  for (QWidget *w : l)
-  {
-    MainWindow *mw = dynamic_cast<MainWindow*>(w);
-    if (mw)
-      mainWindow = mw;
-  }
-  // Create the dialog
-  int64_t duration = ff.AVFormatContextGetDuration(fmt_ctx);
-  AVRational timeBase = ff.AVFormatContextGetTimeBase(fmt_ctx, videoStreamIdx);
-
+  int64_t duration = ff.AVFormatContextGetDuration(scanCtx);
+  AVRational timeBase = ff.AVFormatContextGetTimeBase(scanCtx, videoStreamIdx);
   qint64 maxPTS = duration * timeBase.den / timeBase.num / AV_TIME_BASE;
-  // Updating the dialog (setValue) is quite slow. Only do this if the percent value changes.
-  int curPercentValue = 0;
-  QProgressDialog progress("Parsing (indexing) bitstream...", "Cancel", 0, 100, mainWindow);
-  progress.setMinimumDuration(1000);  // Show after 1s
-  progress.setAutoClose(false);
-  progress.setAutoReset(false);
-  progress.setWindowModality(Qt::WindowModal);
 
   // Initialize an empty packet (data and size set to 0).
   AVPacket *p = ff.getNewPacket();
   ff.av_init_packet(p);
 
+  int nrFrames = -1;
   qint64 lastKeyFramePTS = 0;
+  bool scanOk = true;
   do
   {
     // Get one packet
-    ret = ff.av_read_frame(fmt_ctx, p);
+    ret = ff.av_read_frame(scanCtx, p);
 
     if (ret == 0 && ff.AVPacketGetStreamIndex(p) == videoStreamIdx)
     {
       int64_t pts = ff.AVPacketGetPTS(p);
 
       // Next video frame found
+      QMutexLocker locker(&index->mutex);
       if (ff.AVPacketGetFlags(p) & AV_PKT_FLAG_KEY)
       {
         if (nrFrames == -1)
           nrFrames = 0;
-        keyFrameList.append(pictureIdx(nrFrames, pts));
+        index->keyFrameList.append(pictureIdx(nrFrames, pts));
+        index->keyFramesAdded.wakeAll();
         lastKeyFramePTS = pts;
       }
       if (pts < lastKeyFramePTS)
       {
         // What now? Can this happen? If this happens, the frame count/PTS combination of the last key frame
-        // is wrong.
-        keyFrameList.clear();
-        nrFrames = -1;
-        // Free the packet (this will automatically unref the packet as weel)
-        ff.av_packet_unref(p);
-        ff.deletePacket(p);
-        return false;
-      }
-      nrFrames++;
-
-      // Update the progress dialog
-      if (progress.wasCanceled())
-      {
-        keyFrameList.clear();
-        nrFrames = -1;
-        // Free the packet (this will automatically unref the packet as weel)
-        ff.av_packet_unref(p);
-        ff.deletePacket(p);
-        return false;
+        // is wrong. Stop here. The frames up to here can still be decoded.
+        scanOk = false;
       }
-      int newPercentValue = pts * 100 / maxPTS;
-      if (newPercentValue != curPercentValue)
+      else if (nrFrames != -1)
       {
-        progress.setValue(newPercentValue);
-        curPercentValue = newPercentValue;
+        nrFrames++;
+        index->nrFrames = nrFrames;
+        if (maxPTS > 0)
+          index->scanProgress = qBound(0.0, pts * 100.0 / maxPTS, 100.0);
       }
     }
 
     // Unref the packet
     ff.av_packet_unref(p);
-  } while (ret == 0);
+  } while (ret == 0 && scanOk && !cancelBackgroundScan.loadAcquire());
 
   // Delete the packet again
   ff.deletePacket(p);
 
-  progress.close();
+  return scanOk && !cancelBackgroundScan.loadAcquire();
+}
 
-  // Seek back to the beginning of the stream.
-  ret = ff.av_seek_frame(fmt_ctx, videoStreamIdx, 0, AVSEEK_FLAG_BACKWARD);
-  if (ret != 0)
-    // Seeking failed.
+void FFmpegDecoder::scanBitstreamInBackground()
+{
+  // Use a separate format context so that decoding is not disturbed by the scan
+  AVFormatContext *scanCtx = nullptr;
+  bool scanComplete = false;
+  if (ff.avformat_open_input(&scanCtx, fullFilePath.toStdString().c_str(), nullptr, nullptr) >= 0)
+  {
+    if (ff.avformat_find_stream_info(scanCtx, NULL) >= 0)
+      scanComplete = scanBitstream(scanCtx);
+    ff.avformat_close_input(&scanCtx);
+  }
+  DEBUG_FFMPEG("FFmpegDecoder::scanBitstreamInBackground done %s", scanComplete ? "" : "(incomplete)");
+
+  {
+    QMutexLocker locker(&index->mutex);
+    index->scanRunning = false;
+    index->keyFramesAdded.wakeAll();
+  }
+  if (scanComplete)
+    // The index is not modified anymore
+    saveFrameIndex();
+}
+
+void FFmpegDecoder::stopBackgroundScan()
+{
+  if (backgroundScanFuture.isRunning())
+  {
+    // signal to background thread that we want to cancel the processing
+    cancelBackgroundScan.storeRelease(1);
+    backgroundScanFuture.waitForFinished();
+  }
+}
+
+int FFmpegDecoder::getNumberPOCs() const
+{
+  QMutexLocker locker(&index->mutex);
+  return index->nrFrames;
+}
+
+bool FFmpegDecoder::isScanningInBackground() const
+{
+  QMutexLocker locker(&index->mutex);
+  return index->scanRunning;
+}
+
+double FFmpegDecoder::getBackgroundScanProgress() const
+{
+  QMutexLocker locker(&index->mutex);
+  return index->scanProgress;
+}
+
+QString FFmpegDecoder::getFrameIndexFilePath() const
+{
+  const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  if (cacheDir.isEmpty())
+    return QString();
+  const QByteArray pathHash = QCryptographicHash::hash(fileInfo.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+  return QDir(cacheDir).filePath(QString("ffmpegIndex/%1.idx").arg(QString(pathHash)));
+}
+
+bool FFmpegDecoder::loadFrameIndex()
+{
+  QFile indexFile(getFrameIndexFilePath());
+  if (!indexFile.open(QIODevice::ReadOnly))
     return false;
 
+  QDataStream in(&indexFile);
+  in.setVersion(QDataStream::Qt_5_0);
+
+  // Check if the index belongs to this file and if the file was not modified since the index was written.
+  QByteArray magic;
+  qint32 version;
+  QString path;
+  qint64 size, lastModified;
+  in >> magic >> version >> path >> size >> lastModified;
+  if (in.status() != QDataStream::Ok || magic != "YUViewFFmpegIndex" || version != FFMPEG_FRAME_INDEX_VERSION ||
+      path != fileInfo.absoluteFilePath() || size != fileInfo.size() || lastModified != fileInfo.lastModified().toMSecsSinceEpoch())
+  {
+    DEBUG_FFMPEG("FFmpegDecoder::loadFrameIndex index outdated");
+    return false;
+  }
+
+  qint32 nrFrames, nrKeyFrames;
+  in >> nrFrames >> nrKeyFrames;
+  QList<pictureIdx> indexKeyFrameList;
+  for (int i = 0; i < nrKeyFrames && in.status() == QDataStream::Ok; i++)
+  {
+    qint64 frameNr, pts;
+    in >> frameNr >> pts;
+    indexKeyFrameList.append(pictureIdx(frameNr, pts));
+  }
+
+  if (in.status() != QDataStream::Ok || indexKeyFrameList.isEmpty() || indexKeyFrameList.count() != nrKeyFrames)
+  {
+    DEBUG_FFMPEG("FFmpegDecoder::loadFrameIndex reading index failed");
+    return false;
+  }
+
+  DEBUG_FFMPEG("FFmpegDecoder::loadFrameIndex loaded %d frames and %d key frames", nrFrames, nrKeyFrames);
+  QMutexLocker locker(&index->mutex);
+  index->keyFrameList = indexKeyFrameList;
+  index->nrFrames = nrFrames;
   return true;
 }
 
+void FFmpegDecoder::saveFrameIndex() const
+{
+  const QString indexFilePath = getFrameIndexFilePath();
+  if (indexFilePath.isEmpty() || !QDir().mkpath(QFileInfo(indexFilePath).absolutePath()))
+    return;
+
+  // Write to a temporary file first, so that an incomplete index is never read.
+  QSaveFile indexFile(indexFilePath);
+  if (!indexFile.open(QIODevice::WriteOnly))
+    return;
+
+  QDataStream out(&indexFile);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << QByteArray("YUViewFFmpegIndex") << qint32(FFMPEG_FRAME_INDEX_VERSION) << fileInfo.absoluteFilePath() << qint64(fileInfo.size()) << qint64(fileInfo.lastModified().toMSecsSinceEpoch());
+  QMutexLocker locker(&index->mutex);
+  out << qint32(index->nrFrames) << qint32(index->keyFrameList.count());
+  for (const pictureIdx &f : index->keyFrameList)
+    out << qint64(f.frame) << qint64(f.pts);
+
+  if (out.status() == QDataStream::Ok)
+    indexFile.commit();
+}
+
 QList<infoItem> FFmpegDecoder::getFileInfoList() const
 {
   QList<infoItem> infoList;
@@ -736,9 +854,10 @@ void FFmpegDecoder::copyFrameToOutputBuffer()
   int nrBytesC = frameSize.width() / pixFmt.getSubsamplingHor() * frameSize.height() / pixFmt.getSubsamplingVer() * nrBytesPerSample;
   int nrBytes = nrBytesY + 2 * nrBytesC;
 
-  // Is the output big enough?
-  if (currentOutputBuffer.capacity() < nrBytes)
-    currentOutputBuffer.resize(nrBytes);
+  // Is the output big enough? The last output buffer is usually still used by the videoHandler. Writing to it
+  // would detach it first, which copies the old frame just to overwrite it. Get a new buffer in this case.
+  if (!currentOutputBuffer.isDetached() || currentOutputBuffer.size() != nrBytes)
+    currentOutputBuffer = QByteArray(nrBytes, Qt::Uninitialized);
 
   // Copy line by line. The linesize of the source may be larger than the width of the frame.
   // This may be because the frame buffer is (8) byte aligned. Also the internal decoded
@@ -746,19 +865,25 @@ void FFmpegDecoder::copyFrameToOutputBuffer()
   uint8_t *src = ff.AVFrameGetData(frame, 0);
   int linesize = ff.AVFrameGetLinesize(frame, 0);
   char* dst = currentOutputBuffer.data();
-  int wDst = frameSize.width();
+  int wDst = frameSize.width() * nrBytesPerSample;
   int hDst = frameSize.height();
-  for (int y = 0; y < hDst; y++)
+  if (linesize == wDst)
+    // The lines are not padded. Copy the whole plane at once.
+    memcpy(dst, src, wDst * hDst);
+  else
   {
-    // Copy one line
-    memcpy(dst, src, wDst);
-    // Goto the next line in input and output (these offsets/strides may differ)
-    dst += wDst;
-    src += linesize;
+    for (int y = 0; y < hDst; y++)
+    {
+      // Copy one line
+      memcpy(dst, src, wDst);
+      // Goto the next line in input and output (these offsets/strides may differ)
+      dst += wDst;
+      src += linesize;
+    }
   }
 
   // Chroma
-  wDst = frameSize.width() / pixFmt.getSubsamplingHor();
+  wDst = frameSize.width() / pixFmt.getSubsamplingHor() * nrBytesPerSample;
   hDst = frameSize.height() / pixFmt.getSubsamplingVer();
   for (int c = 0; c < 2; c++)
   {
@@ -766,6 +891,11 @@ void FFmpegDecoder::copyFrameToOutputBuffer()
     linesize = ff.AVFrameGetLinesize(frame, 1+c);
     dst = currentOutputBuffer.data();
     dst += (nrBytesY + ((c == 0) ? 0 : nrBytesC));
+    if (linesize == wDst)
+    {
+      memcpy(dst, src, wDst * hDst);
+      continue;
+    }
     for (int y = 0; y < hDst; y++)
     {
       memcpy(dst, src, wDst);
@@ -837,10 +967,11 @@ bool FFmpegDecoder::checkForLibraries(QString path)
   return (dec.decodingError == ffmpeg_noError);
 }
 
-FFmpegDecoder::pictureIdx FFmpegDecoder::getClosestSeekableFrameNumberBefore(int frameIdx)
+FFmpegDecoder::pictureIdx FFmpegDecoder::getClosestSeekableFrameNumberBefore(int frameIdx) const
 {
-  pictureIdx ret = keyFrameList.first();
-  for (auto f : keyFrameList)
+  QMutexLocker locker(&index->mutex);
+  pictureIdx ret = index->keyFrameList.first();
+  for (auto f : index->keyFrameList)
   {
     if (f.frame >= frameIdx)
       // This key picture is after the given index. Return the last found key picture.
@@ -850,6 +981,15 @@ FFmpegDecoder::pictureIdx FFmpegDecoder::getClosestSeekableFrameNumberBefore(int
   return ret;
 }
 
+QList<int> FFmpegDecoder::getSeekableFrameNumbers() const
+{
+  QMutexLocker locker(&index->mutex);
+  QList<int> frames;
+  for (auto f : index->keyFrameList)
+    frames.append(f.frame);
+  return frames;
+}
+
 bool FFmpegDecoder::seekToPTS(qint64 pts)
 {
   int ret = ff.av_seek_frame(fmt_ctx, videoStreamIdx, pts, AVSEEK_FLAG_BACKWARD);
@@ -37,8 +37,13 @@
 #include "statisticsExtensions.h"
 #include "videoHandlerYUV.h"
 #include "FFMpegDecoderLibHandling.h"
-#include <QLibrary>
+#include <QAtomicInt>
 #include <QFileSystemWatcher>
+#include <QFuture>
+#include <QLibrary>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
 
 using namespace YUV_Internals;
 
@@ -51,10 +56,15 @@ public:
   FFmpegDecoder();
   ~FFmpegDecoder();
 
+  // Decoders that are used for caching run in parallel (one per caching thread). They use less libavcodec threads
+  // than the decoder for interactive loading. This is applied when the file is opened.
+  void setUsedForCaching(bool caching) { usedForCaching = caching; }
+
   // Open the given file. Parse the NAL units list and get the size and YUV pixel format from the file.
   // Return false if an error occured (opening the decoder or parsing the bitstream)
   // If a second decoder is provided, the bistream will not be scanned again (scanBitstream), but
-  // the values will be copied from the given decoder.
+  // the key frame index of the given decoder is used.
+  // The key frame list might still be filled in the background when this returns (see isScanningInBackground()).
   bool openFile(QString fileName, FFmpegDecoder *otherDec=nullptr);
 
   // Get the pixel format and frame size. This is valid after openFile was called.
@@ -64,8 +74,10 @@ public:
   // Get some infos on the file (like date changed, file size, etc...)
   QList<infoItem> getFileInfoList() const;
 
-  // How many frames are in the file?
-  int getNumberPOCs() const { return nrFrames; }
+  // How many frames are in the file? While the file is scanned in the background, this is the number of frames found so far.
+  int getNumberPOCs() const;
+  bool isScanningInBackground() const;
+  double getBackgroundScanProgress() const;
   double getFrameRate() const { return frameRate; }
   ColorConversion getColorConversionType() const { return colorConversionType; }
 
@@ -80,6 +92,13 @@ public:
 
   // Load the raw YUV data for the given frame
   QByteArray loadYUVFrameData(int frameIdx);
+  // The index of the frame that was decoded last (-1 if none). Decoding of later frames continues from here.
+  int getCurrentFrameIndex() const { return currentOutputBufferFrameIndex; }
+
+  // The key frames around the given frame. Decoding of a frame starts at the closest key frame before it.
+  int getClosestSeekableFrameNumber(int frameIdx) const { return getClosestSeekableFrameNumberBefore(frameIdx).frame; }
+  // The frame numbers of all key frames that are known so far (sorted)
+  QList<int> getSeekableFrameNumbers() const;
 
   // Was the file changed by some other application?
   bool isFileChanged() { bool b = fileChanged; fileChanged = false; return b; }
@@ -107,13 +126,21 @@ private:
   // If this fails, decoderError will be set.
   void bindFunctionsFromLibraries();
 
-  // Scan the entire stream. Get the number of frames that we can decode and the key frames
-  // that we can seek to.
-  bool scanBitstream();
+  // Scan the entire stream using the given format context. Get the number of frames that we can decode and the key frames
+  // that we can seek to. These are added to the index while scanning. The scan can be canceled using cancelBackgroundScan.
+  bool scanBitstream(AVFormatContext *scanCtx);
+  // Open the file with a separate format context and scan it. This runs in a separate thread (backgroundScanFuture).
+  void scanBitstreamInBackground();
+  void stopBackgroundScan();
+  QFuture<void> backgroundScanFuture;
+  QAtomicInt cancelBackgroundScan;
 
   // The decoderLibraries can be accessed through this class independent of the FFmpeg version.
   FFmpegVersionHandler ff;
 
+  // Is this one of the decoders that are used for caching? (see setUsedForCaching())
+  bool usedForCaching;
+
   // Error handling
   enum decodingErrorEnum
   {
@@ -158,10 +185,26 @@ private:
     qint64 pts;
   };
 
-  // These are filled after opening a file (after scanBitstream was called)
-  int nrFrames;                               //< How many frames are in the sequence?
-  QList<pictureIdx> keyFrameList;  //< A list of pairs (frameNr, PTS) that we can seek to.
-  pictureIdx getClosestSeekableFrameNumberBefore(int frameIdx);
+  // These are filled after opening a file (by scanBitstream). The index is shared with the other decoders of the
+  // same file and may still grow while the file is scanned in the background. All access must lock the mutex.
+  struct frameIndex
+  {
+    frameIndex() : nrFrames(-1), scanRunning(false), scanProgress(0) {}
+    QList<pictureIdx> keyFrameList;  //< A list of pairs (frameNr, PTS) that we can seek to.
+    int nrFrames;                    //< How many frames are in the sequence?
+    bool scanRunning;
+    double scanProgress;             //< The progress of the background scan in percent
+    mutable QMutex mutex;
+    QWaitCondition keyFramesAdded;
+  };
+  QSharedPointer<frameIndex> index;
+  pictureIdx getClosestSeekableFrameNumberBefore(int frameIdx) const;
+
+  // After scanning, the key frame list is saved to an index file in the cache directory. If the same file
+  // (same path, size and modification time) is opened again, the index is loaded instead of scanning the file again.
+  QString getFrameIndexFilePath() const;
+  bool loadFrameIndex();
+  void saveFrameIndex() const;
 
   // Seek the stream to the given pts value, flush the decoder and load the first packet so
   // that we are ready to start decoding from this pts.
@@ -0,0 +1,194 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CACHINGDECODERPOOL_H
+#define CACHINGDECODERPOOL_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+/* A pool of decoders for caching. Every caching thread gets its own decoder from the pool. Every decoder decodes from
+ * a random access point (key frame) on, so multiple caching threads can decode different ranges at the same time.
+ * This is better if random access and linear decoding (caching) is performed at the same time. All decoders use the
+ * index (random access points) of the loading decoder of the item.
+ * The Decoder class (de265Decoder, FFmpegDecoder) has to provide setUsedForCaching(), openFile(fileName, otherDecoder),
+ * moveToThread(), getCurrentFrameIndex(), getClosestSeekableFrameNumber() and loadYUVFrameData().
+ */
+template <typename Decoder>
+class cachingDecoderPool
+{
+public:
+  cachingDecoderPool(Decoder *loadingDecoder) : loadingDecoder(loadingDecoder), ownerThread(nullptr), nrDecodersOpening(0)
+  {
+    maxNrDecoders = qMax(QThread::idealThreadCount(), 1);
+  }
+  // The videoCache makes sure that no caching thread is still running when the item (and the pool) is deleted.
+  ~cachingDecoderPool() { qDeleteAll(decoders); }
+
+  // Open the first decoder of the pool. More are opened when multiple threads cache at the same time.
+  // This must be called in the thread that deletes the pool (the thread of the item).
+  bool openFile(const QString &filePath)
+  {
+    fileName = filePath;
+    ownerThread = QThread::currentThread();
+
+    Decoder *decoder = openDecoder();
+    if (!decoder)
+      return false;
+    QMutexLocker locker(&mutex);
+    decoders.append(decoder);
+    idleDecoders.append(decoder);
+    return true;
+  }
+
+  // Decode the given frame with a decoder from the pool. Multiple threads can do this at the same time.
+  // If reloadCost is given, it is set to an estimation of the time (in ms) that decoding the frame again would take. This
+  // means decoding all frames from the random access point on. It is estimated from the time per frame that was just needed.
+  QByteArray loadYUVFrameData(int frameIdx, qint64 *reloadCost=nullptr)
+  {
+    Decoder *decoder = getDecoder(frameIdx);
+    if (!decoder)
+      return QByteArray();
+
+    QElapsedTimer decodingTimer;
+    decodingTimer.start();
+    const int seekFrameIdx = loadingDecoder->getClosestSeekableFrameNumber(frameIdx);
+    const int lastFrameIdx = decoder->getCurrentFrameIndex();
+    QByteArray decByteArray = decoder->loadYUVFrameData(frameIdx);
+    releaseDecoder(decoder);
+
+    if (reloadCost && !decByteArray.isEmpty())
+    {
+      const int nrFramesDecoded = (lastFrameIdx >= seekFrameIdx && lastFrameIdx < frameIdx) ? frameIdx - lastFrameIdx : frameIdx - seekFrameIdx + 1;
+      *reloadCost = decodingTimer.elapsed() * (frameIdx - seekFrameIdx + 1) / qMax(nrFramesDecoded, 1);
+    }
+    return decByteArray;
+  }
+
+private:
+  // Get a decoder from the pool for decoding the given frame. Prefer a decoder that can continue decoding without seeking.
+  // If all decoders are in use (and the pool is full), wait for one. Return nullptr if no decoder could be opened.
+  Decoder *getDecoder(int frameIdx)
+  {
+    QMutexLocker locker(&mutex);
+
+    // A decoder that decoded a frame between the random access point and the frame can just continue decoding.
+    const int seekFrameIdx = loadingDecoder->getClosestSeekableFrameNumber(frameIdx);
+    while (true)
+    {
+      for (Decoder *d : idleDecoders)
+      {
+        const int curFrameIdx = d->getCurrentFrameIndex();
+        if (curFrameIdx >= seekFrameIdx && curFrameIdx <= frameIdx)
+        {
+          idleDecoders.removeOne(d);
+          return d;
+        }
+      }
+
+      // Open another decoder if the pool is not full yet. It has to seek anyway. Opening takes a while, so reserve
+      // a slot in the pool and open the decoder without blocking the other threads.
+      if (decoders.count() + nrDecodersOpening < maxNrDecoders)
+      {
+        nrDecodersOpening++;
+        locker.unlock();
+        Decoder *newDecoder = openDecoder();
+        locker.relock();
+        nrDecodersOpening--;
+        if (newDecoder)
+        {
+          decoders.append(newDecoder);
+          return newDecoder;
+        }
+
+        // Opening failed. Don't try again and work with the decoders we have (or that are being opened).
+        maxNrDecoders = decoders.count() + nrDecodersOpening;
+        // Threads that wait for a decoder must check again if there will be one at all.
+        decoderReleased.wakeAll();
+        if (maxNrDecoders == 0)
+          return nullptr;
+        continue;
+      }
+
+      // Take the decoder that was not used for the longest time
+      if (!idleDecoders.isEmpty())
+        return idleDecoders.takeFirst();
+
+      if (decoders.count() + nrDecodersOpening == 0)
+        // There is no decoder and none is being opened
+        return nullptr;
+      decoderReleased.wait(&mutex);
+    }
+  }
+
+  void releaseDecoder(Decoder *decoder)
+  {
+    QMutexLocker locker(&mutex);
+    idleDecoders.append(decoder);
+    decoderReleased.wakeOne();
+  }
+
+  // Open a new decoder. The caller adds it to the pool. The mutex must not be locked (this takes a while).
+  Decoder *openDecoder()
+  {
+    Decoder *newDecoder = new Decoder;
+    newDecoder->setUsedForCaching(true);
+    if (!newDecoder->openFile(fileName, loadingDecoder))
+    {
+      delete newDecoder;
+      return nullptr;
+    }
+    // The decoder may have been created in a caching thread but it is deleted in the thread of the item
+    newDecoder->moveToThread(ownerThread);
+    return newDecoder;
+  }
+
+  Decoder *loadingDecoder;
+  QString fileName;
+  QThread *ownerThread;
+
+  QList<Decoder*> decoders;      // All decoders of the pool
+  QList<Decoder*> idleDecoders;  // The decoders that are currently not used (the least recently used first)
+  int maxNrDecoders;
+  int nrDecodersOpening;         // The number of decoders that are being opened (outside of the mutex)
+
+  // Access to the pool
+  QMutex mutex;
+  QWaitCondition decoderReleased;
+};
+
+#endif // CACHINGDECODERPOOL_H
@@ -33,8 +33,10 @@
 #include "de265Decoder.h"
 
 #include <cstring>
+#include <QAtomicInt>
 #include <QCoreApplication>
 #include <QDir>
+#include <QSettings>
 #include "typedef.h"
 
 #define LIBDE265DECODER_DEBUG_OUTPUT 0
@@ -64,6 +66,9 @@ const int de265Decoder::vectorTable[35][2] =
 
 de265Functions::de265Functions() { memset(this, 0, sizeof(*this)); }
 
+// The number of libde265 worker threads for interactive decoding (see updateDecoderSettings())
+static QAtomicInt nrDecoderWorkerThreads(getOptimalThreadCount());
+
 de265Decoder::de265Decoder() :
   decoderError(false),
   parsingError(false),
@@ -75,7 +80,9 @@ de265Decoder::de265Decoder() :
   decError = DE265_OK;
   decoder = nullptr;
   retrieveStatistics = false;
+  usedForCaching = false;
   statsCacheCurPOC = -1;
+  decodedFrameBufferSize = 0;
 
   // The buffer holding the last requested frame (and its POC). (Empty when constructing this)
   // When using the zoom box the getOneFrame function is called frequently so we
@@ -224,13 +231,27 @@ void de265Decoder::allocateNewDecoder()
   // Verbosity level (0...3(highest))
   de265_set_verbosity(0);
 
-  // Set the number of decoder threads. Libde265 can use wavefronts to utilize these.
-  decError = de265_start_worker_threads(decoder, 8);
+  // Set the number of decoder threads. Libde265 can use wavefronts (or tiles) to utilize these. The caching decoders
+  // already run in parallel so they share the threads. Without worker threads, libde265 decodes in the calling thread.
+  int nrThreads = nrDecoderWorkerThreads.load();
+  if (usedForCaching)
+    nrThreads /= qMax(int(getOptimalThreadCount()), 1);
+  if (nrThreads > 0)
+    decError = de265_start_worker_threads(decoder, nrThreads);
 
   // The highest temporal ID to decode. Set this to very high (all) by default.
   de265_set_limit_TID(decoder, 100);
 }
 
+void de265Decoder::updateDecoderSettings()
+{
+  QSettings settings;
+  settings.beginGroup("VideoCache");
+  int nrThreads = settings.value("DecoderThreads", getOptimalThreadCount()).toInt();
+  settings.endGroup();
+  nrDecoderWorkerThreads.store(qMax(nrThreads, 0));
+}
+
 QByteArray de265Decoder::loadYUVFrameData(int frameIdx)
 {
   // At first check if the request is for the frame that has been requested in the
@@ -241,6 +262,14 @@ QByteArray de265Decoder::loadYUVFrameData(int frameIdx)
     return currentOutputBuffer;
   }
 
+  // Maybe the frame was decoded recently. In this case the decoder does not have to seek back.
+  QByteArray bufferedFrame;
+  if (getFrameFromDecodedFrameBuffer(frameIdx, bufferedFrame))
+  {
+    DEBUG_LIBDE265("de265Decoder::loadYUVData Frame %d from the decoded frame buffer", frameIdx);
+    return bufferedFrame;
+  }
+
   // We have to decode the requested frame.
   bool seeked = false;
   QByteArray parameterSets;
@@ -374,12 +403,25 @@ QByteArray de265Decoder::loadYUVFrameData(int frameIdx)
             // The cache now contains the statistics for iPOC
             statsCacheCurPOC = currentOutputBufferFrameIndex;
           }
+          addToDecodedFrameBuffer(currentOutputBufferFrameIndex, currentOutputBuffer);
 
           // Picture decoded
           DEBUG_LIBDE265("de265Decoder::loadYUVFrameData decoded the requested frame %d", currentOutputBufferFrameIndex);
             
           return currentOutputBuffer;
         }
+        else if (!usedForCaching)
+        {
+          // This is a frame on the way to the requested one. Keep it in case it is requested next (stepping back).
+          QByteArray frameData;
+          copyImgToByteArray(img, frameData);
+          if (retrieveStatistics)
+          {
+            cacheStatistics(img);
+            statsCacheCurPOC = currentOutputBufferFrameIndex;
+          }
+          addToDecodedFrameBuffer(currentOutputBufferFrameIndex, frameData);
+        }
       }
     }
 
@@ -429,9 +471,11 @@ void de265Decoder::copyImgToByteArray(const de265_image *src, QByteArray &dst)
     nrBytes += width * height * nrBytesPerSample;
   }
 
-  // Is the output big enough?
-  if (dst.capacity() < nrBytes)
-    dst.resize(nrBytes);
+  // Is the output big enough? The last output buffer is usually still used (by the videoHandler or the buffer of
+  // decoded frames). Writing to it would detach it first, which copies the old frame just to overwrite it. Get a
+  // new buffer in this case.
+  if (!dst.isDetached() || dst.size() != nrBytes)
+    dst = QByteArray(nrBytes, Qt::Uninitialized);
 
   // We can now copy from src to dst
   char* dst_c = dst.data();
@@ -443,6 +487,13 @@ void de265Decoder::copyImgToByteArray(const de265_image *src, QByteArray &dst)
     int nrBytesPerSample = (de265_get_bits_per_pixel(src, c) > 8) ? 2 : 1;
     size_t size = width * nrBytesPerSample;
 
+    if (size_t(stride) == size)
+    {
+      // The lines are not padded. Copy the whole plane at once.
+      memcpy(dst_c, img_c, size * height);
+      dst_c += size * height;
+      continue;
+    }
     for (int y = 0; y < height; y++)
     {
       memcpy(dst_c, img_c, size);
@@ -740,6 +791,67 @@ void de265Decoder::cacheStatistics_TUTree_recursive(uint8_t *const tuInfo, int t
   }
 }
 
+void de265Decoder::addToDecodedFrameBuffer(int frameIdx, const QByteArray &yuvData)
+{
+  if (usedForCaching || yuvData.isEmpty())
+    return;
+
+  if (decodedFrameBuffer.contains(frameIdx))
+  {
+    decodedFrameBufferSize -= decodedFrameBuffer[frameIdx].yuvData.size();
+    decodedFrameBufferOrder.removeOne(frameIdx);
+  }
+
+  // The statistics in curPOCStats belong to this frame if they were just retrieved
+  decodedFrame &frame = decodedFrameBuffer[frameIdx];
+  frame.yuvData = yuvData;
+  frame.statisticsValid = (retrieveStatistics && statsCacheCurPOC == frameIdx);
+  if (frame.statisticsValid)
+    frame.statistics = curPOCStats;
+  else
+    frame.statistics.clear();
+  decodedFrameBufferOrder.append(frameIdx);
+  decodedFrameBufferSize += yuvData.size();
+
+  // Drop the least recently used frames until the buffer fits again (but always keep the new frame)
+  const qint64 maxBufferSize = qint64(DE265_DECODED_FRAME_BUFFER_MB) * 1024 * 1024;
+  while (decodedFrameBufferSize > maxBufferSize && decodedFrameBufferOrder.count() > 1)
+  {
+    int oldestIdx = decodedFrameBufferOrder.takeFirst();
+    decodedFrameBufferSize -= decodedFrameBuffer[oldestIdx].yuvData.size();
+    decodedFrameBuffer.remove(oldestIdx);
+  }
+}
+
+bool de265Decoder::getFrameFromDecodedFrameBuffer(int frameIdx, QByteArray &yuvData)
+{
+  auto it = decodedFrameBuffer.find(frameIdx);
+  if (it == decodedFrameBuffer.end())
+    return false;
+  // If statistics are retrieved, a frame without its statistics has to be decoded again
+  if (retrieveStatistics && !it->statisticsValid)
+    return false;
+
+  yuvData = it->yuvData;
+  if (retrieveStatistics)
+  {
+    curPOCStats = it->statistics;
+    statsCacheCurPOC = frameIdx;
+  }
+
+  // This is now the most recently used frame
+  decodedFrameBufferOrder.removeOne(frameIdx);
+  decodedFrameBufferOrder.append(frameIdx);
+  return true;
+}
+
+void de265Decoder::clearDecodedFrameBuffer()
+{
+  decodedFrameBuffer.clear();
+  decodedFrameBufferOrder.clear();
+  decodedFrameBufferSize = 0;
+}
+
 statisticsData de265Decoder::getStatisticsData(int frameIdx, int typeIdx)
 {
   if (!retrieveStatistics)
@@ -749,12 +861,17 @@ statisticsData de265Decoder::getStatisticsData(int frameIdx, int typeIdx)
 
   if (frameIdx != statsCacheCurPOC)
   {
-    if (currentOutputBufferFrameIndex == frameIdx)
-      // We will have to decode the current frame again to get the internals/statistics
-      // This can be done like this:
-      currentOutputBufferFrameIndex ++;
+    // The statistics might be in the buffer of recently decoded frames
+    QByteArray bufferedFrame;
+    if (!getFrameFromDecodedFrameBuffer(frameIdx, bufferedFrame))
+    {
+      if (currentOutputBufferFrameIndex == frameIdx)
+        // We will have to decode the current frame again to get the internals/statistics
+        // This can be done like this:
+        currentOutputBufferFrameIndex ++;
 
-    loadYUVFrameData(frameIdx);
+      loadYUVFrameData(frameIdx);
+    }
   }
 
   return curPOCStats[typeIdx];
@@ -770,6 +887,7 @@ bool de265Decoder::reloadItemSource()
   decError = DE265_OK;
   statsCacheCurPOC = -1;
   currentOutputBufferFrameIndex = -1;
+  clearDecodedFrameBuffer();
 
   // Re-open the input file. This will reload the bitstream as if it was completely unknown.
   QString fileName = annexBFile.absoluteFilePath();
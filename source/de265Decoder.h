@@ -42,6 +42,9 @@
 
 using namespace YUV_Internals;
 
+// The maximum size (in MB) of the buffer of recently decoded frames that every interactive de265Decoder keeps
+#define DE265_DECODED_FRAME_BUFFER_MB 256
+
 struct de265Functions
 {
   de265Functions();
@@ -87,21 +90,39 @@ class de265Decoder : public de265Functions
 public:
   de265Decoder();
 
+  // Decoders that are used for caching run in parallel (one per caching thread). They use less worker threads
+  // than the decoder for interactive loading. This is applied when the next decoder context is allocated.
+  void setUsedForCaching(bool caching) { usedForCaching = caching; }
+
+  // Load the number of libde265 worker threads of the interactive decoder from the settings. The caching decoders
+  // share this number of threads. New values are used when the next decoder context is allocated (e.g. when seeking).
+  static void updateDecoderSettings();
+
   // Is retrieving of statistics enabled? It is automatically enabled the first time statistics are requested by loadStatisticsData().
   bool statisticsEnabled() const { return retrieveStatistics; }
 
   // Open the given file. Parse the NAL units list and get the size and YUV pixel format from the file.
+  // The NAL units list might still be filled in the background when this returns (see isScanningInBackground()).
   // Return false if an error occured (opening the decoder or parsing the bitstream)
   bool openFile(QString fileName, de265Decoder *otherDecoder = nullptr);
 
   // Get some infos on the file
   QList<infoItem> getFileInfoList() const { return annexBFile.getFileInfoList(); }
   int getNumberPOCs() const { return annexBFile.getNumberPOCs(); }
+  bool isScanningInBackground() const { return annexBFile.isScanningInBackground(); }
+  double getBackgroundScanProgress() const { return annexBFile.getBackgroundScanProgress(); }
+  // The random access points around the given frame (see fileSourceHEVCAnnexBFile)
+  int getClosestSeekableFrameNumber(int frameIdx) const { return annexBFile.getClosestSeekableFrameNumber(frameIdx); }
+  QList<int> getSeekableFrameNumbers() const { return annexBFile.getSeekableFrameNumbers(); }
   bool isFileChanged() { return annexBFile.isFileChanged(); }
   void updateFileWatchSetting() { annexBFile.updateFileWatchSetting(); }
+  // The file (and its file watcher) belongs to the thread that opened it. Move it if the decoder is deleted in another thread.
+  void moveToThread(QThread *thread) { annexBFile.moveToThread(thread); }
 
   // Load the raw YUV data for the given frame
   QByteArray loadYUVFrameData(int frameIdx);
+  // The index of the frame that was decoded last (-1 if none). Decoding of later frames continues from here.
+  int getCurrentFrameIndex() const { return currentOutputBufferFrameIndex; }
 
   // Get the statistics values for the given frame (decode if necessary)
   statisticsData getStatisticsData(int frameIdx, int typeIdx);
@@ -132,6 +153,8 @@ private:
   // if set to true the decoder will also get statistics from each decoded frame and put them into the local cache
   bool retrieveStatistics;
 
+  bool usedForCaching;
+
   QLibrary library;
   bool decoderError;
   bool parsingError;
@@ -172,6 +195,24 @@ private:
   QByteArray currentOutputBuffer;
   void copyImgToByteArray(const de265_image *src, QByteArray &dst);   // Copy the raw data from the de265_image source *src to the byte array
 #endif
+
+  // All frames that are output while decoding up to the requested frame are kept in a bounded buffer (together with
+  // their statistics if these are retrieved). Stepping backwards or requesting a recent frame again can then be served
+  // from here instead of seeking to the previous random access point and decoding from there. The oldest entries are
+  // dropped once the buffer exceeds DE265_DECODED_FRAME_BUFFER_MB. Decoders that are used for caching don't
+  // use this buffer because their frames go into the video cache anyway.
+  struct decodedFrame
+  {
+    QByteArray yuvData;
+    QHash<int, statisticsData> statistics;
+    bool statisticsValid;
+  };
+  QHash<int, decodedFrame> decodedFrameBuffer;
+  QList<int> decodedFrameBufferOrder;   // The frame indices in the buffer. The least recently used one first.
+  qint64 decodedFrameBufferSize;        // The size of all YUV data in the buffer in bytes
+  void addToDecodedFrameBuffer(int frameIdx, const QByteArray &yuvData);
+  bool getFrameFromDecodedFrameBuffer(int frameIdx, QByteArray &yuvData);
+  void clearDecodedFrameBuffer();
   
 };
 
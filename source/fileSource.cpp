@@ -32,24 +32,232 @@
 
 #include "fileSource.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <limits>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include <QDateTime>
 #include <QDir>
 #include <QRegExp>
 #include <QSettings>
+#include <QThread>
+#include <QWaitCondition>
 #include "typedef.h"
  
 #define FILESOURCE_DEBUG_SIMULATESLOWLOADING 0
-#if FILESOURCE_DEBUG_SIMULATESLOWLOADING && !NDEBUG
-#include <QThread>
-#endif
 
-fileSource::fileSource()
+// The maximum number of blocks that are read ahead.
+#define READ_AHEAD_MAX_BLOCKS 8
+// If the file is not memory mapped, the blocks that were read ahead are kept in memory. Limit the size of these.
+#define READ_AHEAD_MAX_BYTES (256*1024*1024)
+
+// The I/O thread of the read-ahead. The window of blocks to read is set by the consumer (setWindow()). The blocks are read
+// in the I/O thread and put into a single producer/single consumer ring buffer. The consumer takes them out (takeBlock())
+// without locking (unless the ring was full and the I/O thread must be woken up). If the file is memory mapped, the blocks are views into the mapping and the I/O thread only touches
+// all pages so that they are in memory when they are needed.
+class fileSource::readAheadThread : public QThread
+{
+public:
+  readAheadThread(const QString &path, const uchar *mapped, qint64 size)
+  {
+    filePath = path;
+    mappedData = mapped;
+    fileSize = size;
+    windowActive = false;
+    generation = 0;
+    windowStart = 0;
+    windowEnd = 0;
+    nextReadPos = 0;
+    blockSize = 0;
+    direction = 1;
+  }
+  ~readAheadThread()
+  {
+    {
+      QMutexLocker lock(&controlMutex);
+      requestInterruption();
+      controlCondition.wakeOne();
+    }
+    wait();
+  }
+
+  // Consumer side. Set the window of blocks that should be read.
+  void setWindow(qint64 startPos, qint64 newBlockSize, int nrBlocks, int newDirection);
+  // Consumer side. If the block at startPos was read, take it out of the ring buffer. Blocks that are no longer needed are dropped.
+  bool takeBlock(qint64 startPos, qint64 nrBytes, QByteArray &targetBuffer);
+
+protected:
+  void run() Q_DECL_OVERRIDE;
+
+private:
+  struct block
+  {
+    qint64 pos;
+    int generation;
+    QByteArray data;
+  };
+  // The ring buffer. ringHead is only written by the consumer, ringTail is only written by the I/O thread.
+  static const int ringSize = READ_AHEAD_MAX_BLOCKS + 1;
+  block ring[ringSize];
+  QAtomicInt ringHead;
+  QAtomicInt ringTail;
+  // A copy of generation/direction that the consumer can read without locking
+  QAtomicInt currentGeneration;
+  QAtomicInt currentDirection;
+
+  QString filePath;
+  const uchar *mappedData;
+  qint64 fileSize;
+
+  // The read window. This is protected by the controlMutex. Every time the window is moved to a position that does not
+  // continue the current stream of blocks, the generation is increased. Blocks of older generations are dropped.
+  QMutex controlMutex;
+  QWaitCondition controlCondition;
+  bool windowActive;
+  int generation;
+  qint64 windowStart;
+  qint64 windowEnd;   // Exclusive (in read direction)
+  qint64 nextReadPos;
+  qint64 blockSize;
+  int direction;
+};
+
+void fileSource::readAheadThread::setWindow(qint64 startPos, qint64 newBlockSize, int nrBlocks, int newDirection)
+{
+  QMutexLocker lock(&controlMutex);
+
+  const bool continueStream = windowActive && newBlockSize == blockSize && newDirection == direction &&
+                              (startPos - windowStart) % blockSize == 0 && (startPos - windowStart) * direction >= 0;
+  if (!continueStream)
+  {
+    // Start a new stream. All blocks that were read so far will be dropped.
+    generation++;
+    blockSize = newBlockSize;
+    direction = newDirection;
+    nextReadPos = startPos;
+    currentGeneration.storeRelease(generation);
+    currentDirection.storeRelease(direction);
+  }
+  else if ((startPos - nextReadPos) * direction > 0)
+    // The reader skipped some blocks. Continue reading from the new position.
+    nextReadPos = startPos;
+
+  windowActive = true;
+  windowStart = startPos;
+  windowEnd = startPos + direction * blockSize * nrBlocks;
+  controlCondition.wakeOne();
+}
+
+bool fileSource::readAheadThread::takeBlock(qint64 startPos, qint64 nrBytes, QByteArray &targetBuffer)
+{
+  const int gen = currentGeneration.loadAcquire();
+  const int dir = currentDirection.loadAcquire();
+  int head = ringHead.load();
+  while (head != ringTail.loadAcquire())
+  {
+    block &b = ring[head];
+    const bool stale = (b.generation != gen || b.data.size() != nrBytes || (b.pos - startPos) * dir < 0);
+    if (!stale && b.pos != startPos)
+      // The next block is ahead of the requested one. Keep it.
+      return false;
+
+    if (!stale)
+      targetBuffer = b.data;
+    b.data = QByteArray();
+    const bool ringWasFull = ((ringTail.loadAcquire() + 1) % ringSize == head);
+    head = (head + 1) % ringSize;
+    ringHead.storeRelease(head);
+    if (ringWasFull)
+    {
+      // The I/O thread may be waiting for a free slot in the ring. The mutex makes sure that it does not miss the wakeup.
+      QMutexLocker lock(&controlMutex);
+      controlCondition.wakeOne();
+    }
+
+    if (!stale)
+      return true;
+  }
+  return false;
+}
+
+void fileSource::readAheadThread::run()
+{
+  // Use a separate file handle so that reading does not interfere with the reads of the fileSource.
+  QFile file(filePath);
+  if (mappedData == nullptr && !file.open(QIODevice::ReadOnly))
+    return;
+
+  while (true)
+  {
+    qint64 pos, size;
+    int gen;
+    {
+      QMutexLocker lock(&controlMutex);
+      if (isInterruptionRequested())
+        return;
+      const int nrBlocksInRing = (ringTail.load() - ringHead.loadAcquire() + ringSize) % ringSize;
+      const bool readNext = windowActive && nrBlocksInRing < READ_AHEAD_MAX_BLOCKS && (windowEnd - nextReadPos) * direction > 0 &&
+                            nextReadPos >= 0 && nextReadPos + blockSize <= fileSize;
+      if (!readNext)
+      {
+        // Wait for the consumer to move the window or to take a block from the full ring.
+        controlCondition.wait(&controlMutex);
+        continue;
+      }
+      pos = nextReadPos;
+      size = blockSize;
+      gen = generation;
+      nextReadPos += direction * blockSize;
+    }
+
+    const int tail = ringTail.load();
+    block &b = ring[tail];
+    if (mappedData)
+    {
+      // Touch every page, so that the OS reads them now and not when the block is converted.
+      b.data = QByteArray::fromRawData((const char*)mappedData + pos, int(size));
+      const volatile uchar *p = mappedData + pos;
+      uchar sum = 0;
+      for (qint64 i = 0; i < size; i += 4096)
+        sum += p[i];
+      Q_UNUSED(sum);
+    }
+    else
+    {
+      b.data.resize(int(size));
+      if (!file.seek(pos) || file.read(b.data.data(), size) != size)
+      {
+        b.data = QByteArray();
+        continue;
+      }
+    }
+    b.pos = pos;
+    b.generation = gen;
+    ringTail.storeRelease((tail + 1) % ringSize);
+  }
+}
+
+fileSource::fileSource() :
+  mapLock(QReadWriteLock::Recursive)
 {
   fileChanged = false;
+  mappedData = nullptr;
+  mappedSize = 0;
+  lastReadEnd = -1;
 
   connect(&fileWatcher, &QFileSystemWatcher::fileChanged, this, &fileSource::fileSystemWatcherFileChanged);
 }
 
+fileSource::~fileSource()
+{
+  // Stop the read-ahead thread before the file (and the mapping) is closed.
+  readAheadWorker.reset();
+}
+
 bool fileSource::openFile(const QString &filePath)
 {
   // Check if the file exists
@@ -57,6 +265,10 @@ bool fileSource::openFile(const QString &filePath)
   if (!fileInfo.exists() || !fileInfo.isFile())
     return false;
 
+  // The read-ahead thread reads from the old file.
+  unmapFile();
+  readAheadWorker.reset();
+
   if (srcFile.isOpen())
     srcFile.close();
 
@@ -71,6 +283,8 @@ bool fileSource::openFile(const QString &filePath)
   // Install a watcher for the file (if file watching is active)
   updateFileWatchSetting();
 
+  mapFile();
+
   fileChanged = false;
 
   return true;
@@ -104,12 +318,121 @@ qint64 fileSource::readBytes(QByteArray &targetBuffer, qint64 startPos, qint64 n
   QThread::msleep(50);
 #endif
 
+  {
+    QReadLocker mapLocker(&mapLock);
+    if (mappedData && startPos >= 0 && startPos + nrBytes <= mappedSize)
+    {
+      // Copy from the mapped file. The mapping can not be removed while we copy.
+      std::memcpy(targetBuffer.data(), mappedData + startPos, nrBytes);
+      readAheadMapped(startPos, nrBytes);
+      return nrBytes;
+    }
+  }
+
   // lock the seek and read function
   QMutexLocker locker(&readMutex);
   srcFile.seek(startPos);
   return srcFile.read(targetBuffer.data(), nrBytes);
 }
 
+qint64 fileSource::readBytesView(QByteArray &targetBuffer, qint64 startPos, qint64 nrBytes)
+{
+  QReadLocker mapLocker(&mapLock);
+  if (readAheadWorker && readAheadWorker->takeBlock(startPos, nrBytes, targetBuffer))
+    // This block was already read by the read-ahead thread.
+    return nrBytes;
+
+  if (!mappedData || startPos < 0 || startPos + nrBytes > mappedSize || nrBytes > INT_MAX)
+    // Not mapped (or out of the mapped range). Read the data the normal way.
+    return readBytes(targetBuffer, startPos, nrBytes);
+
+  targetBuffer = QByteArray::fromRawData((const char*)mappedData + startPos, int(nrBytes));
+  readAheadMapped(startPos, nrBytes);
+  return nrBytes;
+}
+
+void fileSource::readAhead(qint64 startPos, qint64 blockSize, int nrBlocks, int direction)
+{
+  if (!isOk() || blockSize <= 0 || blockSize > INT_MAX)
+    return;
+
+  QReadLocker mapLocker(&mapLock);
+  // Limit the memory that the blocks which were read ahead may use.
+  nrBlocks = clip(nrBlocks, 0, READ_AHEAD_MAX_BLOCKS);
+  if (!mappedData)
+    nrBlocks = std::min(nrBlocks, int(std::max(qint64(1), READ_AHEAD_MAX_BYTES / blockSize)));
+  if (nrBlocks == 0)
+  {
+    stopReadAhead();
+    return;
+  }
+
+  if (!readAheadWorker)
+  {
+    readAheadWorker.reset(new readAheadThread(fileInfo.absoluteFilePath(), mappedData, mappedData ? mappedSize : fileInfo.size()));
+    readAheadWorker->start(QThread::HighPriority);
+  }
+  readAheadWorker->setWindow(startPos, blockSize, nrBlocks, (direction < 0) ? -1 : 1);
+}
+
+void fileSource::stopReadAhead()
+{
+  // Stop the I/O thread. This frees all blocks that were read ahead (also the one that is being read right now).
+  QReadLocker mapLocker(&mapLock);
+  readAheadWorker.reset();
+}
+
+void fileSource::mapFile()
+{
+  QSettings settings;
+  if (!settings.value("MemoryMapFiles", false).toBool() || fileWatcher.files().contains(fullFilePath))
+    return;
+
+  // On 32 bit systems, mapping big files will fail because there is not enough address space.
+  // In this case, we just keep reading from the file.
+  const qint64 size = srcFile.size();
+  if (size <= 0 || quint64(size) > quint64(std::numeric_limits<size_t>::max()))
+    return;
+  QWriteLocker mapLocker(&mapLock);
+  mappedData = srcFile.map(0, size);
+  if (mappedData)
+    mappedSize = size;
+}
+
+void fileSource::unmapFile()
+{
+  QWriteLocker mapLocker(&mapLock);
+  if (!mappedData)
+    return;
+
+  // The read-ahead thread may touch the pages of the mapping. Stop it first.
+  readAheadWorker.reset();
+  srcFile.unmap(mappedData);
+  mappedData = nullptr;
+  mappedSize = 0;
+  lastReadEnd = -1;
+}
+
+void fileSource::readAheadMapped(qint64 startPos, qint64 nrBytes)
+{
+  // Only if the reads are sequential (e.g. playback), the following block of the same size will be needed next.
+  // Ask the OS to start reading it in the background, so that the next read does not wait for page faults.
+  const bool sequential = (lastReadEnd.fetchAndStoreRelaxed(startPos + nrBytes) == startPos);
+#ifdef Q_OS_UNIX
+  const qint64 aheadStart = startPos + nrBytes;
+  const qint64 aheadEnd = std::min(aheadStart + nrBytes, mappedSize);
+  if (!sequential || aheadStart >= aheadEnd)
+    return;
+
+  // The address passed to madvise must be aligned to the page size.
+  static const qint64 pageSize = sysconf(_SC_PAGESIZE);
+  const qint64 alignedStart = aheadStart - (aheadStart % pageSize);
+  madvise(mappedData + alignedStart, size_t(aheadEnd - alignedStart), MADV_WILLNEED);
+#else
+  Q_UNUSED(sequential);
+#endif
+}
+
 QList<infoItem> fileSource::getFileInfoList() const
 {
   QList<infoItem> infoList;
@@ -296,7 +619,11 @@ void fileSource::updateFileWatchSetting()
   // The addPath/removePath functions will do nothing if called twice for the same file.
   QSettings settings;
   if (settings.value("WatchFiles",true).toBool())
+  {
+    // A watched file may be shortened while it is open. Reading from a mapping of it would crash then.
+    unmapFile();
     fileWatcher.addPath(fullFilePath);
+  }
   else
     fileWatcher.removePath(fullFilePath);
 }
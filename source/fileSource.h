@@ -33,11 +33,14 @@
 #ifndef FILESOURCE_H
 #define FILESOURCE_H
 
+#include <QAtomicInteger>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QScopedPointer>
 #include <QString>
 #include "fileInfoWidget.h"
 
@@ -51,6 +54,7 @@ class fileSource : public QObject
 
 public:
   fileSource();
+  ~fileSource();
 
   // Try to open the given file and install a watcher for the file.
   virtual bool openFile(const QString &filePath);
@@ -82,6 +86,20 @@ public:
   // Read the given number of bytes starting at startPos into the QByteArray out
   // Resize the QByteArray if necessary. Return how many bytes were read.
   qint64 readBytes(QByteArray &targetBuffer, qint64 startPos, qint64 nrBytes);
+  // Same as readBytes, but if the file is memory mapped, targetBuffer is set to point directly into the mapped file (no copy).
+  // Such a view is only valid until the file is closed, reopened or unmapped (see updateFileWatchSetting()). Writing to it
+  // (non-const access) will detach/copy it.
+  qint64 readBytesView(QByteArray &targetBuffer, qint64 startPos, qint64 nrBytes);
+  // Is the file memory mapped (see the "MemoryMapFiles" setting)? Files that are watched for changes are never mapped.
+  bool isMapped() const { return mappedData != nullptr; }
+
+  // --- Read-ahead: A dedicated I/O thread reads the following blocks (e.g. the next frames during playback) in the
+  // background. The blocks are handed over through a lock-free ring buffer and readBytesView() returns a block
+  // without reading if it was read ahead. Only one thread at a time may call readBytesView(), readAhead() and stopReadAhead().
+  // Read up to nrBlocks blocks of blockSize bytes starting at startPos. Direction is 1 (forward) or -1 (backward).
+  void readAhead(qint64 startPos, qint64 blockSize, int nrBlocks, int direction=1);
+  // Stop reading ahead (the I/O thread ends) and free all blocks that were read ahead.
+  void stopReadAhead();
 #if SSE_CONVERSION
   void readBytes(byteArrayAligned &data, qint64 startPos, qint64 nrBytes);
 #endif
@@ -94,6 +112,7 @@ public:
   // Was the file changed by some other application?
   bool isFileChanged() { bool b = fileChanged; fileChanged = false; return b; }
   // Check if we are supposed to watch the file for changes. If no, remove the file watcher. If yes, install one.
+  // If the file is watched now, the memory mapping is removed. All views into the mapping must be released before.
   void updateFileWatchSetting();
 
 private slots:
@@ -114,6 +133,24 @@ private:
 
   // protect the read function with a mutex
   QMutex readMutex;
+
+  // If the file is memory mapped, this points to the mapped file (mappedSize bytes). Reading from the mapping
+  // needs no seek/read calls. The mapLock is only locked for writing when the mapping is removed.
+  uchar *mappedData;
+  qint64 mappedSize;
+  QReadWriteLock mapLock;
+  // Map the whole file if this is enabled in the settings and the file is not watched. If another application shortens
+  // a mapped file, reading from the mapping crashes. So we don't map files that we expect to be changed. If mapping
+  // fails, we just read from the file.
+  void mapFile();
+  void unmapFile();
+  // Ask the OS to read ahead the data after the given read if the reads are sequential (playback).
+  void readAheadMapped(qint64 startPos, qint64 nrBytes);
+  QAtomicInteger<qint64> lastReadEnd;
+
+  // The I/O thread for the read-ahead. It is created when readAhead() is called for the first time.
+  class readAheadThread;
+  QScopedPointer<readAheadThread> readAheadWorker;
 };
 
 #endif
@@ -36,10 +36,22 @@
 #include <cassert>
 #include <cmath>
 #include <exception>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEVCANNEXBFILE_SSE2_STARTCODE_SEARCH 1
+#endif
 #include <QApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDebug>
+#include <QDir>
 #include <QProgressDialog>
+#include <QSaveFile>
+#include <QSet>
 #include <QSize>
+#include <QStandardPaths>
+#include <QtConcurrent>
 #include "mainwindow.h"
 #include "typedef.h"
 
@@ -51,6 +63,9 @@
 #define DEBUG_ANNEXB(fmt,...) ((void)0)
 #endif
 
+// Increase this if the format of the NAL unit index file changes. Index files with another version are ignored.
+#define NAL_UNIT_INDEX_VERSION 1
+
 unsigned int fileSourceHEVCAnnexBFile::sub_byte_reader::readBits(int nrBits, QString *bitsRead)
 {
   int out = 0;
@@ -483,13 +498,13 @@ void fileSourceHEVCAnnexBFile::pred_weight_table::parse_pred_weight_table(sub_by
   }
 }
 
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumNegativePics[65];
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumPositivePics[65];
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::DeltaPocS0[65][16];
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::DeltaPocS1[65][16];
-bool fileSourceHEVCAnnexBFile::st_ref_pic_set::UsedByCurrPicS0[65][16];
-bool fileSourceHEVCAnnexBFile::st_ref_pic_set::UsedByCurrPicS1[65][16];
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumDeltaPocs[65];
+thread_local int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumNegativePics[65];
+thread_local int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumPositivePics[65];
+thread_local int fileSourceHEVCAnnexBFile::st_ref_pic_set::DeltaPocS0[65][16];
+thread_local int fileSourceHEVCAnnexBFile::st_ref_pic_set::DeltaPocS1[65][16];
+thread_local bool fileSourceHEVCAnnexBFile::st_ref_pic_set::UsedByCurrPicS0[65][16];
+thread_local bool fileSourceHEVCAnnexBFile::st_ref_pic_set::UsedByCurrPicS1[65][16];
+thread_local int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumDeltaPocs[65];
 
 void fileSourceHEVCAnnexBFile::st_ref_pic_set::parse_st_ref_pic_set(sub_byte_reader &reader, int stRpsIdx, sps *actSPS, TreeItem *root)
 {
@@ -1158,9 +1173,9 @@ void fileSourceHEVCAnnexBFile::ref_pic_lists_modification::parse_ref_pic_lists_m
 }
 
 // Initialize static member. Only true for the first slice instance
-bool fileSourceHEVCAnnexBFile::slice::bFirstAUInDecodingOrder = true;
-int fileSourceHEVCAnnexBFile::slice::prevTid0Pic_slice_pic_order_cnt_lsb = 0;
-int fileSourceHEVCAnnexBFile::slice::prevTid0Pic_PicOrderCntMsb = 0;
+thread_local bool fileSourceHEVCAnnexBFile::slice::bFirstAUInDecodingOrder = true;
+thread_local int fileSourceHEVCAnnexBFile::slice::prevTid0Pic_slice_pic_order_cnt_lsb = 0;
+thread_local int fileSourceHEVCAnnexBFile::slice::prevTid0Pic_PicOrderCntMsb = 0;
 
 fileSourceHEVCAnnexBFile::slice::slice(const nal_unit &nal) : nal_unit(nal)
 {
@@ -1465,23 +1480,18 @@ fileSourceHEVCAnnexBFile::fileSourceHEVCAnnexBFile()
   posInBuffer = 0;
   bufferStartPosInFile = 0;
   numZeroBytes = 0;
-
-  // Set the start code to look for (0x00 0x00 0x01)
-  startCode.append((char)0);
-  startCode.append((char)0);
-  startCode.append((char)1);
+  nalIndex.reset(new nalUnitIndex);
+  cancelBackgroundScan.store(0);
 }
 
 fileSourceHEVCAnnexBFile::~fileSourceHEVCAnnexBFile()
 {
-  if (!nalUnitListCopied)
-    // We created all the instances in the nalUnitList. Delete them all again.
-    qDeleteAll(nalUnitList);
-  nalUnitList.clear();
+  // The index (and all NAL units in it) is deleted when the last file using it is deleted.
+  stopBackgroundScan();
 }
 
 // Open the file and fill the read buffer. 
-// Then scan the file for NAL units and save the start of every NAL unit in the file.
+// Then scan the file for NAL units (in the background) and save the start of every NAL unit in the file.
 // If full parsing is enabled, all parameter set data will be fully parsed and saved in the tree structure
 // so that it can be used by the QAbstractItemModel.
 bool fileSourceHEVCAnnexBFile::openFile(const QString &fileName, bool saveAllUnits, fileSourceHEVCAnnexBFile *otherFile)
@@ -1500,10 +1510,8 @@ bool fileSourceHEVCAnnexBFile::openFile(const QString &fileName, bool saveAllUni
     bufferStartPosInFile = 0;
     numZeroBytes = 0;
 
-    // Clear out knowloedget of the bitstream
-    qDeleteAll(nalUnitList);
-    nalUnitList.clear();
-    POC_List.clear();
+    // Stop scanning the old file. Other files may still use the old index, so we just create a new one below.
+    stopBackgroundScan();
   }
 
   // Open the input file (again)
@@ -1516,96 +1524,318 @@ bool fileSourceHEVCAnnexBFile::openFile(const QString &fileName, bool saveAllUni
     return false;
     
   // Get the positions where we can start decoding
-  nalUnitListCopied = (otherFile != nullptr);
   if (otherFile)
   {
-    // Copy the nalUnitList and POC_List from the other file
-    POC_List = otherFile->POC_List;
-    nalUnitList = otherFile->nalUnitList;
+    // Use the index of the other file. If it is still scanned in the background, new POCs will show up here as well.
+    nalIndex = otherFile->nalIndex;
     return true;
   }
-  else
-    return scanFileForNalUnits(saveAllUnits);
+
+  nalIndex.reset(new nalUnitIndex);
+  if (saveAllUnits)
+  {
+    // If all units are saved (for the NAL unit model), the file has to be parsed completely.
+    if (!scanFileForNalUnits(true))
+      return false;
+    saveNalUnitIndex();
+    return true;
+  }
+  if (loadNalUnitIndex())
+    return true;
+
+  // Scan the file in the background using a second reader that shares our index
+  backgroundScanner.reset(new fileSourceHEVCAnnexBFile);
+  if (!backgroundScanner->openFile(fileName, false, this))
+  {
+    backgroundScanner.reset();
+    return false;
+  }
+  nalIndex->scanRunning = true;
+  backgroundScanFuture = QtConcurrent::run(backgroundScanner.data(), &fileSourceHEVCAnnexBFile::scanFileInBackground);
+
+  // Wait until the first pictures are known (or the scan finished) so that the first frame can be decoded right away.
+  QMutexLocker locker(&nalIndex->mutex);
+  while (nalIndex->POC_List.isEmpty() && nalIndex->scanRunning)
+    nalIndex->pocsAdded.wait(&nalIndex->mutex);
+  return true;
 }
 
-bool fileSourceHEVCAnnexBFile::updateBuffer()
+void fileSourceHEVCAnnexBFile::scanFileInBackground()
 {
-  // Save the position of the first byte in this new buffer
-  bufferStartPosInFile += fileBufferSize;
+  // This runs in the backgroundScanner instance
+  bool scanComplete = scanFileForNalUnits(false, true);
+  {
+    QMutexLocker locker(&nalIndex->mutex);
+    nalIndex->scanRunning = false;
+    nalIndex->pocsAdded.wakeAll();
+  }
+  if (scanComplete)
+    // The index is not modified anymore
+    saveNalUnitIndex();
+}
 
-  fileBufferSize = srcFile.read(fileBuffer.data(), BUFFER_SIZE);
-  posInBuffer = 0;
+void fileSourceHEVCAnnexBFile::stopBackgroundScan()
+{
+  if (backgroundScanFuture.isRunning())
+  {
+    // signal to background thread that we want to cancel the processing
+    backgroundScanner->cancelBackgroundScan.storeRelease(1);
+    backgroundScanFuture.waitForFinished();
+  }
+  backgroundScanner.reset();
+}
 
-  DEBUG_ANNEXB("fileSourceHEVCAnnexBFile::updateBuffer fileBufferSize %d", fileBufferSize);
-  return (fileBufferSize > 0);
+bool fileSourceHEVCAnnexBFile::isScanningInBackground() const
+{
+  QMutexLocker locker(&nalIndex->mutex);
+  return nalIndex->scanRunning;
 }
 
-bool fileSourceHEVCAnnexBFile::seekToNextNALUnit()
+double fileSourceHEVCAnnexBFile::getBackgroundScanProgress() const
 {
-  // Are we currently at the one byte of a start code?
-  if (curPosAtStartCode())
-    return gotoNextByte();
+  QMutexLocker locker(&nalIndex->mutex);
+  return nalIndex->scanProgress;
+}
 
-  numZeroBytes = 0;
-  
-  // Check if there is another start code in the buffer
-  int idx = fileBuffer.indexOf(startCode, posInBuffer);
-  while (idx < 0) 
+int fileSourceHEVCAnnexBFile::getNumberPOCs() const
+{
+  QMutexLocker locker(&nalIndex->mutex);
+  return nalIndex->POC_List.size();
+}
+
+QString fileSourceHEVCAnnexBFile::getNalUnitIndexFilePath() const
+{
+  const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  if (cacheDir.isEmpty())
+    return QString();
+  const QByteArray pathHash = QCryptographicHash::hash(fileInfo.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+  return QDir(cacheDir).filePath(QString("annexBIndex/%1.idx").arg(QString(pathHash)));
+}
+
+bool fileSourceHEVCAnnexBFile::loadNalUnitIndex()
+{
+  QFile indexFile(getNalUnitIndexFilePath());
+  if (!indexFile.open(QIODevice::ReadOnly))
+    return false;
+
+  QDataStream in(&indexFile);
+  in.setVersion(QDataStream::Qt_5_0);
+
+  // Check if the index belongs to this file and if the file was not modified since the index was written.
+  QByteArray magic;
+  qint32 version;
+  QString path;
+  qint64 size, lastModified;
+  in >> magic >> version >> path >> size >> lastModified;
+  if (in.status() != QDataStream::Ok || magic != "YUViewAnnexBIndex" || version != NAL_UNIT_INDEX_VERSION ||
+      path != fileInfo.absoluteFilePath() || size != fileInfo.size() || lastModified != fileInfo.lastModified().toMSecsSinceEpoch())
   {
-    // Start code not found in this buffer. Load next chuck of data from file.
+    DEBUG_ANNEXB("fileSourceHEVCAnnexBFile::loadNalUnitIndex index outdated");
+    return false;
+  }
 
-    // Before we load more data, check with how many zeroes the current buffer ends.
-    // This could be the beginning of a start code.
-    int nrZeros = 0;
-    for (int i = 1; i <= 3; i++) 
-    {
-      if (fileBuffer.at(fileBufferSize-i) == 0)
-        nrZeros++;
-    }
-    
-    // Load the next buffer
-    if (!updateBuffer()) 
-    {
-      // Out of file
-      return false;
-    }
+  QList<int> indexPOCList;
+  qint32 nrNalUnits;
+  in >> indexPOCList >> nrNalUnits;
 
-    if (nrZeros > 0)
+  QList<nal_unit*> indexNalUnitList;
+  try
+  {
+    for (int i = 0; i < nrNalUnits && in.status() == QDataStream::Ok; i++)
     {
-      // The last buffer ended with zeroes. 
-      // Now check if the beginning of this buffer is the remaining part of a start code
-      if ((nrZeros == 2 || nrZeros == 3) && fileBuffer.at(0) == 1) 
+      quint64 filePos;
+      qint32 nalType, layerID, temporalIDPlus1;
+      in >> filePos >> nalType >> layerID >> temporalIDPlus1;
+      nal_unit nal(filePos);
+      nal.nal_type = nal_unit_type(nalType);
+      nal.nuh_layer_id = layerID;
+      nal.nuh_temporal_id_plus1 = temporalIDPlus1;
+
+      if (nal.nal_type == VPS_NUT || nal.nal_type == SPS_NUT || nal.nal_type == PPS_NUT)
       {
-        // Start code found
-        posInBuffer = 1;
-        return true;
+        QByteArray parameterSetData;
+        in >> parameterSetData;
+        if (nal.nal_type == VPS_NUT)
+        {
+          vps *new_vps = new vps(nal);
+          indexNalUnitList.append(new_vps);
+          new_vps->parse_vps(parameterSetData, nullptr);
+        }
+        else if (nal.nal_type == SPS_NUT)
+        {
+          sps *new_sps = new sps(nal);
+          indexNalUnitList.append(new_sps);
+          new_sps->parse_sps(parameterSetData, nullptr);
+        }
+        else
+        {
+          pps *new_pps = new pps(nal);
+          indexNalUnitList.append(new_pps);
+          new_pps->parse_pps(parameterSetData, nullptr);
+        }
       }
-
-      if ((nrZeros == 1) && fileBuffer.at(0) == 0 && fileBuffer.at(1) == 1) 
+      else if (nal.isSlice())
       {
-        // Start code found
-        posInBuffer = 2;
-        return true;
+        // For the random access points, only the POC is needed
+        qint32 poc;
+        bool firstSliceSegmentInPic;
+        in >> poc >> firstSliceSegmentInPic;
+        slice *newSlice = new slice(nal);
+        newSlice->PicOrderCntVal = poc;
+        newSlice->first_slice_segment_in_pic_flag = firstSliceSegmentInPic;
+        indexNalUnitList.append(newSlice);
       }
+      else
+        throw std::logic_error("Unexpected NAL unit type in the index.");
     }
+  }
+  catch (...)
+  {
+    in.setStatus(QDataStream::ReadCorruptData);
+  }
 
-    // New buffer loaded but no start code found yet. Search for it again.
-    idx = fileBuffer.indexOf(startCode, posInBuffer);
+  if (in.status() != QDataStream::Ok || indexNalUnitList.count() != nrNalUnits)
+  {
+    DEBUG_ANNEXB("fileSourceHEVCAnnexBFile::loadNalUnitIndex reading index failed");
+    qDeleteAll(indexNalUnitList);
+    return false;
   }
 
-  assert(idx >= 0);
-  if (quint64(idx + 3) >= fileBufferSize) 
+  DEBUG_ANNEXB("fileSourceHEVCAnnexBFile::loadNalUnitIndex loaded %d NAL units and %d POCs", nrNalUnits, indexPOCList.count());
+  QMutexLocker locker(&nalIndex->mutex);
+  nalIndex->nalUnitList = indexNalUnitList;
+  nalIndex->POC_List = indexPOCList;
+  return true;
+}
+
+void fileSourceHEVCAnnexBFile::saveNalUnitIndex() const
+{
+  const QString indexFilePath = getNalUnitIndexFilePath();
+  if (indexFilePath.isEmpty() || !QDir().mkpath(QFileInfo(indexFilePath).absolutePath()))
+    return;
+
+  // Write to a temporary file first, so that an incomplete index is never read.
+  QSaveFile indexFile(indexFilePath);
+  if (!indexFile.open(QIODevice::WriteOnly))
+    return;
+
+  QDataStream out(&indexFile);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << QByteArray("YUViewAnnexBIndex") << qint32(NAL_UNIT_INDEX_VERSION) << fileInfo.absoluteFilePath() << qint64(fileInfo.size()) << qint64(fileInfo.lastModified().toMSecsSinceEpoch());
+  QMutexLocker locker(&nalIndex->mutex);
+  out << nalIndex->POC_List << qint32(nalIndex->nalUnitList.count());
+  for (nal_unit *nal : nalIndex->nalUnitList)
   {
-    // The start code is exactly at the end of the current buffer. 
-    if (!updateBuffer()) 
+    out << quint64(nal->filePos) << qint32(nal->nal_type) << qint32(nal->nuh_layer_id) << qint32(nal->nuh_temporal_id_plus1);
+    if (nal->nal_type == VPS_NUT || nal->nal_type == SPS_NUT || nal->nal_type == PPS_NUT)
+      out << dynamic_cast<parameter_set_nal*>(nal)->parameter_set_data;
+    else
+    {
+      slice *s = dynamic_cast<slice*>(nal);
+      out << qint32(s->PicOrderCntVal) << s->first_slice_segment_in_pic_flag;
+    }
+  }
+
+  if (out.status() == QDataStream::Ok)
+    indexFile.commit();
+}
+
+bool fileSourceHEVCAnnexBFile::updateBuffer()
+{
+  // Save the position of the first byte in this new buffer
+  bufferStartPosInFile += fileBufferSize;
+
+  fileBufferSize = srcFile.read(fileBuffer.data(), BUFFER_SIZE);
+  posInBuffer = 0;
+
+  DEBUG_ANNEXB("fileSourceHEVCAnnexBFile::updateBuffer fileBufferSize %d", fileBufferSize);
+  return (fileBufferSize > 0);
+}
+
+// Find the first start code (0x00 0x00 0x01) in data[from...size-1]. Return the index of its first byte or -1.
+static int findStartCode(const char *data, int size, int from)
+{
+  int i = from;
+#if HEVCANNEXBFILE_SSE2_STARTCODE_SEARCH
+  // Check 16 bytes at a time. Only if there are two zero bytes in a row in the block, the positions are checked.
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 18 <= size; i += 16)
+  {
+    const __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+    int zeroMask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+    // Bit j is set if the bytes j and j+1 are zero. For j=15, the byte after the block is checked.
+    int pairMask = zeroMask & ((zeroMask >> 1) | ((data[i + 16] == 0) ? 0x8000 : 0));
+    for (int j = 0; pairMask != 0; j++, pairMask >>= 1)
+      if ((pairMask & 1) && data[i + j + 2] == 1)
+        return i + j;
+  }
+#endif
+  // Check the remaining bytes. If the third byte is bigger than 1, there can be no start code starting at any of the three bytes.
+  while (i + 2 < size)
+  {
+    const unsigned char c = (unsigned char)data[i + 2];
+    if (c > 1)
+      i += 3;
+    else if (c == 1 && data[i] == 0 && data[i + 1] == 0)
+      return i;
+    else
+      i++;
+  }
+  return -1;
+}
+
+qint64 fileSourceHEVCAnnexBFile::skipToStartCode(QByteArray *data, qint64 maxBytes)
+{
+  qint64 nrBytesPassed = 0;
+  while (!curPosAtStartCode())
+  {
+    if (maxBytes != -1 && nrBytesPassed >= maxBytes)
+      return nrBytesPassed;
+
+    if (numZeroBytes > 0)
+    {
+      // The previous bytes were zero. They might belong to a start code that began before the current position
+      // (maybe even in the previous buffer). Go on byte by byte until this is resolved.
+      if (data)
+        data->append(getCurByte());
+      nrBytesPassed++;
+      if (!gotoNextByte())
+        return -1;
+      continue;
+    }
+
+    // The byte before the current position is not zero. A start code can only start at or after the current position.
+    // Pass all bytes up to the 0x01 byte of the next start code in the buffer (or up to the end of the buffer).
+    const int idx = findStartCode(fileBuffer.constData(), int(fileBufferSize), int(posInBuffer));
+    qint64 n = ((idx >= 0) ? qint64(idx + 2) : qint64(fileBufferSize)) - posInBuffer;
+    if (maxBytes != -1)
+      n = std::min(n, maxBytes - nrBytesPassed);
+
+    const char *src = fileBuffer.constData() + posInBuffer;
+    if (data)
+      data->append(src, int(n));
+    nrBytesPassed += n;
+
+    // Count the zero bytes at the end of the passed bytes
+    int zeros = 0;
+    while (zeros < n && src[n - 1 - zeros] == 0)
+      zeros++;
+    numZeroBytes = zeros;
+
+    posInBuffer += n;
+    if (posInBuffer >= fileBufferSize && !updateBuffer())
       // Out of file
-      return false;
-    return true;
+      return -1;
   }
+  return nrBytesPassed;
+}
 
-  // Update buffer position
-  posInBuffer = idx + 3;
-  return true;
+bool fileSourceHEVCAnnexBFile::seekToNextNALUnit()
+{
+  // Go to the one byte of the next start code (if we are not already there) and then to the first byte after it.
+  if (skipToStartCode(nullptr) < 0)
+    return false;
+  return gotoNextByte();
 }
 
 bool fileSourceHEVCAnnexBFile::gotoNextByte()
@@ -1632,30 +1862,44 @@ bool fileSourceHEVCAnnexBFile::gotoNextByte()
   return true;
 }
 
-bool fileSourceHEVCAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
+bool fileSourceHEVCAnnexBFile::scanFileForNalUnits(bool saveAllUnits, bool inBackground)
 {
-  DEBUG_ANNEXB("fileSourceHEVCAnnexBFile::scanFileForNalUnits %s", saveAllUnits ? "saveAllUnits" : "");
+  DEBUG_ANNEXB("fileSourceHEVCAnnexBFile::scanFileForNalUnits %s %s", saveAllUnits ? "saveAllUnits" : "", inBackground ? "inBackground" : "");
 
-  // Show a modal QProgressDialog while this operation is running.
+  // If not running in the background, show a modal QProgressDialog while this operation is running.
   // If the user presses cancel, we will cancel and return false (opening the file failed).
-  // First, get a pointer to the main window to use as a parent for the modal parsing progress dialog.
-  QWidgetList l = QApplication::topLevelWidgets();
-  QWidget *mainWindow = nullptr;
-  for (QWidget *w : l)
+  QScopedPointer<QProgressDialog> progress;
+  if (!inBackground)
   {
-    MainWindow *mw = dynamic_cast<MainWindow*>(w);
-    if (mw)
-      mainWindow = mw;
+    // First, get a pointer to the main window to use as a parent for the modal parsing progress dialog.
+    QWidgetList l = QApplication::topLevelWidgets();
+    QWidget *mainWindow = nullptr;
+    for (QWidget *w : l)
+    {
+      MainWindow *mw = dynamic_cast<MainWindow*>(w);
+      if (mw)
+        mainWindow = mw;
+    }
+    // Create the dialog
+    progress.reset(new QProgressDialog("Parsing AnnexB bitstream...", "Cancel", 0, 100, mainWindow));
+    progress->setMinimumDuration(1000);  // Show after 1s
+    progress->setAutoClose(false);
+    progress->setAutoReset(false);
+    progress->setWindowModality(Qt::WindowModal);
   }
-  // Create the dialog
   qint64 maxPos = getFileSize();
   // Updating the dialog (setValue) is quite slow. Only do this if the percent value changes.
   int curPercentValue = 0;
-  QProgressDialog progress("Parsing AnnexB bitstream...", "Cancel", 0, 100, mainWindow);
-  progress.setMinimumDuration(1000);  // Show after 1s
-  progress.setAutoClose(false);
-  progress.setAutoReset(false);
-  progress.setWindowModality(Qt::WindowModal);
+
+  // Start the POC calculation of this thread from scratch
+  slice::bFirstAUInDecodingOrder = true;
+  slice::prevTid0Pic_slice_pic_order_cnt_lsb = 0;
+  slice::prevTid0Pic_PicOrderCntMsb = 0;
+
+  // All POCs found so far (two pictures with the same POC are not allowed) and the POCs that were found
+  // since the last random access point. These are not in the index yet.
+  QSet<int> foundPOCs;
+  QList<int> newPOCs;
 
   // These maps hold the last active VPS, SPS and PPS. This is required for parsing
   // the parameter sets.
@@ -1706,7 +1950,7 @@ bool fileSourceHEVCAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
         new_vps->parse_vps(getRemainingNALBytes(), nalRoot);
 
         // Put parameter sets into the NAL unit list
-        nalUnitList.append(new_vps);
+        addNalUnitToIndex(new_vps);
 
         // Add the VPS ID
         specificDescription = QString(" VPS_NUT ID %1").arg(new_vps->vps_video_parameter_set_id);
@@ -1721,7 +1965,7 @@ bool fileSourceHEVCAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
         active_SPS_list.insert(new_sps->sps_seq_parameter_set_id, new_sps);
 
         // Also add sps to list of all nals
-        nalUnitList.append(new_sps);
+        addNalUnitToIndex(new_sps);
 
         // Add the SPS ID
         specificDescription = QString(" SPS_NUT ID %1").arg(new_sps->sps_seq_parameter_set_id);
@@ -1736,7 +1980,7 @@ bool fileSourceHEVCAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
         active_PPS_list.insert(new_pps->pps_pic_parameter_set_id, new_pps);
 
         // Also add pps to list of all nals
-        nalUnitList.append(new_pps);
+        addNalUnitToIndex(new_pps);
 
         // Add the PPS ID
         specificDescription = QString(" PPS_NUT ID %1").arg(new_pps->pps_pic_parameter_set_id);
@@ -1753,15 +1997,30 @@ bool fileSourceHEVCAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
         if (newSlice->first_slice_segment_in_pic_flag)
           lastFirstSliceSegmentInPic = newSlice;
 
+        if (nal.isIRAP() && newSlice->first_slice_segment_in_pic_flag)
+          // All pictures before a random access point in decoding order (also) precede it and its leading pictures
+          // in output order. So all POCs up to here are final and the pictures can be used.
+          addPOCsToIndex(newPOCs);
+
         // Get the poc and add it to the POC list
-        if (newSlice->PicOrderCntVal >= 0)
-          addPOCToList(newSlice->PicOrderCntVal);
+        if (newSlice->PicOrderCntVal >= 0 && !foundPOCs.contains(newSlice->PicOrderCntVal))
+        {
+          foundPOCs.insert(newSlice->PicOrderCntVal);
+          newPOCs.append(newSlice->PicOrderCntVal);
+
+          // A picture is preceded in decoding order by at most sps_max_num_reorder_pics pictures that follow it in output
+          // order. So every following picture has a higher POC than all but the sps_max_num_reorder_pics highest POCs so far.
+          // These are final and the pictures can be used without waiting for the next random access point (which may
+          // never come in a low delay stream).
+          if (newSlice->actSPS && !newSlice->actSPS->sps_max_num_reorder_pics.isEmpty())
+            addPOCsToIndex(newPOCs, newSlice->actSPS->sps_max_num_reorder_pics.last());
+        }
 
         if (nal.isIRAP())
         {
           if (newSlice->first_slice_segment_in_pic_flag)
             // This is the first slice of a random access pont. Add it to the list.
-            nalUnitList.append(newSlice);
+            addNalUnitToIndex(newSlice);
           else
             delete newSlice;
         }
@@ -1785,17 +2044,26 @@ bool fileSourceHEVCAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
       nalID++;
 
       // Update the progress dialog
-      if (progress.wasCanceled())
+      if (inBackground && cancelBackgroundScan.loadAcquire())
+        return false;
+      if (progress && progress->wasCanceled())
       {
-        POC_List.clear();
-        qDeleteAll(nalUnitList);
-        nalUnitList.clear();
+        QMutexLocker locker(&nalIndex->mutex);
+        nalIndex->POC_List.clear();
+        qDeleteAll(nalIndex->nalUnitList);
+        nalIndex->nalUnitList.clear();
         return false;
       }
       int newPercentValue = pos() * 100 / maxPos;
       if (newPercentValue != curPercentValue)
       {
-        progress.setValue(newPercentValue);
+        if (progress)
+          progress->setValue(newPercentValue);
+        else
+        {
+          QMutexLocker locker(&nalIndex->mutex);
+          nalIndex->scanProgress = newPercentValue;
+        }
         curPercentValue = newPercentValue;
       }
     }
@@ -1807,10 +2075,11 @@ bool fileSourceHEVCAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
   }
 
   // We are done.
-  progress.close();
+  if (progress)
+    progress->close();
 
-  // Finally sort the POC list
-  std::sort(POC_List.begin(), POC_List.end());
+  // Finally add the POCs after the last random access point
+  addPOCsToIndex(newPOCs);
   
   return true;
 }
@@ -1818,19 +2087,9 @@ bool fileSourceHEVCAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
 QByteArray fileSourceHEVCAnnexBFile::getRemainingNALBytes(int maxBytes)
 {
   QByteArray retArray;
-  int nrBytesRead = 0;
-
-  while (!curPosAtStartCode() && (maxBytes == -1 || nrBytesRead < maxBytes)) 
-  {
-    // Save byte and goto the next one
-    retArray.append( getCurByte() );
-
-    if (!gotoNextByte())
-      // No more bytes. Return all we got.
-      return retArray;
-
-    nrBytesRead++;
-  }
+  if (skipToStartCode(&retArray, maxBytes) < 0)
+    // No more bytes. Return all we got.
+    return retArray;
 
   // We should now be at a header byte. Remove the zeroes from the start code that we put into retArray
   while (retArray.endsWith(char(0))) 
@@ -1840,30 +2099,43 @@ QByteArray fileSourceHEVCAnnexBFile::getRemainingNALBytes(int maxBytes)
   return retArray;
 }
 
-bool fileSourceHEVCAnnexBFile::addPOCToList(int poc)
+void fileSourceHEVCAnnexBFile::addNalUnitToIndex(nal_unit *nal)
 {
-  if (poc < 0)
-    return false;
+  QMutexLocker locker(&nalIndex->mutex);
+  nalIndex->nalUnitList.append(nal);
+}
 
-  if (POC_List.contains(poc))
-    // Two pictures with the same POC are not allowed
-    return false;
-  
-  POC_List.append(poc);
-  return true;
+void fileSourceHEVCAnnexBFile::addPOCsToIndex(QList<int> &newPOCs, int keepNrPOCs)
+{
+  const int nrFinalPOCs = newPOCs.size() - std::max(keepNrPOCs, 0);
+  if (nrFinalPOCs <= 0)
+    return;
+
+  // Normally, the new POCs are all higher than the ones in the index (they follow in output order).
+  std::sort(newPOCs.begin(), newPOCs.end());
+  QMutexLocker locker(&nalIndex->mutex);
+  bool inOrder = nalIndex->POC_List.isEmpty() || nalIndex->POC_List.last() < newPOCs.first();
+  nalIndex->POC_List.append(newPOCs.mid(0, nrFinalPOCs));
+  if (!inOrder)
+    // This only happens if the POC is reset within the sequence (which is not supported). Keep the list sorted anyway.
+    std::sort(nalIndex->POC_List.begin(), nalIndex->POC_List.end());
+  nalIndex->pocsAdded.wakeAll();
+  newPOCs.erase(newPOCs.begin(), newPOCs.begin() + nrFinalPOCs);
 }
 
 // Look through the random access points and find the closest one before (or equal)
 // the given frameIdx where we can start decoding
 int fileSourceHEVCAnnexBFile::getClosestSeekableFrameNumber(int frameIdx) const
 {
+  QMutexLocker locker(&nalIndex->mutex);
+
   // Get the POC for the frame number
-  int iPOC = POC_List[frameIdx];
+  int iPOC = nalIndex->POC_List[frameIdx];
 
   // We schould always be able to seek to the beginning of the file
-  int bestSeekPOC = POC_List[0];
+  int bestSeekPOC = nalIndex->POC_List[0];
 
-  for (nal_unit *nal : nalUnitList)
+  for (nal_unit *nal : nalIndex->nalUnitList)
   {
     if (nal->isSlice()) 
     {
@@ -1879,20 +2151,47 @@ int fileSourceHEVCAnnexBFile::getClosestSeekableFrameNumber(int frameIdx) const
   }
 
   // Get the frame index for the given POC
-  return POC_List.indexOf(bestSeekPOC);
+  return nalIndex->POC_List.indexOf(bestSeekPOC);
+}
+
+QList<int> fileSourceHEVCAnnexBFile::getSeekableFrameNumbers() const
+{
+  QMutexLocker locker(&nalIndex->mutex);
+
+  QList<int> frames;
+  for (nal_unit *nal : nalIndex->nalUnitList)
+  {
+    if (nal->isSlice()) 
+    {
+      // We can cast this to a slice.
+      slice *s = dynamic_cast<slice*>(nal);
+
+      // The POC_List is sorted. The POC of the random access point might not be in the list yet (background scan).
+      auto it = std::lower_bound(nalIndex->POC_List.constBegin(), nalIndex->POC_List.constEnd(), s->PicOrderCntVal);
+      if (it != nalIndex->POC_List.constEnd() && *it == s->PicOrderCntVal)
+        frames.append(int(it - nalIndex->POC_List.constBegin()));
+    }
+  }
+
+  // There may be multiple slices per picture
+  std::sort(frames.begin(), frames.end());
+  frames.erase(std::unique(frames.begin(), frames.end()), frames.end());
+  return frames;
 }
 
 QByteArray fileSourceHEVCAnnexBFile::seekToFrameNumber(int iFrameNr)
 {
+  QMutexLocker locker(&nalIndex->mutex);
+
   // Get the POC for the frame number
-  int iPOC = POC_List[iFrameNr];
+  int iPOC = nalIndex->POC_List[iFrameNr];
 
   // Collect the active parameter sets
   QMap<int, vps*> active_VPS_list;
   QMap<int, sps*> active_SPS_list;
   QMap<int, pps*> active_PPS_list;
   
-  for (nal_unit *nal : nalUnitList)
+  for (nal_unit *nal : nalIndex->nalUnitList)
   {
     if (nal->isSlice()) 
     {
@@ -1953,8 +2252,10 @@ bool fileSourceHEVCAnnexBFile::seekToFilePos(quint64 pos)
 
 QSize fileSourceHEVCAnnexBFile::getSequenceSize() const
 {
+  QMutexLocker locker(&nalIndex->mutex);
+
   // Find the first SPS and return the size
-  for (nal_unit *nal : nalUnitList)
+  for (nal_unit *nal : nalIndex->nalUnitList)
   {
     if (nal->nal_type == SPS_NUT) 
     {
@@ -1968,8 +2269,10 @@ QSize fileSourceHEVCAnnexBFile::getSequenceSize() const
 
 double fileSourceHEVCAnnexBFile::getFramerate() const
 {
+  QMutexLocker locker(&nalIndex->mutex);
+
   // First try to get the framerate from the parameter sets themselves
-  for (nal_unit *nal : nalUnitList)
+  for (nal_unit *nal : nalIndex->nalUnitList)
   {
     if (nal->nal_type == VPS_NUT) 
     {
@@ -1982,7 +2285,7 @@ double fileSourceHEVCAnnexBFile::getFramerate() const
 
   // The VPS had no information on the frame rate.
   // Look for VUI information in the sps
-  for (nal_unit *nal : nalUnitList)
+  for (nal_unit *nal : nalIndex->nalUnitList)
   {
     if (nal->nal_type == SPS_NUT)
     {
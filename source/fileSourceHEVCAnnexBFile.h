@@ -34,10 +34,15 @@
 #define FILESOURCEHEVCANNEXBFILE_H
 
 #include <QAbstractItemModel>
+#include <QAtomicInt>
+#include <QFuture>
 #include <QMap>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
 #include "fileSource.h"
 
-#define BUFFER_SIZE 40960
+#define BUFFER_SIZE 1048576
 
 class fileSourceHEVCAnnexBFile : public fileSource
 {
@@ -47,7 +52,9 @@ public:
   fileSourceHEVCAnnexBFile();
   ~fileSourceHEVCAnnexBFile();
 
-  // Open the given file. If another file is given, 
+  // Open the given file. If another file is given, the index (NAL units and POCs) of the other file is used.
+  // Otherwise, the index is loaded from the cache or the file is scanned in the background. In this case, openFile
+  // returns as soon as the first pictures are known. If saveAllUnits is set, the file is scanned completely before returning.
   bool openFile(const QString &filePath) Q_DECL_OVERRIDE { return openFile(filePath, false); }
   bool openFile(const QString &filePath, bool saveAllUnits, fileSourceHEVCAnnexBFile *otherFile=nullptr);
 
@@ -77,7 +84,11 @@ public:
   quint64 tell() const { return bufferStartPosInFile + posInBuffer; }
 
   // How many POC's have been found in the file
-  int getNumberPOCs() const { return POC_List.size(); }
+  int getNumberPOCs() const;
+  // Is the file still being scanned for NAL units in the background? While this is running, getNumberPOCs() grows.
+  bool isScanningInBackground() const;
+  // The progress of the background scan in percent
+  double getBackgroundScanProgress() const;
   // What is the width and height in pixels of the sequence?
   QSize getSequenceSize() const;
   // What it the framerate?
@@ -86,6 +97,8 @@ public:
   // Calculate the closest random access point (RAP) before the given frame number.
   // Return the frame number of that random access point.
   int getClosestSeekableFrameNumber(int frameIdx) const;
+  // Get the frame numbers of all random access points that are known so far (sorted).
+  QList<int> getSeekableFrameNumbers() const;
 
   // Seek the file to the given frame number. The given frame number has to be a random 
   // access point. We can start decoding the file from here. Use getClosestSeekableFrameNumber to find a random access point.
@@ -369,13 +382,14 @@ protected:
     QList<bool> used_by_curr_pic_s1_flag;
 
     // Calculated values. These are static. They are used for reference picture set prediction.
-    static int NumNegativePics[65];
-    static int NumPositivePics[65];
-    static int DeltaPocS0[65][16];
-    static int DeltaPocS1[65][16];
-    static bool UsedByCurrPicS0[65][16];
-    static bool UsedByCurrPicS1[65][16];
-    static int NumDeltaPocs[65];
+    // They are thread local so that multiple files can be scanned at the same time.
+    static thread_local int NumNegativePics[65];
+    static thread_local int NumPositivePics[65];
+    static thread_local int DeltaPocS0[65][16];
+    static thread_local int DeltaPocS1[65][16];
+    static thread_local bool UsedByCurrPicS0[65][16];
+    static thread_local bool UsedByCurrPicS1[65][16];
+    static thread_local int NumDeltaPocs[65];
   };
 
   struct vui_parameters
@@ -692,10 +706,10 @@ protected:
     int PicOrderCntMsb;
     QList<int> UsedByCurrPicLt;
 
-    // Static variables for keeping track of the decoding order
-    static bool bFirstAUInDecodingOrder;
-    static int prevTid0Pic_slice_pic_order_cnt_lsb;
-    static int prevTid0Pic_PicOrderCntMsb;
+    // Static (per thread) variables for keeping track of the decoding order. Reset these before scanning a file.
+    static thread_local bool bFirstAUInDecodingOrder;
+    static thread_local int prevTid0Pic_slice_pic_order_cnt_lsb;
+    static thread_local int prevTid0Pic_PicOrderCntMsb;
 
   private:
     // We will keep a pointer to the active SPS and PPS
@@ -721,29 +735,63 @@ protected:
   quint64      bufferStartPosInFile; ///< The byte position in the file of the start of the currently loaded buffer
   int          numZeroBytes;         ///< The number of zero bytes that occured. (This will be updated by gotoNextByte() and seekToNextNALUnit()
 
-  // The start code pattern
-  QByteArray startCode;
-
-  // A list of nal units sorted by position in the file.
-  // Only parameter sets and random access positions go in here.
-  // So basically all information we need to start the decoder at a certain position.
-  QList<nal_unit*> nalUnitList;
-  bool nalUnitListCopied;       //< If this list was copied (another file was porovided when opening the file) we don't own the pointers in this list.
+  // The index of the bitstream. It is shared by all fileSourceHEVCAnnexBFile instances that were opened from
+  // the same file (see otherFile in openFile) and it may still be filled by a background scan while it is used.
+  // All access has to lock the mutex.
+  struct nalUnitIndex
+  {
+    nalUnitIndex() : scanRunning(false), scanProgress(0.0) {}
+    ~nalUnitIndex() { qDeleteAll(nalUnitList); }
+
+    // A list of nal units sorted by position in the file.
+    // Only parameter sets and random access positions go in here.
+    // So basically all information we need to start the decoder at a certain position.
+    QList<nal_unit*> nalUnitList;
+    // A sorted list of all POCs in the sequence. POC's don't have to be consecutive, so the only way to know
+    // how many pictures are in a sequences is to keep a list of all POCs. While scanning, a POC is only added
+    // once it is certain that no picture with a lower POC will follow (see scanFileForNalUnits()).
+    QList<int> POC_List;
+
+    bool scanRunning;
+    double scanProgress;
+    mutable QMutex mutex;
+    QWaitCondition pocsAdded;
+  };
+  QSharedPointer<nalUnitIndex> nalIndex;
+  void addNalUnitToIndex(nal_unit *nal);
+  // Sort the given POCs and append them to the POC_List of the index. The keepNrPOCs highest POCs are not final yet.
+  // They stay in newPOCs.
+  void addPOCsToIndex(QList<int> &newPOCs, int keepNrPOCs=0);
+
+  // If no index file is available, the file is scanned by a second instance (with its own file handle and buffer)
+  // in the background. The first pictures can be decoded while the rest of the file is still being scanned.
+  QScopedPointer<fileSourceHEVCAnnexBFile> backgroundScanner;
+  QFuture<void> backgroundScanFuture;
+  QAtomicInt cancelBackgroundScan;
+  void scanFileInBackground();
+  void stopBackgroundScan();
 
-  // A list of all POCs in the sequence (in coding order). POC's don't have to be consecutive, so the only
-  // way to know how many pictures are in a sequences is to keep a list of all POCs.
-  QList<int> POC_List;
-  // Returns false if the POC was already present int the list
-  bool addPOCToList(int poc);
-  
   // Scan the file NAL by NAL. Keep track of all possible random access points and parameter sets in
-  // nalUnitList. Also collect a list of all POCs in coding order in POC_List.
+  // nalUnitList. Also collect a list of all POCs in POC_List.
   // If saving is activated, all NAL data is saved to be used by the QAbstractItemModel.
-  bool scanFileForNalUnits(bool saveAllUnits);
+  // If the scan runs in the background, no progress dialog is shown and the scan can be canceled using cancelBackgroundScan.
+  bool scanFileForNalUnits(bool saveAllUnits, bool inBackground=false);
+
+  // After scanning, the nalUnitList and POC_List are saved to an index file in the cache directory. If the same file
+  // (same path, size and modification time) is opened again, the index is loaded instead of scanning the file again.
+  // The parameter sets are saved as raw payload and parsed again when loading.
+  QString getNalUnitIndexFilePath() const;
+  bool loadNalUnitIndex();
+  void saveNalUnitIndex() const;
 
   // load the next buffer
   bool updateBuffer();
 
+  // Move forward until the current position is the 0x01 byte of a start code (curPosAtStartCode()) but pass at most maxBytes
+  // bytes (if not -1). If data is given, all passed bytes are appended to it. The buffer is searched for start codes in big
+  // blocks (not byte by byte). Return the number of bytes passed or -1 if the end of the file was reached.
+  qint64 skipToStartCode(QByteArray *data, qint64 maxBytes=-1);
+
   // Seek the file to the given byte position. Update the buffer.
   bool seekToFilePos(quint64 pos);
 };
@@ -0,0 +1,263 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "frameDiskCache.h"
+
+#include <cstring>
+#include <QDir>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+// How much disk space (in MB) may be used by all disk caches if nothing is set
+#define DISK_CACHE_DEFAULT_SIZE_MB 10000
+// How many frames of one disk cache may wait to be written. If the disk is slower than the caching, frames are dropped
+// so that the removed frames do not pile up in memory.
+#define DISK_CACHE_MAX_PENDING_FRAMES 16
+// The number of threads that compress and write the frames (for all disk caches)
+#define DISK_CACHE_WRITE_THREADS 2
+
+// The settings and the used disk space are shared by all disk caches
+struct diskCacheGlobals
+{
+  diskCacheGlobals() : enabled(false), maxSize(0), usedSize(0) {}
+  QMutex mutex;
+  bool enabled;
+  qint64 maxSize;
+  qint64 usedSize;
+  QString directory;
+};
+Q_GLOBAL_STATIC(diskCacheGlobals, globals)
+Q_GLOBAL_STATIC(QThreadPool, diskCacheThreadPool)
+
+frameDiskCache::frameDiskCache()
+{
+  fileError = false;
+  fileSize = 0;
+  generation = 0;
+}
+
+frameDiskCache::~frameDiskCache()
+{
+  QMutexLocker locker(&mutex);
+  while (!framesPending.isEmpty())
+    allFramesWritten.wait(&mutex);
+
+  // The temporary file is deleted with the QTemporaryFile
+  QMutexLocker globalLocker(&globals()->mutex);
+  globals()->usedSize -= fileSize;
+}
+
+void frameDiskCache::addFrame(int frameIdx, const QByteArray &rawData, const QImage &image, int cacheGeneration)
+{
+  if (rawData.isEmpty() && image.isNull())
+    return;
+
+  {
+    QMutexLocker globalLocker(&globals()->mutex);
+    if (!globals()->enabled || globals()->usedSize >= globals()->maxSize)
+      return;
+  }
+
+  QMutexLocker locker(&mutex);
+  if (cacheGeneration != generation)
+    return;
+  if (fileError || entries.contains(frameIdx) || framesPending.contains(frameIdx) || framesPending.count() >= DISK_CACHE_MAX_PENDING_FRAMES)
+    return;
+
+  framesPending.insert(frameIdx);
+  const int writeGeneration = generation;
+  QtConcurrent::run(diskCacheThreadPool(), [=]{ writeFrame(frameIdx, rawData, image, writeGeneration); });
+}
+
+void frameDiskCache::writeFrame(int frameIdx, const QByteArray &rawData, const QImage &image, int writeGeneration)
+{
+  // Compression takes the most time. Do it without holding the lock.
+  QByteArray compressed;
+  if (rawData.isEmpty())
+    compressed = qCompress(image.constBits(), image.byteCount(), 1);
+  else
+    compressed = qCompress(rawData, 1);
+
+  QMutexLocker locker(&mutex);
+  framesPending.remove(frameIdx);
+
+  bool spaceReserved = false;
+  if (writeGeneration == generation && !compressed.isEmpty())
+  {
+    QMutexLocker globalLocker(&globals()->mutex);
+    if (globals()->enabled && globals()->usedSize + compressed.size() <= globals()->maxSize)
+    {
+      globals()->usedSize += compressed.size();
+      spaceReserved = true;
+    }
+  }
+
+  if (spaceReserved)
+  {
+    if (openFile() && file->seek(fileSize) && file->write(compressed) == compressed.size())
+    {
+      diskCacheEntry entry;
+      entry.offset = fileSize;
+      entry.compressedSize = compressed.size();
+      entry.isRawData = !rawData.isEmpty();
+      entry.imageSize = image.size();
+      entry.imageFormat = image.format();
+      entries.insert(frameIdx, entry);
+      fileSize += compressed.size();
+    }
+    else
+    {
+      // Writing failed (the disk is probably full). Do not try again.
+      fileError = true;
+      QMutexLocker globalLocker(&globals()->mutex);
+      globals()->usedSize -= compressed.size();
+    }
+  }
+
+  if (framesPending.isEmpty())
+    allFramesWritten.wakeAll();
+}
+
+bool frameDiskCache::openFile()
+{
+  if (file)
+    return true;
+  if (fileError)
+    return false;
+
+  QString directory;
+  {
+    QMutexLocker globalLocker(&globals()->mutex);
+    directory = globals()->directory;
+  }
+
+  if (QDir().mkpath(directory))
+  {
+    file.reset(new QTemporaryFile(QDir(directory).filePath("frames_XXXXXX.tmp")));
+    if (file->open())
+      return true;
+    file.reset();
+  }
+
+  fileError = true;
+  return false;
+}
+
+bool frameDiskCache::getFrame(int frameIdx, QByteArray &rawData, QImage &image)
+{
+  {
+    QMutexLocker globalLocker(&globals()->mutex);
+    if (!globals()->enabled)
+      return false;
+  }
+
+  QMutexLocker locker(&mutex);
+  if (!entries.contains(frameIdx) || !file)
+    return false;
+  const diskCacheEntry entry = entries.value(frameIdx);
+  if (!file->seek(entry.offset))
+    return false;
+  QByteArray compressed = file->read(entry.compressedSize);
+  locker.unlock();
+
+  if (compressed.size() != entry.compressedSize)
+    return false;
+  QByteArray data = qUncompress(compressed);
+
+  if (entry.isRawData)
+  {
+    if (data.isEmpty())
+      return false;
+    rawData = data;
+    return true;
+  }
+
+  QImage newImage(entry.imageSize, entry.imageFormat);
+  if (newImage.isNull() || data.size() != newImage.byteCount())
+    return false;
+  std::memcpy(newImage.bits(), data.constData(), data.size());
+  image = newImage;
+  return true;
+}
+
+int frameDiskCache::getGeneration() const
+{
+  QMutexLocker locker(&mutex);
+  return generation;
+}
+
+bool frameDiskCache::contains(int frameIdx) const
+{
+  QMutexLocker locker(&mutex);
+  return entries.contains(frameIdx);
+}
+
+void frameDiskCache::clear()
+{
+  QMutexLocker locker(&mutex);
+  entries.clear();
+  generation++;
+  fileError = false;
+
+  if (file)
+    file->resize(0);
+  QMutexLocker globalLocker(&globals()->mutex);
+  globals()->usedSize -= fileSize;
+  fileSize = 0;
+}
+
+void frameDiskCache::updateSettings()
+{
+  QSettings settings;
+  settings.beginGroup("VideoCache");
+  const bool enabled = settings.value("DiskCacheEnabled", false).toBool();
+  const qint64 maxSize = settings.value("DiskCacheMaxSizeMB", DISK_CACHE_DEFAULT_SIZE_MB).toLongLong() * 1000 * 1000;
+  QString directory = settings.value("DiskCacheDirectory", "").toString();
+  settings.endGroup();
+  if (directory.isEmpty())
+    directory = getDefaultDirectory();
+
+  // Frames that are already in a disk cache stay in the file they are in. Only new files use the new directory.
+  QMutexLocker globalLocker(&globals()->mutex);
+  globals()->enabled = enabled;
+  globals()->maxSize = maxSize;
+  globals()->directory = directory;
+  diskCacheThreadPool()->setMaxThreadCount(DISK_CACHE_WRITE_THREADS);
+}
+
+QString frameDiskCache::getDefaultDirectory()
+{
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("frameCache");
+}
@@ -0,0 +1,105 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FRAMEDISKCACHE_H
+#define FRAMEDISKCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QSet>
+#include <QSize>
+#include <QTemporaryFile>
+#include <QWaitCondition>
+
+/* A second level cache for the frames of one videoHandler on the local disk.
+ * When the videoCache removes a frame from the cache in memory, the videoHandler moves it in here. Before a frame
+ * is loaded (decoded) again, the videoHandler looks in here first. The frames are compressed (zlib with the fastest
+ * setting) and appended to a temporary file in the background. The disk space of all instances is limited by the
+ * VideoCache/DiskCacheMaxSizeMB setting. All functions are thread-safe.
+ */
+class frameDiskCache
+{
+public:
+  frameDiskCache();
+  ~frameDiskCache();
+
+  // Add the frame to the disk cache. Either the raw data or the image is cached. The data is compressed and written in
+  // the background. Nothing is done if the disk cache is disabled or full or if the frame is already in there.
+  // The frame is also discarded if the disk cache was cleared after getGeneration() returned cacheGeneration.
+  void addFrame(int frameIdx, const QByteArray &rawData, const QImage &image, int cacheGeneration);
+  int getGeneration() const;
+  // Read the frame from the disk cache. Either rawData (if the frame was added as raw data) or image is set.
+  // Return false if the frame is not in the disk cache or reading failed.
+  bool getFrame(int frameIdx, QByteArray &rawData, QImage &image);
+  bool contains(int frameIdx) const;
+  // Remove all frames (e.g. because the format changed and they are invalid now). Frames that are currently
+  // being written are discarded.
+  void clear();
+
+  // Update the settings of all disk caches (enabled, maximum size and directory) from the QSettings
+  static void updateSettings();
+  // The directory that is used if no directory is set
+  static QString getDefaultDirectory();
+
+private:
+  struct diskCacheEntry
+  {
+    qint64 offset;
+    int compressedSize;
+    bool isRawData;
+    QSize imageSize;
+    QImage::Format imageFormat;
+  };
+
+  // Compress the frame and append it to the file. This runs in the diskCacheThreadPool.
+  void writeFrame(int frameIdx, const QByteArray &rawData, const QImage &image, int writeGeneration);
+  // Create the temporary file if it does not exist yet. The mutex must be locked.
+  bool openFile();
+
+  // Protects all members below
+  mutable QMutex mutex;
+  QHash<int, diskCacheEntry> entries;
+  // The frames that are currently compressed/written in the background
+  QSet<int> framesPending;
+  QWaitCondition allFramesWritten;
+  QScopedPointer<QTemporaryFile> file;
+  bool fileError;
+  qint64 fileSize;
+  // Increased by clear(). Frames that were added before are not written.
+  int generation;
+};
+
+#endif // FRAMEDISKCACHE_H
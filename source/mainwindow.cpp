@@ -38,9 +38,12 @@
 #include <QSettings>
 #include <QStringList>
 #include <QTextBrowser>
+#include "de265Decoder.h"
+#include "frameDiskCache.h"
 #include "playlistItems.h"
 #include "settingsDialog.h"
 #include "signalsSlots.h"
+#include "videoHandlerYUV.h"
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
 {
@@ -557,6 +560,9 @@ void MainWindow::updateSettings()
   ui.playlistTreeWidget->updateSettings();
   cache->updateSettings();
   ui.playbackController->updateSettings();
+  videoHandlerYUV::updateConversionSettings();
+  frameDiskCache::updateSettings();
+  de265Decoder::updateDecoderSettings();
 }
 
 void MainWindow::saveScreenshot() 
@@ -62,6 +62,7 @@ PlaybackController::PlaybackController()
 
   // Initialize variables
   currentFrameIdx = 0;
+  navigationDirection = 1;
   timerInterval = -1;
   timerFPSCounter = 0;
   timerLastFPSTime = QTime::currentTime();
@@ -477,7 +478,8 @@ void PlaybackController::timerEvent(QTimerEvent *event)
 
     // Go to the next frame and update the splitView
     DEBUG_PLAYBACK("PlaybackController::timerEvent next frame %d", nextFrameIdx);
-    setCurrentFrame(nextFrameIdx);
+    // This may also wrap around to the first frame (loop playback). This is not a jump.
+    setCurrentFrame(nextFrameIdx, true);
 
     // Update the FPS counter every 50 frames
     timerFPSCounter++;
@@ -535,7 +537,7 @@ void PlaybackController::currentSelectedItemsDoubleBufferLoad(int itemID)
 /* Set the value currentFrame to frame and update the value in the splinBox and the slider without
  * invoking any events from these controls. Also update the splitView.
 */
-void PlaybackController::setCurrentFrame(int frame)
+void PlaybackController::setCurrentFrame(int frame, bool playbackStep)
 {
   if (frame == currentFrameIdx)
     return;
@@ -548,6 +550,9 @@ void PlaybackController::setCurrentFrame(int frame)
   // Set the new value in the controls without invoking another signal
   const QSignalBlocker blocker1(frameSpinBox);
   const QSignalBlocker blocker2(frameSlider);
+  const bool frameJump = (!playbackStep && frame != currentFrameIdx + 1);
+  if (!playing())
+    navigationDirection = (frame < currentFrameIdx) ? -1 : 1;
   currentFrameIdx = frame;
   frameSpinBox->setValue(frame);
   frameSlider->setValue(frame);
@@ -555,4 +560,8 @@ void PlaybackController::setCurrentFrame(int frame)
   // Also update the view to display the new frame
   splitViewPrimary->update(true);
   splitViewSeparate->update();
+
+  if (frameJump)
+    // The cache should continue caching at the new position
+    emit signalFrameJump();
 }
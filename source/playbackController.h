@@ -65,8 +65,12 @@ public:
 
   // Get the currently shown frame index
   int getCurrentFrame() const { return currentFrameIdx; }
+  // In which direction is the user moving through the frames? 1 (forward, also while playing) or -1 (backwards).
+  int getNavigationDirection() const { return playing() ? 1 : navigationDirection; }
   // Set the current frame in the controls and update the splitView without invoking more events from the controls.
-  void setCurrentFrame(int frame);
+  // If playbackStep is set, the frame is the next frame of the playback (this includes wrapping around in loop playback).
+  // Otherwise, going to any other than the next frame is signaled as a frame jump (see signalFrameJump()).
+  void setCurrentFrame(int frame, bool playbackStep=false);
 
   // Using the currentFrameIdx and the repreat mode, calculate the next frame index.
   // -1: The next frame is the first fame of the next item.
@@ -108,6 +112,9 @@ signals:
   // The playback is now going to start
   void signalPlaybackStarting();
 
+  // The current frame changed to a frame that is not the next frame of the playback (the user jumped or stepped back)
+  void signalFrameJump();
+
 public slots:
   // The video cache calls this if caching of the item is finished
   void itemCachingFinished(playlistItem *item);
@@ -128,6 +135,8 @@ private:
 
   // The current frame index
   int currentFrameIdx;
+  // The direction of the last change of the current frame by the user (1 or -1)
+  int navigationDirection;
 
   // Start the time if not running or update the timer interval. This is called when we jump to the next item, when the user presses 
   // play or when the rate of the current item changes.
@@ -182,12 +182,23 @@ public:
   void disableCaching() { cachingEnabled = false; }
   // Cache the given frame. This function is thread save. So multiple instances of this function can run at the same time.
   virtual void cacheFrame(int idx) { Q_UNUSED(idx); }
+  // If frames of the item depend on each other (e.g. a decoder has to decode from a random access point on), the item
+  // can return the (sorted) frames at which such a range starts. The videoCache caches all frames up to the next start
+  // in one job, so that multiple threads work on different ranges. If the list is empty, every frame is a job of its own.
+  // This is called in the main thread when the cache queue is updated.
+  virtual QList<int> getCachingRangeStarts() const { return QList<int>(); }
   // Get a list of all cached frames (just the frame indices)
   virtual QList<int> getCachedFrames() const { return QList<int>(); }
+  // Get the number of cached frames. This is cheaper than counting getCachedFrames().
+  virtual int getNumberCachedFrames() const { return getCachedFrames().count(); }
   // How many bytes will caching one frame use (in bytes)?
   virtual unsigned int getCachingFrameSize() const { return 0; }
   // Remove the frame with the given index from the cache. If the index is -1, remove all frames from the cache.
   virtual void removeFrameFromCache(int idx) { Q_UNUSED(idx); }
+  // How long did it take to load the cached frame (in ms) and when was it last used (QDateTime::currentMSecsSinceEpoch())?
+  // The videoCache removes the frames that are cheap to reload and were not used for a long time first. -1 if unknown.
+  virtual qint64 getCachedFrameReloadCost(int idx) const { Q_UNUSED(idx); return -1; }
+  virtual qint64 getCachedFrameLastAccess(int idx) const { Q_UNUSED(idx); return -1; }
 
   // ----- Detection of source/file change events -----
 
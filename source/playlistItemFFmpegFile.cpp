@@ -48,7 +48,7 @@
 #endif
 
 playlistItemFFmpegFile::playlistItemFFmpegFile(const QString &ffmpegFilePath)
-  : playlistItemWithVideo(ffmpegFilePath, playlistItem_Indexed)
+  : playlistItemWithVideo(ffmpegFilePath, playlistItem_Indexed), cachingDecoders(&loadingDecoder)
 {
   // Set the properties of the playlistItem
   setIcon(0, convertIcon(":img_videoHEVC.png"));
@@ -63,8 +63,11 @@ playlistItemFFmpegFile::playlistItemFFmpegFile(const QString &ffmpegFilePath)
   // Connect the basic signals from the video
   playlistItemWithVideo::connectVideo();
 
-  // Open the file
-  if (!loadingDecoder.openFile(ffmpegFilePath))
+  // Open the file. If the file is not indexed yet, it is scanned in the background. The item can be used
+  // as soon as the first key frame is known and the frame limits are updated as more frames are found.
+  bool fileOpened = loadingDecoder.openFile(ffmpegFilePath);
+  startBackgroundScanTimer();
+  if (!fileOpened)
   {
     // Opening the input file failed.
     DEBUG_FFMPEG("Opening the input file with the loading decoder failed.");
@@ -72,7 +75,8 @@ playlistItemFFmpegFile::playlistItemFFmpegFile(const QString &ffmpegFilePath)
     return;
   }
 
-  if (!cachingDecoder.openFile(ffmpegFilePath, &loadingDecoder))
+  // Open the first decoder of the caching pool. The caching decoders use the key frame list of the loading decoder.
+  if (!cachingDecoders.openFile(ffmpegFilePath))
   {
     // Opening the input file failed.
     DEBUG_FFMPEG("Opening the input file with the caching decoder failed.");
@@ -208,6 +212,9 @@ infoData playlistItemFFmpegFile::getInfo() const
     info.items.append(loadingDecoder.getDecoderInfo());
   }
 
+  // Show the progress of the background scan (if running)
+  appendBackgroundScanInfo(info);
+
   return info;
 }
 
@@ -232,7 +239,7 @@ void playlistItemFFmpegFile::loadYUVData(int frameIdx, bool caching)
   QByteArray decByteArray;
 
   if (caching)
-    decByteArray = cachingDecoder.loadYUVFrameData(frameIdx);
+    decByteArray = cachingDecoders.loadYUVFrameData(frameIdx);
   else
     decByteArray = loadingDecoder.loadYUVFrameData(frameIdx);
 
@@ -316,9 +323,28 @@ void playlistItemFFmpegFile::cacheFrame(int idx)
     return;
 
   // Cache a certain frame. This is always called in a separate thread.
-  cachingMutex.lock();
-  video->cacheFrame(idx);
-  cachingMutex.unlock();
+  if (video->isInCache(idx))
+    return;
+
+  // A frame that was moved to the disk cache does not have to be decoded again
+  if (video->cacheFrameFromDiskCache(idx))
+    return;
+
+  // Decode the frame with a decoder from the pool. Multiple threads can do this at the same time. The conversion
+  // and caching is then done without requesting the data from the video handler again.
+  qint64 reloadCost = 0;
+  QByteArray decByteArray = cachingDecoders.loadYUVFrameData(idx, &reloadCost);
+  if (!decByteArray.isEmpty())
+    video->cacheFrameFromRawData(idx, decByteArray, reloadCost);
+}
+
+QList<int> playlistItemFFmpegFile::getCachingRangeStarts() const
+{
+  if (!decoderReady)
+    return QList<int>();
+
+  // All frames up to the next key frame
+  return loadingDecoder.getSeekableFrameNumbers();
 }
 
 void playlistItemFFmpegFile::loadFrame(int frameIdx, bool playing, bool loadRawdata)
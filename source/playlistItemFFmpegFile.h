@@ -33,6 +33,7 @@
 #ifndef PLAYLISTITEMFFMPEGFILE_H
 #define PLAYLISTITEMFFMPEGFILE_H
 
+#include "cachingDecoderPool.h"
 #include "FFmpegDecoder.h"
 #include "playlistItemWithVideo.h"
 #include "statisticHandler.h"
@@ -82,9 +83,10 @@ public:
   virtual void reloadItemSource()       Q_DECL_OVERRIDE;
   virtual void updateSettings()         Q_DECL_OVERRIDE { loadingDecoder.updateFileWatchSetting(); statSource.updateSettings(); }
 
-  // Cache the frame with the given index.
-  // For FFMpeg items, a mutex must be locked when caching a frame (only one frame can be cached at a time).
+  // Cache the frame with the given index. Every caching thread decodes with its own decoder from the pool.
   void cacheFrame(int idx) Q_DECL_OVERRIDE;
+  // Cache all frames up to the next key frame in one job
+  virtual QList<int> getCachingRangeStarts() const Q_DECL_OVERRIDE;
 
   // Load the frame in the video item. Emit signalItemChanged(true,false) when done.
   virtual void loadFrame(int frameIdx, bool playing, bool loadRawData) Q_DECL_OVERRIDE;
@@ -100,11 +102,14 @@ public slots:
 protected:
   virtual void createPropertiesWidget() Q_DECL_OVERRIDE;
 
+  // The file is scanned for key frames in the background (see playlistItemWithVideo)
+  virtual bool isScanningInBackground() const Q_DECL_OVERRIDE { return loadingDecoder.isScanningInBackground(); }
+  virtual double getBackgroundScanProgress() const Q_DECL_OVERRIDE { return loadingDecoder.getBackgroundScanProgress(); }
+
 private:
-  // We allocate two decoder: One for loading images in the foreground and one for caching in the background.
-  // This is better if random access and linear decoding (caching) is performed at the same time.
+  // We allocate one decoder for loading images in the foreground and a pool of decoders for caching in the background.
   FFmpegDecoder loadingDecoder;
-  FFmpegDecoder cachingDecoder;
+  cachingDecoderPool<FFmpegDecoder> cachingDecoders;
 
   // The statistics source
   statisticHandler statSource;
@@ -112,10 +117,6 @@ private:
   // fill the list of statistic types that we can provide
   void fillStatisticList();
 
-  // Only cache one frame at a time. Caching should also always be done in display order of the frames.
-  // TODO: Could we somehow make shure that caching is always performed in display order?
-  QMutex cachingMutex;
-
   bool decoderReady;
 
 private slots:
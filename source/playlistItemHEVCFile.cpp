@@ -46,7 +46,7 @@
 #endif
 
 playlistItemHEVCFile::playlistItemHEVCFile(const QString &hevcFilePath)
-  : playlistItemWithVideo(hevcFilePath, playlistItem_Indexed)
+  : playlistItemWithVideo(hevcFilePath, playlistItem_Indexed), cachingDecoders(&loadingDecoder)
 {
   // Set the properties of the playlistItem
   setIcon(0, convertIcon(":img_videoHEVC.png"));
@@ -65,10 +65,11 @@ playlistItemHEVCFile::playlistItemHEVCFile(const QString &hevcFilePath)
   // An HEVC file can be cached if nothing goes wrong
   cachingEnabled = true;
 
-  // Open the input file.
-  // TODO: This will parse the whole HEVC file twice, saving all NAL entry points twice.
-  // Maybe this should be somehow avoided. Maybe by one instance that saves all the information from the NAL stream and multiple reader classes in the decoders.
-  if (!loadingDecoder.openFile(hevcFilePath))
+  // Open the input file. If the file is not indexed yet, it is scanned in the background. The item can be used
+  // as soon as the first pictures are known and the frame limits are updated as more pictures are found.
+  bool fileOpened = loadingDecoder.openFile(hevcFilePath);
+  startBackgroundScanTimer();
+  if (!fileOpened)
   {
     // Something went wrong. Let's find out what.
     if (loadingDecoder.errorInDecoder())
@@ -84,12 +85,11 @@ playlistItemHEVCFile::playlistItemHEVCFile(const QString &hevcFilePath)
   // The bitstream looks valid and the decoder is operational.
   fileState = hevcFileNoError;
 
-  if (!cachingDecoder.openFile(hevcFilePath, &loadingDecoder))
-  {
+  // Open the first decoder of the caching pool. The caching decoders use the NAL units list of the loading decoder.
+  if (!cachingDecoders.openFile(hevcFilePath))
     // Loading the normal decoder worked, but loading another decoder for caching failed.
     // That is strange.
     cachingEnabled = false;
-  }
   
   // Fill the list of statistics that we can provide
   fillStatisticList();
@@ -176,6 +176,9 @@ infoData playlistItemHEVCFile::getInfo() const
     info.items.append(infoItem("NAL units", "Show NAL units", "Show a detailed list of all NAL units.", true));
   }
 
+  // Show the progress of the background scan (if running)
+  appendBackgroundScanInfo(info);
+
   return info;
 }
 
@@ -243,7 +246,7 @@ void playlistItemHEVCFile::loadYUVData(int frameIdx, bool caching)
   // Just get the frame from the correct decoder
   QByteArray decByteArray;
   if (caching)
-    decByteArray = cachingDecoder.loadYUVFrameData(frameIdx);
+    decByteArray = cachingDecoders.loadYUVFrameData(frameIdx);
   else
     decByteArray = loadingDecoder.loadYUVFrameData(frameIdx);
 
@@ -459,6 +462,7 @@ void playlistItemHEVCFile::reloadItemSource()
   //       All items in the cache are also now invalid
 
   loadingDecoder.reloadItemSource();
+  startBackgroundScanTimer();
 
   // Set the frame number limits
   startEndFrame = getStartEndFrameLimits();
@@ -477,9 +481,28 @@ void playlistItemHEVCFile::cacheFrame(int idx)
     return;
 
   // Cache a certain frame. This is always called in a separate thread.
-  cachingMutex.lock();
-  video->cacheFrame(idx);
-  cachingMutex.unlock();
+  if (video->isInCache(idx))
+    return;
+
+  // A frame that was moved to the disk cache does not have to be decoded again
+  if (video->cacheFrameFromDiskCache(idx))
+    return;
+
+  // Decode the frame with a decoder from the pool. Multiple threads can do this at the same time. The conversion
+  // and caching is then done without requesting the data from the video handler again.
+  qint64 reloadCost = 0;
+  QByteArray decByteArray = cachingDecoders.loadYUVFrameData(idx, &reloadCost);
+  if (!decByteArray.isEmpty())
+    video->cacheFrameFromRawData(idx, decByteArray, reloadCost);
+}
+
+QList<int> playlistItemHEVCFile::getCachingRangeStarts() const
+{
+  if (fileState != hevcFileNoError)
+    return QList<int>();
+
+  // All frames up to the next random access point
+  return loadingDecoder.getSeekableFrameNumbers();
 }
 
 void playlistItemHEVCFile::loadFrame(int frameIdx, bool playing, bool loadRawdata)
@@ -33,6 +33,7 @@
 #ifndef PLAYLISTITEMHEVCFILE_H
 #define PLAYLISTITEMHEVCFILE_H
 
+#include "cachingDecoderPool.h"
 #include "de265Decoder.h"
 #include "playlistItemWithVideo.h"
 #include "statisticHandler.h"
@@ -92,8 +93,10 @@ public:
   virtual bool isLoadingDoubleBuffer() const Q_DECL_OVERRIDE { return isFrameLoadingDoubleBuffer; }
 
   // Cache the frame with the given index.
-  // For HEVC items, a mutex must be locked when caching a frame (only one frame can be cached at a time).
+  // For HEVC items, every caching thread gets its own decoder from the pool of caching decoders.
   void cacheFrame(int idx) Q_DECL_OVERRIDE;
+  // Frames are cached in ranges between two random access points. Every range can be decoded independently.
+  virtual QList<int> getCachingRangeStarts() const Q_DECL_OVERRIDE;
 
 public slots:
   // Load the YUV data for the given frame index from file. This slot is called by the videoHandlerYUV if the frame that is
@@ -106,6 +109,10 @@ public slots:
 protected:
   virtual void createPropertiesWidget() Q_DECL_OVERRIDE;
 
+  // The file is scanned for NAL units in the background (see playlistItemWithVideo)
+  virtual bool isScanningInBackground() const Q_DECL_OVERRIDE { return loadingDecoder.isScanningInBackground(); }
+  virtual double getBackgroundScanProgress() const Q_DECL_OVERRIDE { return loadingDecoder.getBackgroundScanProgress(); }
+
 private:
 
   typedef enum
@@ -116,19 +123,14 @@ private:
   } hevcFileState;
   hevcFileState fileState;
 
-  // We allocate two decoder: One for loading images in the foreground and one for caching in the background.
-  // This is better if random access and linear decoding (caching) is performed at the same time.
+  // We allocate one decoder for loading images in the foreground and a pool of decoders for caching in the background.
   de265Decoder loadingDecoder;
-  de265Decoder cachingDecoder;
+  cachingDecoderPool<de265Decoder> cachingDecoders;
 
   // Is the loadFrame function currently loading?
   bool isFrameLoading;
   bool isFrameLoadingDoubleBuffer;
 
-  // Only cache one frame at a time. Caching should also always be done in display order of the frames.
-  // TODO: Could we somehow make shure that caching is always performed in display order?
-  QMutex cachingMutex;
-
   // The statistics source
   statisticHandler statSource;
 
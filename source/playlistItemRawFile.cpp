@@ -34,6 +34,7 @@
 
 #include <QFileInfo>
 #include <QPainter>
+#include <QSettings>
 #include <QtConcurrent>
 #include <QUrl>
 #include <QVBoxLayout>
@@ -46,6 +47,9 @@
 #define DEBUG_RAWFILE(fmt,...) ((void)0)
 #endif
 
+// During playback, read this many frames ahead
+#define RAWFILE_READ_AHEAD_NR_FRAMES 4
+
 playlistItemRawFile::playlistItemRawFile(const QString &rawFilePath, const QSize &frameSize, const QString &sourcePixelFormat, const QString &fmt)
   : playlistItemWithVideo(rawFilePath, playlistItem_Indexed)
 {
@@ -57,6 +61,7 @@ playlistItemRawFile::playlistItemRawFile(const QString &rawFilePath, const QSize
   setIcon(0, convertIcon(":img_video.png"));
   setFlags(flags() | Qt::ItemIsDropEnabled);
 
+  playbackRunning.store(0);
   dataSource.openFile(rawFilePath);
 
   if (!dataSource.isOk())
@@ -107,7 +112,7 @@ playlistItemRawFile::playlistItemRawFile(const QString &rawFilePath, const QSize
   }
 
   // If the videHandler requests raw data, we provide it from the file
-  connect(video.data(), SIGNAL(signalRequestRawData(int, bool)), this, SLOT(loadRawData(int)), Qt::DirectConnection);
+  connect(video.data(), SIGNAL(signalRequestRawData(int, bool)), this, SLOT(loadRawData(int, bool)), Qt::DirectConnection);
   connect(video.data(), &videoHandler::signalUpdateFrameLimits, this,  &playlistItemRawFile::slotUpdateFrameLimits);
 
   // Connect the basic signals from the video
@@ -261,7 +266,7 @@ playlistItemRawFile *playlistItemRawFile::newplaylistItemRawFile(const QDomEleme
   return newFile;
 }
 
-void playlistItemRawFile::loadRawData(int frameIdx)
+void playlistItemRawFile::loadRawData(int frameIdx, bool caching)
 {
   if (!video->isFormatValid())
     return;
@@ -272,15 +277,30 @@ void playlistItemRawFile::loadRawData(int frameIdx)
   qint64 fileStartPos = frameIdx * getBytesPerFrame();
   qint64 nrBytes = getBytesPerFrame();
 
+  // If the file is memory mapped, a frame that is only shown can directly use the data in the mapped file.
+  // A frame that goes into the cache is copied. The cache must hold the data in memory and it must stay
+  // valid if the file is reopened.
+  QByteArray &targetBuffer = (rawFormat == YUV) ? getYUVVideo()->rawYUVData : getRGBVideo()->rawRGBData;
+  const qint64 nrBytesRead = caching ? dataSource.readBytes(targetBuffer, fileStartPos, nrBytes) : dataSource.readBytesView(targetBuffer, fileStartPos, nrBytes);
+
+  if (!caching)
+  {
+    // During playback, the following frames are read by the I/O thread of the dataSource while this frame is converted.
+    if (playbackRunning.loadAcquire())
+      dataSource.readAhead(fileStartPos + nrBytes, nrBytes, RAWFILE_READ_AHEAD_NR_FRAMES);
+    else
+      dataSource.stopReadAhead();
+  }
+
   if (rawFormat == YUV)
   {
-    if (dataSource.readBytes(getYUVVideo()->rawYUVData, fileStartPos, nrBytes) < nrBytes)
+    if (nrBytesRead < nrBytes)
       return; // Error
     getYUVVideo()->rawYUVData_frameIdx = frameIdx;
   }
   else if (rawFormat == RGB)
   {
-    if (dataSource.readBytes(getRGBVideo()->rawRGBData, fileStartPos, nrBytes) < nrBytes)
+    if (nrBytesRead < nrBytes)
       return; // Error
     getRGBVideo()->rawRGBData_frameIdx = frameIdx;
   }
@@ -288,6 +308,12 @@ void playlistItemRawFile::loadRawData(int frameIdx)
   DEBUG_RAWFILE("playlistItemRawFile::loadRawData %d Done", frameIdx);
 }
 
+void playlistItemRawFile::loadFrame(int frameIdx, bool playing, bool loadRawData)
+{
+  playbackRunning.storeRelease(playing);
+  playlistItemWithVideo::loadFrame(frameIdx, playing, loadRawData);
+}
+
 ValuePairListSets playlistItemRawFile::getPixelValues(const QPoint &pixelPos, int frameIdx)
 {
   return ValuePairListSets((rawFormat == YUV) ? "YUV" : "RGB", video->getPixelValues(pixelPos, frameIdx));
@@ -316,8 +342,22 @@ qint64 playlistItemRawFile::getBytesPerFrame() const
   return -1;
 }
 
+void playlistItemRawFile::updateSettings()
+{
+  // A file that is watched for changes is not memory mapped. If the file is watched now, the mapping is removed.
+  // Release all buffers before. They may point into the mapping.
+  QSettings settings;
+  if (dataSource.isMapped() && settings.value("WatchFiles",true).toBool())
+    video->invalidateAllBuffers();
+
+  dataSource.updateFileWatchSetting();
+}
+
 void playlistItemRawFile::reloadItemSource()
 {
+  // Release all buffers before the file is reopened. They may point into the memory mapped file.
+  video->invalidateAllBuffers();
+
   // Reopen the file
   dataSource.openFile(plItemNameOrFileName);
   if (!dataSource.isOk())
@@ -33,6 +33,7 @@
 #ifndef PLAYLISTITEMRAWFILE_H
 #define PLAYLISTITEMRAWFILE_H
 
+#include <QAtomicInt>
 #include <QFuture>
 #include <QString>
 #include "fileSource.h"
@@ -67,18 +68,22 @@ public:
 
   virtual ValuePairListSets getPixelValues(const QPoint &pixelPos, int frameIdx) Q_DECL_OVERRIDE;
 
+  // Override from playlistItemWithVideo. Remember if playback is running so that the next frames are read ahead.
+  virtual void loadFrame(int frameIdx, bool playing, bool loadRawData) Q_DECL_OVERRIDE;
+
   // Add the file type filters and the extensions of files that we can load.
   static void getSupportedFileExtensions(QStringList &allExtensions, QStringList &filters);
 
   // ----- Detection of source/file change events -----
   virtual bool isSourceChanged()  Q_DECL_OVERRIDE { return dataSource.isFileChanged(); }
   virtual void reloadItemSource() Q_DECL_OVERRIDE;
-  virtual void updateSettings()   Q_DECL_OVERRIDE { dataSource.updateFileWatchSetting(); }
+  virtual void updateSettings()   Q_DECL_OVERRIDE;
 
 public slots:
   // Load the raw data for the given frame index from file. This slot is called by the videoHandler if the frame that is
-  // requested to be drawn has not been loaded yet.
-  virtual void loadRawData(int frameIdx);
+  // requested to be drawn has not been loaded yet. If caching is set, the data is copied and does not point into the
+  // memory mapped file.
+  virtual void loadRawData(int frameIdx, bool caching);
 
 protected:
 
@@ -105,6 +110,10 @@ private:
   virtual qint64 getNumberFrames() const;
   
   fileSource dataSource;
+
+  // Is playback running? If yes, the next frames are read in the background (see fileSource::readAhead()).
+  // This is set by loadFrame() and read by loadRawData() which may run in another thread.
+  QAtomicInt playbackRunning;
   
   videoHandlerYUV *getYUVVideo() { return dynamic_cast<videoHandlerYUV*>(video.data()); }
   videoHandlerRGB *getRGBVideo() { return dynamic_cast<videoHandlerRGB*>(video.data()); }
@@ -33,9 +33,20 @@
 #include "playlistItemStatisticsFile.h"
 
 #include <cassert>
+#include <climits>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <QBuffer>
 #include <QDebug>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QPushButton>
+#include <QQueue>
+#include <QSet>
 #include <QtConcurrent>
+#include <QThreadPool>
 #include <QTime>
 #include "statisticsExtensions.h"
 
@@ -43,6 +54,11 @@
 // so that we can address all the positions in it with int (using such a large buffer is not a good
 // idea anyways)
 #define STAT_PARSING_BUFFER_SIZE 1048576
+// The file is indexed in chunks of this size in parallel (also less than 2GB)
+#define STAT_PARSING_CHUNK_SIZE (16 * 1048576)
+
+// The threads that index the chunks of the statistics files
+Q_GLOBAL_STATIC(QThreadPool, statisticsParserThreadPool)
 
 playlistItemStatisticsFile::playlistItemStatisticsFile(const QString &itemNameOrFileName)
   : playlistItem(itemNameOrFileName, playlistItem_Indexed)
@@ -58,18 +74,9 @@ playlistItemStatisticsFile::playlistItemStatisticsFile(const QString &itemNameOr
   // Set statistics icon
   setIcon(0, convertIcon(":img_stats.png"));
 
-  file.openFile(itemNameOrFileName);
-  if (!file.isOk())
+  if (!openStatisticsFile())
     return;
 
-  // Read the statistics file header
-  readHeaderFromFile();
-
-  // Run the parsing of the file in the background
-  cancelBackgroundParser = false;
-  timer.start(1000, this);
-  backgroundParserFuture = QtConcurrent::run(this, &playlistItemStatisticsFile::readFrameAndTypePositionsFromFile);
-
   connect(&statSource, &statisticHandler::updateItem, this, &playlistItem::signalItemChanged);
   connect(&statSource, &statisticHandler::requestStatisticsLoading, this, &playlistItemStatisticsFile::loadStatisticToCache);
 }
@@ -81,7 +88,7 @@ playlistItemStatisticsFile::~playlistItemStatisticsFile()
   if (backgroundParserFuture.isRunning())
   {
     // signal to background thread that we want to cancel the processing
-    cancelBackgroundParser = true;
+    cancelBackgroundParser.storeRelease(1);
     backgroundParserFuture.waitForFinished();
   }
 }
@@ -93,8 +100,11 @@ infoData playlistItemStatisticsFile::getInfo() const
   // Append the file information (path, date created, file size...)
   info.items.append(file.getFileInfoList());
 
-  // Is the file sorted by POC?
-  info.items.append(infoItem("Sorted by POC", fileSortedByPOC ? "Yes" : "No"));
+  // Is the file sorted by POC? A binary file can be accessed in any order.
+  if (binaryFile.isOpen())
+    info.items.append(infoItem("Format", "Binary statistics file"));
+  else
+    info.items.append(infoItem("Sorted by POC", fileSortedByPOC ? "Yes" : "No"));
 
   // Show the progress of the background parsing (if running)
   if (backgroundParserFuture.isRunning())
@@ -141,117 +151,117 @@ void playlistItemStatisticsFile::readFrameAndTypePositionsFromFile()
     if (!inputFile.openFile(file.absoluteFilePath()))
       return;
 
-    // We perform reading using an input buffer
-    QByteArray inputBuffer;
-    bool fileAtEnd = false;
-    qint64 bufferStartPos = 0;
+    const QString fileName = inputFile.absoluteFilePath();
+    const qint64 fileSize = inputFile.getFileSize();
 
-    QString lineBuffer;
-    qint64  lineBufferStartPos = 0;
-    int     lastPOC = INT_INVALID;
-    int     lastType = INT_INVALID;
-    while (!fileAtEnd && !cancelBackgroundParser)
+    // The file is split into chunks which are indexed in parallel. The results of the chunks are merged in the
+    // order of the file, so that we can check the POC/type order just like when parsing the file line by line.
+    // Only a limited number of chunks is processed at a time so that not the whole file is in memory.
+    const int maxRunningChunks = qMax(statisticsParserThreadPool()->maxThreadCount(), 1) * 2;
+    QQueue<QFuture<fileChunkIndex> > runningChunks;
+    QQueue<qint64> runningChunksEnd;
+    qint64 nextChunkStart = 0;
+
+    int lastPOC = INT_INVALID;
+    int lastType = INT_INVALID;
+    try
     {
-      // Fill the buffer
-      int bufferSize = inputFile.readBytes(inputBuffer, bufferStartPos, STAT_PARSING_BUFFER_SIZE);
-      if (bufferSize < STAT_PARSING_BUFFER_SIZE)
-        // Less bytes than the maximum buffer size were read. The file is at the end.
-        // This is the last run of the loop.
-        fileAtEnd = true;
-
-      for (int i = 0; i < bufferSize; i++)
+      while ((nextChunkStart < fileSize || !runningChunks.isEmpty()) && !cancelBackgroundParser.loadAcquire())
       {
-        // Search for '\n' newline characters
-        if (inputBuffer.at(i) == 10)
+        while (nextChunkStart < fileSize && runningChunks.count() < maxRunningChunks)
         {
-          // We found a newline character
-          if (lineBuffer.size() > 0)
-          {
-            // Parse the previous line
-            // get components of this line
-            QStringList rowItemList = parseCSVLine(lineBuffer, ';');
+          const qint64 chunkStart = nextChunkStart;
+          const qint64 chunkEnd = qMin(chunkStart + STAT_PARSING_CHUNK_SIZE, fileSize);
+          runningChunks.enqueue(QtConcurrent::run(statisticsParserThreadPool(), [=]{ return indexFileChunk(fileName, chunkStart, chunkEnd); }));
+          runningChunksEnd.enqueue(chunkEnd);
+          nextChunkStart = chunkEnd;
+        }
 
-            // ignore empty entries and headers
-            if (!rowItemList[0].isEmpty() && rowItemList[0][0] != '%')
+        const fileChunkIndex chunkIndex = runningChunks.dequeue().result();
+        const qint64 chunkEnd = runningChunksEnd.dequeue();
+        if (!chunkIndex.ok)
+          // Without the chunk, POCs/types would be missing from the index
+          throw "Error reading the statistics file.";
+
+        for (const pocTypeStart &entry : chunkIndex.entries)
+        {
+          const int poc = entry.poc;
+          const int typeID = entry.typeID;
+
+          if (lastType == -1 && lastPOC == -1)
+          {
+            // First POC/type line
+            pocTypeStartList[poc][typeID] = entry.filePos;
+            if (poc == currentDrawnFrameIdx)
+              // We added a start position for the frame index that is currently drawn. We might have to redraw.
+              emit signalItemChanged(true);
+
+            lastType = typeID;
+            lastPOC = poc;
+
+            // update number of frames
+            if (poc > maxPOC)
+              maxPOC = poc;
+          }
+          else if (typeID != lastType && poc == lastPOC)
+          {
+            // we found a new type but the POC stayed the same.
+            // This seems to be an interleaved file
+            // Check if we already collected a start position for this type
+            fileSortedByPOC = true;
+            lastType = typeID;
+            if (!pocTypeStartList[poc].contains(typeID))
             {
-              // check for POC/type information
-              int poc = rowItemList[0].toInt();
-              int typeID = rowItemList[5].toInt();
-
-              if (lastType == -1 && lastPOC == -1)
-              {
-                // First POC/type line
-                pocTypeStartList[poc][typeID] = lineBufferStartPos;
-                if (poc == currentDrawnFrameIdx)
-                  // We added a start position for the frame index that is currently drawn. We might have to redraw.
-                  emit signalItemChanged(true);
-
-                lastType = typeID;
-                lastPOC = poc;
-
-                // update number of frames
-                if (poc > maxPOC)
-                  maxPOC = poc;
-              }
-              else if (typeID != lastType && poc == lastPOC)
-              {
-                // we found a new type but the POC stayed the same.
-                // This seems to be an interleaved file
-                // Check if we already collected a start position for this type
-                fileSortedByPOC = true;
-                lastType = typeID;
-                if (!pocTypeStartList[poc].contains(typeID))
-                {
-                  pocTypeStartList[poc][typeID] = lineBufferStartPos;
-                  if (poc == currentDrawnFrameIdx)
-                    // We added a start position for the frame index that is currently drawn. We might have to redraw.
-                    emit signalItemChanged(true);
-                }
-              }
-              else if (poc != lastPOC)
-              {
-                // We found a new POC
-                if (fileSortedByPOC)
-                {
-                  // There must not be a start position for any type with this POC already.
-                  if (pocTypeStartList.contains(poc))
-                    throw "The data for each POC must be continuous in an interleaved statistics file->";
-                }
-                else
-                {
-                  // There must not be a start position for this POC/type already.
-                  if (pocTypeStartList.contains(poc) && pocTypeStartList[poc].contains(typeID))
-                    throw "The data for each typeID must be continuous in an non interleaved statistics file->";
-                }
-
-                lastPOC = poc;
-                lastType = typeID;
-
-                pocTypeStartList[poc][typeID] = lineBufferStartPos;
-                if (poc == currentDrawnFrameIdx)
-                  // We added a start position for the frame index that is currently drawn. We might have to redraw.
-                  emit signalItemChanged(true);
-
-                // update number of frames
-                if (poc > maxPOC)
-                  maxPOC = poc;
-
-                // Update percent of file parsed
-                backgroundParserProgress = ((double)lineBufferStartPos * 100 / (double)inputFile.getFileSize());
-              }
+              pocTypeStartList[poc][typeID] = entry.filePos;
+              if (poc == currentDrawnFrameIdx)
+                // We added a start position for the frame index that is currently drawn. We might have to redraw.
+                emit signalItemChanged(true);
             }
           }
+          else if (poc != lastPOC)
+          {
+            // We found a new POC
+            if (fileSortedByPOC)
+            {
+              // There must not be a start position for any type with this POC already.
+              if (pocTypeStartList.contains(poc))
+                throw "The data for each POC must be continuous in an interleaved statistics file->";
+            }
+            else
+            {
+              // There must not be a start position for this POC/type already.
+              if (pocTypeStartList.contains(poc) && pocTypeStartList[poc].contains(typeID))
+                throw "The data for each typeID must be continuous in an non interleaved statistics file->";
+            }
 
-          lineBuffer.clear();
-          lineBufferStartPos = bufferStartPos + i + 1;
+            lastPOC = poc;
+            lastType = typeID;
+
+            pocTypeStartList[poc][typeID] = entry.filePos;
+            if (poc == currentDrawnFrameIdx)
+              // We added a start position for the frame index that is currently drawn. We might have to redraw.
+              emit signalItemChanged(true);
+
+            // update number of frames
+            if (poc > maxPOC)
+              maxPOC = poc;
+          }
         }
-        else
-          // No newline character found
-          lineBuffer.append( inputBuffer.at(i) );
-      }
 
-      bufferStartPos += bufferSize;
+        // Update percent of file parsed
+        backgroundParserProgress = ((double)chunkEnd * 100 / (double)fileSize);
+      }
     }
+    catch (...)
+    {
+      // The chunk workers access this item. Wait for them before we leave.
+      for (QFuture<fileChunkIndex> &chunk : runningChunks)
+        chunk.waitForFinished();
+      throw;
+    }
+    // If parsing was canceled, there may still be chunks running
+    for (QFuture<fileChunkIndex> &chunk : runningChunks)
+      chunk.waitForFinished();
 
     // Parsing complete
     backgroundParserProgress = 100.0;
@@ -278,7 +288,139 @@ void playlistItemStatisticsFile::readFrameAndTypePositionsFromFile()
   return;
 }
 
-void playlistItemStatisticsFile::readHeaderFromFile()
+// Parse an integer like QString::toInt() does for a CSV entry (spaces were removed): The whole entry must be
+// an integer, otherwise 0 is returned.
+static int parseCSVInt(const char *start, const char *end)
+{
+  while (start < end && (*start == ' ' || *start == '\t' || *start == '\r'))
+    start++;
+  bool negative = false;
+  if (start < end && (*start == '-' || *start == '+'))
+  {
+    negative = (*start == '-');
+    start++;
+  }
+  qint64 val = 0;
+  bool anyDigit = false;
+  for (; start < end; start++)
+  {
+    if (*start >= '0' && *start <= '9')
+    {
+      val = val * 10 + (*start - '0');
+      anyDigit = true;
+      if (val > INT_MAX)
+        return 0;
+    }
+    else if (*start != ' ' && *start != '\t' && *start != '\r')
+      return 0;
+  }
+  if (!anyDigit)
+    return 0;
+  return int(negative ? -val : val);
+}
+
+playlistItemStatisticsFile::fileChunkIndex playlistItemStatisticsFile::indexFileChunk(const QString &fileName, qint64 chunkStart, qint64 chunkEnd) const
+{
+  fileChunkIndex chunkIndex;
+  QFile inputFile(fileName);
+  if (!inputFile.open(QIODevice::ReadOnly))
+    return chunkIndex;
+
+  // A line belongs to the chunk in which it starts. So we start reading one byte before the chunk starts. If this
+  // is not a newline, the first line started in the previous chunk. The last line may end after the chunk.
+  const qint64 readStart = (chunkStart == 0) ? 0 : chunkStart - 1;
+  if (!inputFile.seek(readStart))
+    return chunkIndex;
+  QByteArray buffer = inputFile.read(chunkEnd - readStart);
+  if (buffer.size() != chunkEnd - readStart)
+    return chunkIndex;
+  if (chunkEnd < inputFile.size() && !buffer.endsWith('\n'))
+  {
+    while (!inputFile.atEnd())
+    {
+      QByteArray rest = inputFile.read(STAT_PARSING_BUFFER_SIZE);
+      if (rest.isEmpty())
+        // Reading failed
+        return chunkIndex;
+      const int newlinePos = rest.indexOf('\n');
+      if (newlinePos >= 0)
+      {
+        buffer.append(rest.constData(), newlinePos + 1);
+        break;
+      }
+      buffer.append(rest);
+    }
+  }
+
+  const char *data = buffer.constData();
+  const char *bufferEnd = data + buffer.size();
+  const char *lineStart = data;
+  if (chunkStart != 0)
+  {
+    lineStart = (const char*)memchr(data, '\n', buffer.size());
+    if (lineStart == nullptr)
+    {
+      // The whole chunk is part of a line that started in the previous chunk
+      chunkIndex.ok = true;
+      return chunkIndex;
+    }
+    lineStart++;
+  }
+
+  // Within a run of lines with the same POC, only the first line of each type is of interest
+  int currentPOC = INT_INVALID;
+  bool firstLine = true;
+  QSet<int> typesOfCurrentPOC;
+  while (lineStart < bufferEnd && readStart + (lineStart - data) < chunkEnd && !cancelBackgroundParser.loadAcquire())
+  {
+    const char *lineEnd = (const char*)memchr(lineStart, '\n', bufferEnd - lineStart);
+    if (lineEnd == nullptr)
+      lineEnd = bufferEnd;
+
+    // Skip leading white spaces. Ignore empty lines and headers.
+    const char *p = lineStart;
+    while (p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+      p++;
+    if (p < lineEnd && *p != ';' && *p != '%')
+    {
+      // Find the POC (column 0) and the typeID (column 5)
+      const char *columnStart[7];
+      int nrColumns = 0;
+      columnStart[nrColumns++] = p;
+      for (const char *c = p; c < lineEnd && nrColumns < 7; c++)
+        if (*c == ';')
+          columnStart[nrColumns++] = c + 1;
+
+      if (nrColumns >= 6)
+      {
+        const int poc = parseCSVInt(columnStart[0], columnStart[1] - 1);
+        const int typeID = parseCSVInt(columnStart[5], (nrColumns > 6) ? columnStart[6] - 1 : lineEnd);
+        if (firstLine || poc != currentPOC)
+        {
+          currentPOC = poc;
+          firstLine = false;
+          typesOfCurrentPOC.clear();
+        }
+        if (!typesOfCurrentPOC.contains(typeID))
+        {
+          typesOfCurrentPOC.insert(typeID);
+          pocTypeStart entry;
+          entry.poc = poc;
+          entry.typeID = typeID;
+          entry.filePos = readStart + (lineStart - data);
+          chunkIndex.entries.append(entry);
+        }
+      }
+    }
+
+    lineStart = lineEnd + 1;
+  }
+
+  chunkIndex.ok = true;
+  return chunkIndex;
+}
+
+void playlistItemStatisticsFile::readHeaderFromFile(QIODevice *input)
 {
   try
   {
@@ -294,10 +436,10 @@ void playlistItemStatisticsFile::readHeaderFromFile()
     bool typeParsingActive = false;
     StatisticsType aType;
 
-    while (!file.atEnd())
+    while (!input->atEnd())
     {
       // read one line
-      QByteArray aLineByteArray = file.readLine();
+      QByteArray aLineByteArray = input->readLine();
       QString aLine(aLineByteArray);
 
       // get components of this line
@@ -445,115 +587,133 @@ void playlistItemStatisticsFile::readHeaderFromFile()
 
 void playlistItemStatisticsFile::loadStatisticToCache(int frameIdx, int typeID)
 {
+  if (binaryFile.isOpen())
+  {
+    // The position of the statistics is known. The records are copied to the cache directly.
+    statisticsData statsData;
+    binaryFile.readStatistics(frameIdx, typeID, statsData);
+    statSource.statsCache.insert(typeID, statsData);
+    return;
+  }
+
   try
   {
     if (!file.isOk())
       return;
 
     QTextStream in( file.getQFile() );
+    readStatisticsFromCSV(in, frameIdx, typeID, statSource.statsCache);
+  } // try
+  catch (const char *str)
+  {
+    std::cerr << "Error while parsing: " << str << '\n';
+    parsingError = QString("Error while parsing meta data: ") + QString(str);
+    return;
+  }
+  catch (...)
+  {
+    std::cerr << "Error while parsing.";
+    parsingError = QString("Error while parsing meta data.");
+    return;
+  }
 
-    if (!pocTypeStartList.contains(frameIdx) || !pocTypeStartList[frameIdx].contains(typeID))
-    {
-      // There are no statistics in the file for the given frame and index.
-      statSource.statsCache.insert(typeID, statisticsData());
-      return;
-    }
+  return;
+}
 
+bool playlistItemStatisticsFile::readStatisticsFromCSV(QTextStream &in, int frameIdx, int typeID, QHash<int, statisticsData> &cache)
+{
+  if (!pocTypeStartList.contains(frameIdx) || !pocTypeStartList[frameIdx].contains(typeID))
+  {
+    // There are no statistics in the file for the given frame and index.
+    cache.insert(typeID, statisticsData());
+    return true;
+  }
 
-    qint64 startPos = pocTypeStartList[frameIdx][typeID];
-    if (fileSortedByPOC)
-    {
-      // If the statistics file is sorted by POC we have to start at the first entry of this POC and parse the
-      // file until another POC is encountered. If this is not done, some information from a different typeID
-      // could be ignored during parsing.
-
-      // Get the position of the first line with the given frameIdx
-      startPos = std::numeric_limits<qint64>::max();
-      for (const qint64 &value : pocTypeStartList[frameIdx])
-        if (value < startPos)
-          startPos = value;
-    }
 
-    // fast forward
-    in.seek(startPos);
+  qint64 startPos = pocTypeStartList[frameIdx][typeID];
+  if (fileSortedByPOC)
+  {
+    // If the statistics file is sorted by POC we have to start at the first entry of this POC and parse the
+    // file until another POC is encountered. If this is not done, some information from a different typeID
+    // could be ignored during parsing.
+
+    // Get the position of the first line with the given frameIdx
+    startPos = std::numeric_limits<qint64>::max();
+    for (const qint64 &value : pocTypeStartList[frameIdx])
+      if (value < startPos)
+        startPos = value;
+  }
 
-    while (!in.atEnd())
-    {
-      // read one line
-      QString aLine = in.readLine();
+  // fast forward
+  in.seek(startPos);
 
-      // get components of this line
-      QStringList rowItemList = parseCSVLine(aLine, ';');
+  bool blocksInRange = true;
+  const int maxBlockPos = std::numeric_limits<unsigned short>::max();
+  while (!in.atEnd())
+  {
+    // read one line
+    QString aLine = in.readLine();
 
-      if (rowItemList[0].isEmpty())
-        continue;
+    // get components of this line
+    QStringList rowItemList = parseCSVLine(aLine, ';');
 
-      int poc = rowItemList[0].toInt();
-      int type = rowItemList[5].toInt();
+    if (rowItemList[0].isEmpty())
+      continue;
 
-      // if there is a new POC, we are done here!
-      if (poc != frameIdx)
-        break;
-      // if there is a new type and this is a non interleaved file, we are done here.
-      if (!fileSortedByPOC && type != typeID)
-        break;
+    int poc = rowItemList[0].toInt();
+    int type = rowItemList[5].toInt();
 
-      int values[4] = {0};
+    // if there is a new POC, we are done here!
+    if (poc != frameIdx)
+      break;
+    // if there is a new type and this is a non interleaved file, we are done here.
+    if (!fileSortedByPOC && type != typeID)
+      break;
 
-      values[0] = rowItemList[6].toInt();
+    int values[4] = {0};
 
-      bool vectorData = false;
-      bool lineData = false; // or a vector specified by 2 points
+    values[0] = rowItemList[6].toInt();
 
-      if (rowItemList.count() > 7)
-      {
-        values[1] = rowItemList[7].toInt();
-        vectorData = true;
-      }
-      if (rowItemList.count() > 8)
-      {
-        values[2] = rowItemList[8].toInt();
-        values[3] = rowItemList[9].toInt();
-        lineData = true;
-        vectorData = false;
-      }
+    bool vectorData = false;
+    bool lineData = false; // or a vector specified by 2 points
 
-      int posX = rowItemList[1].toInt();
-      int posY = rowItemList[2].toInt();
-      int width = rowItemList[3].toUInt();
-      int height = rowItemList[4].toUInt();
-
-      // Check if block is within the image range
-      if (blockOutsideOfFrame_idx == -1 && (posX + width > statSource.statFrameSize.width() || posY + height > statSource.statFrameSize.height()))
-        // Block not in image. Warn about this.
-        blockOutsideOfFrame_idx = frameIdx;
-
-      const StatisticsType *statsType = statSource.getStatisticsType(type);
-      Q_ASSERT_X(statsType != nullptr, "StatisticsObject::readStatisticsFromFile", "Stat type not found.");
-
-      if (vectorData && statsType->hasVectorData)
-        statSource.statsCache[type].addBlockVector(posX, posY, width, height, values[0], values[1]);
-      else if (lineData && statsType->hasVectorData)
-        statSource.statsCache[type].addLine(posX, posY, width, height, values[0], values[1], values[2], values[3]);
-      else
-        statSource.statsCache[type].addBlockValue(posX, posY, width, height, values[0]);
+    if (rowItemList.count() > 7)
+    {
+      values[1] = rowItemList[7].toInt();
+      vectorData = true;
+    }
+    if (rowItemList.count() > 8)
+    {
+      values[2] = rowItemList[8].toInt();
+      values[3] = rowItemList[9].toInt();
+      lineData = true;
+      vectorData = false;
     }
 
-  } // try
-  catch (const char *str)
-  {
-    std::cerr << "Error while parsing: " << str << '\n';
-    parsingError = QString("Error while parsing meta data: ") + QString(str);
-    return;
-  }
-  catch (...)
-  {
-    std::cerr << "Error while parsing.";
-    parsingError = QString("Error while parsing meta data.");
-    return;
+    int posX = rowItemList[1].toInt();
+    int posY = rowItemList[2].toInt();
+    int width = rowItemList[3].toUInt();
+    int height = rowItemList[4].toUInt();
+
+    // Check if block is within the image range
+    if (blockOutsideOfFrame_idx == -1 && (posX + width > statSource.statFrameSize.width() || posY + height > statSource.statFrameSize.height()))
+      // Block not in image. Warn about this.
+      blockOutsideOfFrame_idx = frameIdx;
+    if (posX < 0 || posY < 0 || width < 0 || height < 0 || posX > maxBlockPos || posY > maxBlockPos || width > maxBlockPos || height > maxBlockPos)
+      // The position and size of a block are saved with 16 bit
+      blocksInRange = false;
+
+    const StatisticsType *statsType = statSource.getStatisticsType(type);
+    Q_ASSERT_X(statsType != nullptr, "StatisticsObject::readStatisticsFromFile", "Stat type not found.");
+
+    if (vectorData && statsType->hasVectorData)
+      cache[type].addBlockVector(posX, posY, width, height, values[0], values[1]);
+    else if (lineData && statsType->hasVectorData)
+      cache[type].addLine(posX, posY, width, height, values[0], values[1], values[2], values[3]);
+    else
+      cache[type].addBlockValue(posX, posY, width, height, values[0]);
   }
-
-  return;
+  return blocksInRange;
 }
 
 QStringList playlistItemStatisticsFile::parseCSVLine(const QString &srcLine, char delimiter) const
@@ -600,6 +760,12 @@ void playlistItemStatisticsFile::createPropertiesWidget()
   line->setFrameShadow(QFrame::Sunken);
 
   vAllLaout->addLayout(createPlaylistItemControls());
+  if (!binaryFile.isOpen())
+  {
+    QPushButton *convertButton = new QPushButton("Convert to Binary Statistics File...");
+    connect(convertButton, &QPushButton::clicked, this, &playlistItemStatisticsFile::convertToBinaryFile);
+    vAllLaout->addWidget(convertButton);
+  }
   vAllLaout->addWidget(line);
   vAllLaout->addLayout(statSource.createStatisticsHandlerControls());
 
@@ -607,6 +773,98 @@ void playlistItemStatisticsFile::createPropertiesWidget()
   // expand to take up as much space as there is available
 }
 
+void playlistItemStatisticsFile::convertToBinaryFile()
+{
+  if (binaryFile.isOpen() || !file.isOk())
+    return;
+  if (backgroundParserFuture.isRunning())
+  {
+    QMessageBox::information(propertiesWidget.data(), "Convert Statistics File", "The statistics file is still being parsed. Please try again when parsing is finished.");
+    return;
+  }
+
+  QFileInfo csvFileInfo(file.getAbsoluteFilePath());
+  QString defaultName = csvFileInfo.path() + "/" + csvFileInfo.completeBaseName() + "." + statisticsBinaryFile::getFileExtension();
+  QString fileName = QFileDialog::getSaveFileName(propertiesWidget.data(), "Save Binary Statistics File", defaultName, QString("Binary Statistics File (*.%1)").arg(statisticsBinaryFile::getFileExtension()));
+  if (fileName.isEmpty())
+    return;
+  if (!fileName.endsWith("." + statisticsBinaryFile::getFileExtension(), Qt::CaseInsensitive))
+    fileName += "." + statisticsBinaryFile::getFileExtension();
+
+  // Open the CSV file again so that loading of the statistics that are shown is not disturbed
+  QFile csvFile(file.getAbsoluteFilePath());
+  if (!csvFile.open(QIODevice::ReadOnly))
+  {
+    QMessageBox::warning(propertiesWidget.data(), "Convert Statistics File", "Error opening the statistics file.");
+    return;
+  }
+
+  // The header lines (everything before the first line with statistics data) are copied to the binary file
+  QByteArray headerText;
+  while (!csvFile.atEnd())
+  {
+    QByteArray line = csvFile.readLine();
+    QByteArray trimmedLine = line.trimmed();
+    if (!trimmedLine.isEmpty() && trimmedLine[0] != '%')
+      break;
+    headerText.append(line);
+  }
+
+  QList<int> typeIDs;
+  for (const StatisticsType &type : statSource.getStatisticsTypeList())
+    typeIDs.append(type.typeID);
+
+  QProgressDialog progress("Converting statistics file...", "Cancel", 0, maxPOC + 1, propertiesWidget.data());
+  progress.setMinimumDuration(1000);  // Show after 1s
+  progress.setWindowModality(Qt::WindowModal);
+
+  QString errorString;
+  bool canceled = false;
+  {
+    statisticsBinaryFile::writer binaryWriter;
+    bool ok = binaryWriter.start(fileName, headerText, typeIDs, maxPOC);
+    QTextStream in(&csvFile);
+    for (int poc = 0; ok && poc <= maxPOC; poc++)
+    {
+      progress.setValue(poc);
+      if (progress.wasCanceled())
+      {
+        canceled = true;
+        break;
+      }
+      if (!pocTypeStartList.contains(poc))
+        continue;
+
+      // In an interleaved file, all types of the POC are parsed at once
+      QHash<int, statisticsData> frameStatistics;
+      bool blocksInRange = true;
+      for (int typeID : pocTypeStartList[poc].keys())
+        if (!frameStatistics.contains(typeID))
+          blocksInRange &= readStatisticsFromCSV(in, poc, typeID, frameStatistics);
+      if (!blocksInRange)
+      {
+        // Don't write a file with truncated blocks
+        errorString = QString("The position or size of a block in POC %1 is bigger than 65535. This is not supported by binary statistics files.").arg(poc);
+        break;
+      }
+      ok = binaryWriter.addFrame(poc, frameStatistics);
+    }
+    if (ok && !canceled && errorString.isEmpty())
+      ok = binaryWriter.finish();
+    if (!ok)
+      errorString = binaryWriter.getErrorString();
+  }
+  progress.setValue(maxPOC + 1);
+
+  if (canceled || !errorString.isEmpty())
+  {
+    // Do not leave an incomplete file
+    QFile::remove(fileName);
+    if (!canceled)
+      QMessageBox::warning(propertiesWidget.data(), "Convert Statistics File", errorString);
+  }
+}
+
 void playlistItemStatisticsFile::savePlaylist(QDomElement &root, const QDir &playlistDir) const
 {
   // Determine the relative path to the YUV file-> We save both in the playlist.
@@ -655,7 +913,9 @@ playlistItemStatisticsFile *playlistItemStatisticsFile::newplaylistItemStatistic
 void playlistItemStatisticsFile::getSupportedFileExtensions(QStringList &allExtensions, QStringList &filters)
 {
   allExtensions.append("csv");
+  allExtensions.append(statisticsBinaryFile::getFileExtension());
   filters.append("Statistics File (*.csv)");
+  filters.append(QString("Binary Statistics File (*.%1)").arg(statisticsBinaryFile::getFileExtension()));
 }
 
 void playlistItemStatisticsFile::reloadItemSource()
@@ -672,7 +932,7 @@ void playlistItemStatisticsFile::reloadItemSource()
   if (backgroundParserFuture.isRunning())
   {
     // signal to background thread that we want to cancel the processing
-    cancelBackgroundParser = true;
+    cancelBackgroundParser.storeRelease(1);
     backgroundParserFuture.waitForFinished();
   }
 
@@ -681,20 +941,48 @@ void playlistItemStatisticsFile::reloadItemSource()
   statSource.statsCache.clear();
   statSource.statsCacheFrameIdx = -1;
 
-  // Reopen the file
+  // Reopen the file and read the new statistics file header
+  if (!openStatisticsFile())
+    return;
+
+  statSource.updateStatisticsHandlerControls();
+}
+
+bool playlistItemStatisticsFile::openStatisticsFile()
+{
+  binaryFile.close();
   file.openFile(plItemNameOrFileName);
   if (!file.isOk())
-    return;
+    return false;
 
-  // Read the new statistics file header
-  readHeaderFromFile();
+  if (statisticsBinaryFile::isBinaryStatisticsFile(plItemNameOrFileName))
+  {
+    // The binary file contains the header of the CSV file and the positions of all POCs/types.
+    // No parsing in the background is needed.
+    if (!binaryFile.openFile(plItemNameOrFileName))
+    {
+      parsingError = binaryFile.getErrorString();
+      return false;
+    }
+    QByteArray headerText = binaryFile.getHeaderText();
+    QBuffer headerBuffer(&headerText);
+    headerBuffer.open(QIODevice::ReadOnly);
+    readHeaderFromFile(&headerBuffer);
 
-  statSource.updateStatisticsHandlerControls();
+    maxPOC = qMax(binaryFile.getMaxPOC(), 0);
+    backgroundParserProgress = 100.0;
+    setStartEndFrame(indexRange(0, maxPOC), false);
+    return true;
+  }
+
+  // Read the statistics file header
+  readHeaderFromFile(file.getQFile());
 
   // Run the parsing of the file in the background
-  cancelBackgroundParser = false;
+  cancelBackgroundParser.storeRelease(0);
   timer.start(1000, this);
   backgroundParserFuture = QtConcurrent::run(this, &playlistItemStatisticsFile::readFrameAndTypePositionsFromFile);
+  return true;
 }
 
 void playlistItemStatisticsFile::loadFrame(int frameIdx, bool playback, bool loadRawdata)
@@ -33,11 +33,14 @@
 #ifndef PLAYLISTITEMSTATISTICSFILE_H
 #define PLAYLISTITEMSTATISTICSFILE_H
 
+#include <QAtomicInt>
 #include <QBasicTimer>
 #include <QFuture>
+#include <QTextStream>
 #include "fileSource.h"
 #include "playlistItem.h"
 #include "statisticHandler.h"
+#include "statisticsBinaryFile.h"
 
 class playlistItemStatisticsFile : public playlistItem
 {
@@ -103,6 +106,10 @@ public slots:
   //! types which were not requested by the given 'type'.
   void loadStatisticToCache(int frameIdx, int type);
 
+private slots:
+  // Convert the CSV statistics file to a binary statistics file (the user selects the file name)
+  void convertToBinaryFile();
+
 protected:
   // Overload from playlistItem. Create a properties widget custom to the statistics item
   // and set propertiesWidget to point to it.
@@ -116,11 +123,22 @@ private:
   // Is the loadFrame function currently loading?
   bool isStatisticsLoading;
 
-  //! Scan the header: What types are saved in this file?
-  void readHeaderFromFile();
+  //! Scan the header: What types are saved in this file? The header lines are read from the given device
+  //! (the CSV file or the header text of a binary statistics file).
+  void readHeaderFromFile(QIODevice *input);
   
   QStringList parseCSVLine(const QString &line, char delimiter) const;
 
+  //! Parse the statistics with frameIdx/typeID from the CSV file and put them into the given cache. In an interleaved
+  //! file, all types of the frame are parsed. Return false if the position or size of a block did not fit into 16 bit
+  //! (the block is still added but the values are truncated).
+  bool readStatisticsFromCSV(QTextStream &in, int frameIdx, int typeID, QHash<int, statisticsData> &cache);
+
+  // If the file is a binary statistics file, it is read using this. No background parsing is needed then.
+  statisticsBinaryFile binaryFile;
+  // Open the file (CSV or binary) and read the header. For a CSV file, the background parser is started.
+  bool openStatisticsFile();
+
   // A list of file positions where each POC/type starts
   QMap<int, QMap<int, qint64> > pocTypeStartList;
 
@@ -129,9 +147,25 @@ private:
   //! Parser the whole file and get the positions where a new POC/type starts. Save this position in p_pocTypeStartList.
   //! This is performed in the background using a QFuture.
   void readFrameAndTypePositionsFromFile();
+  //! The file is indexed in chunks in parallel. For each chunk, the positions of the lines where a POC starts and where
+  //! a type occurs for the first time within the lines of that POC are returned in the order of the file.
+  //! If the chunk could not be read, ok is false.
+  struct pocTypeStart
+  {
+    int poc;
+    int typeID;
+    qint64 filePos;
+  };
+  struct fileChunkIndex
+  {
+    fileChunkIndex() : ok(false) {}
+    bool ok;
+    QList<pocTypeStart> entries;
+  };
+  fileChunkIndex indexFileChunk(const QString &fileName, qint64 chunkStart, qint64 chunkEnd) const;
   QFuture<void> backgroundParserFuture;
   double backgroundParserProgress;
-  bool cancelBackgroundParser;
+  QAtomicInt cancelBackgroundParser;
   // A timer is used to frequently update the status of the background process (every second)
   QBasicTimer timer;
   virtual void timerEvent(QTimerEvent *event) Q_DECL_OVERRIDE; // Overloaded from QObject. Called when the timer fires.
@@ -32,6 +32,8 @@
 
 #include "playlistItemWithVideo.h"
 
+#include <QTimerEvent>
+
 // Activate this if you want to know when which buffer is loaded/converted to image and so on.
 #define PLAYLISTITEMWITHVIDEO_DEBUG_LOADING 0
 #if PLAYLISTITEMWITHVIDEO_DEBUG_LOADING && !NDEBUG
@@ -101,4 +103,30 @@ itemLoadingState playlistItemWithVideo::needsLoading(int frameIdx, bool loadRawV
   if (video)
     return video->needsLoading(frameIdx, loadRawValues);
   return LoadingNotNeeded;
-}
\ No newline at end of file
+}
+
+void playlistItemWithVideo::startBackgroundScanTimer()
+{
+  if (isScanningInBackground())
+    backgroundScanTimer.start(1000, this);
+}
+
+void playlistItemWithVideo::appendBackgroundScanInfo(infoData &info) const
+{
+  if (isScanningInBackground())
+    info.items.append(infoItem("Parsing:", QString("%1%...").arg(getBackgroundScanProgress(), 0, 'f', 2)));
+}
+
+// This timer event is called regularly when the background scan of the file is running.
+void playlistItemWithVideo::timerEvent(QTimerEvent *event)
+{
+  if (event->timerId() != backgroundScanTimer.timerId())
+    return playlistItem::timerEvent(event);
+
+  // If the scan is done, this is the last update
+  if (!isScanningInBackground())
+    backgroundScanTimer.stop();
+
+  // Update the frame limits with the frames found so far. This also emits signalItemChanged.
+  slotUpdateFrameLimits();
+}
@@ -33,6 +33,7 @@
 #ifndef PLAYLISTITEMWITHVIDEO_H
 #define PLAYLISTITEMWITHVIDEO_H
 
+#include <QBasicTimer>
 #include "playlistItem.h"
 #include "videoHandler.h"
 
@@ -62,10 +63,14 @@ public:
   virtual void cacheFrame(int idx) Q_DECL_OVERRIDE { if (!cachingEnabled) return; video->cacheFrame(idx); }
   // Get a list of all cached frames (just the frame indices)
   virtual QList<int> getCachedFrames() const Q_DECL_OVERRIDE { return video->getCachedFrames(); }
+  virtual int getNumberCachedFrames() const Q_DECL_OVERRIDE { return video->getNrFramesCached(); }
   // How many bytes will caching one frame use (in bytes)?
   virtual unsigned int getCachingFrameSize() const Q_DECL_OVERRIDE { return video->getCachingFrameSize(); }
   // Remove the given frame from the cache (-1: all frames)
   virtual void removeFrameFromCache(int idx) Q_DECL_OVERRIDE { video->removefromCache(idx); }
+  // The cost of reloading a cached frame and its last use
+  virtual qint64 getCachedFrameReloadCost(int idx) const Q_DECL_OVERRIDE { return video->getCachedFrameReloadCost(idx); }
+  virtual qint64 getCachedFrameLastAccess(int idx) const Q_DECL_OVERRIDE { return video->getCachedFrameLastAccess(idx); }
   // This item is cachable, if caching is enabled and if the raw format is valid (can be cached).
   virtual bool isCachable() const Q_DECL_OVERRIDE { return cachingEnabled && video->isFormatValid(); }
 
@@ -86,6 +91,19 @@ protected:
   // Is the loadFrame function currently loading?
   bool isFrameLoading;
   bool isFrameLoadingDoubleBuffer;
+
+  // ----- Background scan of the source file -----
+  // Some items (e.g. HEVC and FFmpeg files) scan their file in the background and can already be used while the scan is
+  // running. Reimplement these to provide the state of the scan.
+  virtual bool isScanningInBackground() const { return false; }
+  virtual double getBackgroundScanProgress() const { return 0.0; }
+  // If the background scan is running, start a timer that updates the frame limits with the frames that were found so
+  // far (every second).
+  void startBackgroundScanTimer();
+  // Append the progress of the background scan (if running) to the info
+  void appendBackgroundScanInfo(infoData &info) const;
+  QBasicTimer backgroundScanTimer;
+  virtual void timerEvent(QTimerEvent *event) Q_DECL_OVERRIDE; // Overloaded from QObject. Called when the timer fires.
 };
 
 #endif
\ No newline at end of file
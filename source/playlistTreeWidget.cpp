@@ -90,7 +90,7 @@ public:
 
     // Draw the percentage as text
     //painter.setPen(Qt::black);
-    float bufferPercent = (float)plItem->getCachedFrames().count() / (float)(range.second + 1 - range.first) * 100;
+    float bufferPercent = (float)plItem->getNumberCachedFrames() / (float)(range.second + 1 - range.first) * 100;
     QString pTxt = QString::number(bufferPercent, 'f', 0) + "%";
     painter.drawText(0, 0, s.width(), s.height(), Qt::AlignCenter, pTxt);
 
@@ -37,6 +37,7 @@
 #include <QSettings>
 #include "typedef.h"
 #include "FFmpegDecoder.h"
+#include "frameDiskCache.h"
 
 #define MIN_CACHE_SIZE_IN_MB (20u)
 
@@ -62,6 +63,9 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
   else
     ui.spinBoxNrThreads->setValue(getOptimalThreadCount());
   ui.spinBoxNrThreads->setEnabled(ui.checkBoxNrThreads->isChecked());
+  ui.spinBoxConversionThreads->setValue(settings.value("ConversionThreads", getOptimalThreadCount()).toInt());
+  ui.spinBoxDecoderThreads->setValue(settings.value("DecoderThreads", getOptimalThreadCount()).toInt());
+  ui.checkBoxCacheRawData->setChecked(settings.value("CacheRawData", false).toBool());
 
   // Caching
   ui.checkBoxPausPlaybackForCaching->setChecked(settings.value("PlaybackPauseCaching", true).toBool());
@@ -69,6 +73,13 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
   ui.checkBoxEnablePlaybackCaching->setChecked(playbackCaching);
   ui.spinBoxThreadLimit->setValue(settings.value("PlaybackCachingThreadLimit", 1).toInt());
   ui.spinBoxThreadLimit->setEnabled(playbackCaching);
+
+  // Disk cache
+  ui.groupBoxDiskCache->setChecked(settings.value("DiskCacheEnabled", false).toBool());
+  ui.spinBoxDiskCacheSize->setValue(settings.value("DiskCacheMaxSizeMB", 10000).toInt());
+  QString diskCacheDirectory = settings.value("DiskCacheDirectory", "").toString();
+  ui.lineEditDiskCacheDirectory->setText(diskCacheDirectory.isEmpty() ? frameDiskCache::getDefaultDirectory() : diskCacheDirectory);
+  ui.pushButtonDiskCacheSelectDirectory->setIcon(convertIcon(":img_folder.png"));
   settings.endGroup();
 
   // Central view settings
@@ -108,6 +119,7 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
 
   // General settings
   ui.checkBoxWatchFiles->setChecked(settings.value("WatchFiles",true).toBool());
+  ui.checkBoxMemoryMapFiles->setChecked(settings.value("MemoryMapFiles",false).toBool());
   ui.checkBoxContinuePlaybackNewSelection->setChecked(settings.value("ContinuePlaybackOnSequenceSelection",false).toBool());
   QString theme = settings.value("Theme", "Default").toString();
   int themeIdx = getThemeNameList().indexOf(theme);
@@ -180,6 +192,13 @@ void SettingsDialog::on_pushButtonFFmpegSelectPath_clicked()
   }
 }
 
+void SettingsDialog::on_pushButtonDiskCacheSelectDirectory_clicked()
+{
+  QString path = QFileDialog::getExistingDirectory(this, "Select the disk cache directory", ui.lineEditDiskCacheDirectory->text());
+  if (!path.isEmpty())
+    ui.lineEditDiskCacheDirectory->setText(path);
+}
+
 void SettingsDialog::checkFFmpegPath()
 {
   QString path = ui.lineEditFFmpegPath->text();
@@ -217,9 +236,15 @@ void SettingsDialog::on_pushButtonSave_clicked()
   settings.setValue("ThresholdValueMB", getCacheSizeInMB());
   settings.setValue("SetNrThreads", ui.checkBoxNrThreads->isChecked());
   settings.setValue("NrThreads", ui.spinBoxNrThreads->value());
+  settings.setValue("ConversionThreads", ui.spinBoxConversionThreads->value());
+  settings.setValue("DecoderThreads", ui.spinBoxDecoderThreads->value());
+  settings.setValue("CacheRawData", ui.checkBoxCacheRawData->isChecked());
   settings.setValue("PlaybackPauseCaching", ui.checkBoxPausPlaybackForCaching->isChecked());
   settings.setValue("PlaybackCachingEnabled", ui.checkBoxEnablePlaybackCaching->isChecked());
   settings.setValue("PlaybackCachingThreadLimit", ui.spinBoxThreadLimit->value());
+  settings.setValue("DiskCacheEnabled", ui.groupBoxDiskCache->isChecked());
+  settings.setValue("DiskCacheMaxSizeMB", ui.spinBoxDiskCacheSize->value());
+  settings.setValue("DiskCacheDirectory", ui.lineEditDiskCacheDirectory->text());
   settings.endGroup();
 
   // Central View Widget
@@ -242,6 +267,7 @@ void SettingsDialog::on_pushButtonSave_clicked()
 
   // General settings
   settings.setValue("WatchFiles", ui.checkBoxWatchFiles->isChecked());
+  settings.setValue("MemoryMapFiles", ui.checkBoxMemoryMapFiles->isChecked());
   settings.setValue("ContinuePlaybackOnSequenceSelection", ui.checkBoxContinuePlaybackNewSelection->isChecked());
   settings.setValue("Theme", ui.comboBoxTheme->currentText());
 
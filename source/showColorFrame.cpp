@@ -91,6 +91,7 @@ void showColorWidget::paintEvent(QPaintEvent *event)
     // Split the rect into lines with width of 1 pixel
     const int y0 = drawRect.bottom();
     const int y1 = drawRect.top();
+    colMapper.updateLUT();
     for (int x=drawRect.left(); x <= drawRect.right(); x++)
     {
       // For every line (1px width), draw a line.
@@ -99,7 +100,7 @@ void showColorWidget::paintEvent(QPaintEvent *event)
       float xRel = (float)x / (drawRect.right() - drawRect.left());   // 0...1
       float xRange = minVal + (maxVal - minVal) * xRel;
 
-      QColor c = colMapper.getColor(xRange);
+      QColor c = QColor::fromRgba(colMapper.getColorRgba(xRange));
       if (isEnabled())
         painter.setPen(c);
       else
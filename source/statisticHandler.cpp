@@ -32,11 +32,19 @@
 
 #include "statisticHandler.h"
 
+#include <algorithm>
 #include <cmath>
 #include <QPainter>
 #include <QtMath>
 #include "signalsSlots.h"
 
+// The value blocks are drawn into a layer image in which one pixel represents at most this many pixels (see updateValueLayer())
+#define STATISTICS_LAYER_MAX_PIXEL_SIZE 16
+// The maximum number of levels of the value layer (each level has half the size of the previous one)
+#define STATISTICS_LAYER_MAX_LEVEL 8
+// The maximum number of pixels of the value layer (32 MB). If the layer would be bigger, the blocks are drawn one by one.
+#define STATISTICS_LAYER_MAX_PIXELS (3840*2160)
+
 // Activate this if you want to know when what is loaded.
 #define STATISTICS_DEBUG_LOADING 0
 #if STATISTICS_DEBUG_LOADING && !NDEBUG
@@ -128,6 +136,9 @@ void statisticHandler::paintStatistics(QPainter *painter, int frameIdx, double z
   int yMin = statRect.height() / 2 - worldTransform.dy();
   int xMax = statRect.width() / 2 - (worldTransform.dx() - viewport.width());
   int yMax = statRect.height() / 2 - (worldTransform.dy() - viewport.height());
+  // The visible area in the coordinates of the statistics (with a margin of one pixel for rounding). Only the
+  // blocks in this area are looked at (using the grid index of the statistics).
+  QRect visibleStatArea(QPoint(int(xMin / zoomFactor) - 1, int(yMin / zoomFactor) - 1), QPoint(int(xMax / zoomFactor) + 1, int(yMax / zoomFactor) + 1));
 
   painter->translate(statRect.topLeft());
 
@@ -163,30 +174,26 @@ void statisticHandler::paintStatistics(QPainter *painter, int frameIdx, double z
       // This statistics type is not rendered or could not be loaded.
       continue;
 
-    // Go through all the value data
-    for (const statisticsItem_Value &valueItem : statsCache[typeIdx].valueData)
+    // The value blocks are drawn from the value layer (one image instead of one rectangle per block)
+    if (statsTypeList[i].renderValueData && !statsCache[typeIdx].valueData.isEmpty())
+      paintValueLayer(painter, statsCache[typeIdx], statsTypeList[i], zoomFactor, visibleStatArea);
+
+    // Go through all the value data to draw the grid and collect the values
+    if (!statsTypeList[i].renderGrid && zoomFactor < STATISTICS_DRAW_VALUES_ZOOM)
+      continue;
+    statsCache[typeIdx].valueData.updateIndex();
+    const statisticsValueBlocks &valueBlocks = statsCache[typeIdx].valueData;
+    for (int b : valueBlocks.getBlocksInRect(visibleStatArea))
     {
       // Calculate the size and position of the rectangle to draw (zoomed in)
-      QRect rect = QRect(valueItem.pos[0], valueItem.pos[1], valueItem.size[0], valueItem.size[1]);
+      QRect rect = valueBlocks.getRect(b);
       QRect displayRect = QRect(rect.left()*zoomFactor, rect.top()*zoomFactor, rect.width()*zoomFactor, rect.height()*zoomFactor);
       // Check if the rectangle of the statistics item is even visible
       bool rectVisible = (!(displayRect.left() > xMax || displayRect.right() < xMin || displayRect.top() > yMax || displayRect.bottom() < yMin));
 
       if (rectVisible)
       {
-        int value = valueItem.value; // This value determines the color for this item
-        if (statsTypeList[i].renderValueData)
-        {
-          // Get the right color for the item and draw it.
-          QColor rectColor;
-          if (statsTypeList[i].scaleValueToBlockSize)
-            rectColor = statsTypeList[i].colMapper.getColor(float(value) / (valueItem.size[0] * valueItem.size[1]));
-          else
-            rectColor = statsTypeList[i].colMapper.getColor(value);
-          rectColor.setAlpha(rectColor.alpha()*((float)statsTypeList[i].alphaFactor / 100.0));
-          painter->setBrush(rectColor);
-          painter->fillRect(displayRect, rectColor);
-        }
+        int value = valueBlocks.value[b];
 
         // optionally, draw a grid around the region
         if (statsTypeList[i].renderGrid)
@@ -210,7 +217,7 @@ void statisticHandler::paintStatistics(QPainter *painter, int frameIdx, double z
         {
           QString valTxt  = statsTypeList[i].getValueTxt(value);
           if (!statsTypeList[i].valMap.contains(value) && statsTypeList[i].scaleValueToBlockSize)
-            valTxt = QString("%1").arg(float(value) / (valueItem.size[0] * valueItem.size[1]));
+            valTxt = QString("%1").arg(float(value) / (rect.width() * rect.height()));
 
           QString typeTxt = statsTypeList[i].typeName;
           QString statTxt = moreThanOneBlockStatRendered ? typeTxt + ":" + valTxt : valTxt;
@@ -254,10 +261,12 @@ void statisticHandler::paintStatistics(QPainter *painter, int frameIdx, double z
       continue;
 
     // Go through all the vector data
-    for (const statisticsItem_Vector &vectorItem : statsCache[typeIdx].vectorData)
+    statsCache[typeIdx].vectorData.updateIndex();
+    const statisticsVectorBlocks &vectorBlocks = statsCache[typeIdx].vectorData;
+    for (int b : vectorBlocks.getBlocksInRect(visibleStatArea))
     {
       // Calculate the size and position of the rectangle to draw (zoomed in)
-      QRect rect = QRect(vectorItem.pos[0], vectorItem.pos[1], vectorItem.size[0], vectorItem.size[1]);
+      QRect rect = vectorBlocks.getRect(b);
       QRect displayRect = QRect(rect.left()*zoomFactor, rect.top()*zoomFactor, rect.width()*zoomFactor, rect.height()*zoomFactor);
       // Check if the rectangle of the statistics item is even visible
       bool rectVisible = (!(displayRect.left() > xMax || displayRect.right() < xMin || displayRect.top() > yMax || displayRect.bottom() < yMin));
@@ -269,12 +278,12 @@ void statisticHandler::paintStatistics(QPainter *painter, int frameIdx, double z
           // start vector at center of the block
           int x1,y1,x2,y2;
           float vx, vy;
-          if (vectorItem.isLine)
+          if (vectorBlocks.isLine[b])
           {
-            x1 = displayRect.left() + zoomFactor*vectorItem.point[0].x();
-            y1 = displayRect.top() + zoomFactor*vectorItem.point[0].y();
-            x2 = displayRect.left() + zoomFactor*vectorItem.point[1].x();
-            y2 = displayRect.top() + zoomFactor*vectorItem.point[1].y();
+            x1 = displayRect.left() + zoomFactor*vectorBlocks.x1[b];
+            y1 = displayRect.top() + zoomFactor*vectorBlocks.y1[b];
+            x2 = displayRect.left() + zoomFactor*vectorBlocks.x2[b];
+            y2 = displayRect.top() + zoomFactor*vectorBlocks.y2[b];
             vx = (float)(x2-x1) / statsTypeList[i].vectorScale;
             vy = (float)(y2-y1) / statsTypeList[i].vectorScale;
           }
@@ -284,8 +293,8 @@ void statisticHandler::paintStatistics(QPainter *painter, int frameIdx, double z
             y1 = displayRect.top() + displayRect.height() / 2;
 
             // The length of the vector
-            vx = (float)vectorItem.point[0].x() / statsTypeList[i].vectorScale;
-            vy = (float)vectorItem.point[0].y() / statsTypeList[i].vectorScale;
+            vx = (float)vectorBlocks.x1[b] / statsTypeList[i].vectorScale;
+            vy = (float)vectorBlocks.y1[b] / statsTypeList[i].vectorScale;
 
             // The end point of the vector
             x2 = x1 + zoomFactor * vx;
@@ -416,6 +425,157 @@ StatisticsType* statisticHandler::getStatisticsType(int typeID)
   return nullptr;
 }
 
+// Draw the premultiplied color src over dst (like QPainter::CompositionMode_SourceOver)
+static inline QRgb blendSourceOver(QRgb dst, QRgb src)
+{
+  const int ia = 255 - qAlpha(src);
+  return qRgba(qRed(src)   + (qRed(dst)   * ia + 127) / 255,
+               qGreen(src) + (qGreen(dst) * ia + 127) / 255,
+               qBlue(src)  + (qBlue(dst)  * ia + 127) / 255,
+               qAlpha(src) + (qAlpha(dst) * ia + 127) / 255);
+}
+
+bool statisticHandler::updateValueLayer(statisticsData &statsData, StatisticsType &type)
+{
+  statisticsValueLayer &layer = statsData.valueLayer;
+  const statisticsValueBlocks &blocks = statsData.valueData;
+  if (layer.nrBlocks == blocks.count() && layer.alphaFactor == type.alphaFactor &&
+      layer.scaleValueToBlockSize == type.scaleValueToBlockSize && !(layer.colMapper != type.colMapper))
+    // The layer is up to date (or it was too big)
+    return !layer.levels.isEmpty();
+
+  DEBUG_STAT("statisticHandler::updateValueLayer type %d", type.typeID);
+
+  // The blocks are usually aligned to a grid (e.g. 4x4). Then one pixel of the layer can represent a whole
+  // grid cell. Also get the size of the layer (blocks may be outside of the frame).
+  int alignment = 0;
+  int width = statFrameSize.width();
+  int height = statFrameSize.height();
+  for (int b = 0; b < blocks.count(); b++)
+  {
+    alignment |= blocks.posX[b] | blocks.posY[b] | blocks.width[b] | blocks.height[b];
+    width = qMax(width, blocks.posX[b] + blocks.width[b]);
+    height = qMax(height, blocks.posY[b] + blocks.height[b]);
+  }
+  int pixelSize = 1;
+  while (pixelSize < STATISTICS_LAYER_MAX_PIXEL_SIZE && (alignment & pixelSize) == 0)
+    pixelSize *= 2;
+
+  layer.levels.clear();
+  layer.pixelSize = pixelSize;
+  layer.colMapper = type.colMapper;
+  layer.alphaFactor = type.alphaFactor;
+  layer.scaleValueToBlockSize = type.scaleValueToBlockSize;
+  layer.nrBlocks = blocks.count();
+
+  const int layerWidth = (width + pixelSize - 1) / pixelSize;
+  const int layerHeight = (height + pixelSize - 1) / pixelSize;
+  if (qint64(layerWidth) * layerHeight > STATISTICS_LAYER_MAX_PIXELS)
+  {
+    DEBUG_STAT("statisticHandler::updateValueLayer layer too big (%dx%d)", layerWidth, layerHeight);
+    return false;
+  }
+
+  QImage image(layerWidth, layerHeight, QImage::Format_ARGB32_Premultiplied);
+  image.fill(Qt::transparent);
+  type.colMapper.updateLUT();
+  for (int b = 0; b < blocks.count(); b++)
+  {
+    // Get the right color for the item
+    const int value = blocks.value[b];
+    QRgb rectColor;
+    if (type.scaleValueToBlockSize)
+      rectColor = type.colMapper.getColorRgba(float(value) / (blocks.width[b] * blocks.height[b]));
+    else
+      rectColor = type.colMapper.getColorRgba(value);
+    rectColor = qRgba(qRed(rectColor), qGreen(rectColor), qBlue(rectColor), int(qAlpha(rectColor)*((float)type.alphaFactor / 100.0)));
+    const QRgb pixel = qPremultiply(rectColor);
+    if (qAlpha(pixel) == 0)
+      continue;
+
+    // Only draw the part of the block that is inside of the layer
+    const int x0 = qMax(int(blocks.posX[b]) / pixelSize, 0);
+    const int y0 = qMax(int(blocks.posY[b]) / pixelSize, 0);
+    const int x1 = qMin((blocks.posX[b] + blocks.width[b] + pixelSize - 1) / pixelSize, image.width());
+    const int y1 = qMin((blocks.posY[b] + blocks.height[b] + pixelSize - 1) / pixelSize, image.height());
+    if (x0 >= x1 || y0 >= y1)
+      continue;
+    for (int y = y0; y < y1; y++)
+    {
+      QRgb *line = (QRgb*)image.scanLine(y);
+      if (qAlpha(pixel) == 255)
+        std::fill(line + x0, line + x1, pixel);
+      else
+        // Blocks may overlap. Blend them like fillRect() does.
+        for (int x = x0; x < x1; x++)
+          line[x] = blendSourceOver(line[x], pixel);
+    }
+  }
+
+  layer.levels.append(image);
+  return true;
+}
+
+void statisticHandler::paintValueLayer(QPainter *painter, statisticsData &statsData, StatisticsType &type, double zoomFactor, const QRect &visibleStatArea)
+{
+  if (!updateValueLayer(statsData, type))
+  {
+    // Draw the visible blocks one by one
+    statsData.valueData.updateIndex();
+    const statisticsValueBlocks &blocks = statsData.valueData;
+    type.colMapper.updateLUT();
+    for (int b : blocks.getBlocksInRect(visibleStatArea))
+    {
+      QRect rect = blocks.getRect(b);
+      QRect displayRect = QRect(rect.left()*zoomFactor, rect.top()*zoomFactor, rect.width()*zoomFactor, rect.height()*zoomFactor);
+      QRgb rectColor;
+      if (type.scaleValueToBlockSize)
+        rectColor = type.colMapper.getColorRgba(float(blocks.value[b]) / (rect.width() * rect.height()));
+      else
+        rectColor = type.colMapper.getColorRgba(blocks.value[b]);
+      QColor color = QColor::fromRgba(rectColor);
+      color.setAlpha(color.alpha()*((float)type.alphaFactor / 100.0));
+      painter->fillRect(displayRect, color);
+    }
+    return;
+  }
+  statisticsValueLayer &layer = statsData.valueLayer;
+
+  // If one pixel of the layer is smaller than a pixel on screen, use a smaller level of the layer in which the
+  // blocks were already averaged. So the number of pixels to draw stays about the same as the number of pixels on screen.
+  int level = 0;
+  double layerPixelOnScreen = layer.pixelSize * zoomFactor;
+  while (layerPixelOnScreen * 2 <= 1.0 && level < STATISTICS_LAYER_MAX_LEVEL)
+  {
+    level++;
+    layerPixelOnScreen *= 2;
+  }
+  while (layer.levels.count() <= level)
+  {
+    const QImage &lastLevel = layer.levels.last();
+    if (lastLevel.width() <= 1 && lastLevel.height() <= 1)
+      break;
+    layer.levels.append(lastLevel.scaled(qMax(lastLevel.width() / 2, 1), qMax(lastLevel.height() / 2, 1), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+  }
+  level = qMin(level, layer.levels.count() - 1);
+  const QImage &image = layer.levels[level];
+
+  // Only draw the visible part of the layer
+  const double scaleX = double(layer.levels[0].width()) * layer.pixelSize / image.width();
+  const double scaleY = double(layer.levels[0].height()) * layer.pixelSize / image.height();
+  QRect source(QPoint(int(floor(visibleStatArea.left() / scaleX)), int(floor(visibleStatArea.top() / scaleY))),
+               QPoint(int(ceil(visibleStatArea.right() / scaleX)), int(ceil(visibleStatArea.bottom() / scaleY))));
+  source &= image.rect();
+  if (source.isEmpty())
+    return;
+  QRectF target(source.left() * scaleX * zoomFactor, source.top() * scaleY * zoomFactor, source.width() * scaleX * zoomFactor, source.height() * scaleY * zoomFactor);
+
+  painter->save();
+  painter->setRenderHint(QPainter::SmoothPixmapTransform, layerPixelOnScreen < 1.0);
+  painter->drawImage(target, image, source);
+  painter->restore();
+}
+
 // return raw(!) value of front-most, active statistic item at given position
 // Info is always read from the current buffer. So these values are only valid if a draw event occurred first.
 ValuePairList statisticHandler::getValuesAt(const QPoint &pos)
@@ -434,35 +594,37 @@ ValuePairList statisticHandler::getValuesAt(const QPoint &pos)
 
       // Get all value data entries
       bool foundStats = false;
-      for (const statisticsItem_Value &valueItem : statsCache[typeID].valueData)
+      const statisticsValueBlocks &valueBlocks = statsCache[typeID].valueData;
+      for (int b = 0; b < valueBlocks.count(); b++)
       {
-        QRect rect = QRect(valueItem.pos[0], valueItem.pos[1], valueItem.size[0], valueItem.size[1]);
+        QRect rect = valueBlocks.getRect(b);
         if (rect.contains(pos))
         {
-          int value = valueItem.value;
+          int value = valueBlocks.value[b];
           QString valTxt  = statsTypeList[i].getValueTxt(value);
           if (!statsTypeList[i].valMap.contains(value) && statsTypeList[i].scaleValueToBlockSize)
-            valTxt = QString("%1").arg(float(value) / (valueItem.size[0] * valueItem.size[1]));
+            valTxt = QString("%1").arg(float(value) / (rect.width() * rect.height()));
           valueList.append(ValuePair(aType->typeName, valTxt));
           foundStats = true;
         }
       }
 
-      for (const statisticsItem_Vector &vectorItem : statsCache[typeID].vectorData)
+      const statisticsVectorBlocks &vectorBlocks = statsCache[typeID].vectorData;
+      for (int b = 0; b < vectorBlocks.count(); b++)
       {
-        QRect rect = QRect(vectorItem.pos[0], vectorItem.pos[1], vectorItem.size[0], vectorItem.size[1]);
+        QRect rect = vectorBlocks.getRect(b);
         if (rect.contains(pos))
         {
           float vectorValue1, vectorValue2;
-          if (vectorItem.isLine)
+          if (vectorBlocks.isLine[b])
           {
-           vectorValue1 = (float)(vectorItem.point[1].x() - vectorItem.point[0].x()) / statsTypeList[i].vectorScale;
-           vectorValue2 = (float)(vectorItem.point[1].y() - vectorItem.point[0].y()) / statsTypeList[i].vectorScale;
+           vectorValue1 = (float)(vectorBlocks.x2[b] - vectorBlocks.x1[b]) / statsTypeList[i].vectorScale;
+           vectorValue2 = (float)(vectorBlocks.y2[b] - vectorBlocks.y1[b]) / statsTypeList[i].vectorScale;
           }
           else
           {
-            vectorValue1 = (float)vectorItem.point[0].x() / statsTypeList[i].vectorScale;
-            vectorValue2 = (float)vectorItem.point[0].y() / statsTypeList[i].vectorScale;
+            vectorValue1 = (float)vectorBlocks.x1[b] / statsTypeList[i].vectorScale;
+            vectorValue2 = (float)vectorBlocks.y1[b] / statsTypeList[i].vectorScale;
           }
           valueList.append(ValuePair(QString("%1[x]").arg(aType->typeName), QString::number(vectorValue1)));
           valueList.append(ValuePair(QString("%1[y]").arg(aType->typeName), QString::number(vectorValue2)));
@@ -117,6 +117,13 @@ private:
   // Make sure that nothing is read from the stats cache while it is being changed.
   QMutex statsCacheAccessMutex;
 
+  // The value blocks of each type are drawn into a layer image (statisticsData::valueLayer) once. This is drawn
+  // again only if the statistics or the style of the type changed. paintValueLayer() draws the visible part
+  // of the layer (or of a smaller level of it if the zoom factor is small). If the layer would be too big (small
+  // blocks in a big frame), updateValueLayer() returns false and the visible blocks are drawn one by one.
+  bool updateValueLayer(statisticsData &statsData, StatisticsType &type);
+  void paintValueLayer(QPainter *painter, statisticsData &statsData, StatisticsType &type, double zoomFactor, const QRect &visibleStatArea);
+
   // The list of all statistics that this class can provide (and a backup for updating the list)
   StatisticsTypeList statsTypeList;
   StatisticsTypeList statsTypeListBackup;
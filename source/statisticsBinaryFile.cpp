@@ -0,0 +1,296 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "statisticsBinaryFile.h"
+
+#include <cstring>
+#include <limits>
+#include <QtEndian>
+
+#define STAT_BINARY_MAGIC "YUVSTAT1"
+#define STAT_BINARY_VERSION 1
+#define STAT_BINARY_FILE_HEADER_SIZE 32
+#define STAT_BINARY_OFFSET_ENTRY_SIZE 16
+#define STAT_BINARY_VALUE_RECORD_SIZE 12
+#define STAT_BINARY_VECTOR_RECORD_SIZE 28
+
+statisticsBinaryFile::statisticsBinaryFile()
+{
+  data = nullptr;
+  dataSize = 0;
+  maxPOC = -1;
+  nrTypes = 0;
+  offsetTable = nullptr;
+}
+
+statisticsBinaryFile::~statisticsBinaryFile()
+{
+  close();
+}
+
+bool statisticsBinaryFile::isBinaryStatisticsFile(const QString &fileName)
+{
+  QFile f(fileName);
+  if (!f.open(QIODevice::ReadOnly))
+    return false;
+  return f.read(8) == QByteArray(STAT_BINARY_MAGIC);
+}
+
+bool statisticsBinaryFile::openFile(const QString &fileName)
+{
+  close();
+  errorString.clear();
+
+  file.setFileName(fileName);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    errorString = QString("Error opening the file: ") + file.errorString();
+    return false;
+  }
+  dataSize = file.size();
+  if (dataSize < STAT_BINARY_FILE_HEADER_SIZE)
+  {
+    errorString = "The file is too small for a binary statistics file.";
+    close();
+    return false;
+  }
+  data = file.map(0, dataSize);
+  if (data == nullptr)
+  {
+    errorString = QString("Error mapping the file: ") + file.errorString();
+    close();
+    return false;
+  }
+
+  if (std::memcmp(data, STAT_BINARY_MAGIC, 8) != 0 || qFromLittleEndian<quint32>(data + 8) != STAT_BINARY_VERSION)
+  {
+    errorString = "The file is not a binary statistics file of a supported version.";
+    close();
+    return false;
+  }
+
+  const quint32 headerTextSize = qFromLittleEndian<quint32>(data + 12);
+  const quint32 fileNrTypes = qFromLittleEndian<quint32>(data + 16);
+  const qint32 filePOCMax = qFromLittleEndian<qint32>(data + 20);
+  const qint64 typeTablePos = STAT_BINARY_FILE_HEADER_SIZE + qint64(headerTextSize);
+  const qint64 offsetTablePos = typeTablePos + qint64(fileNrTypes) * 4;
+  // Check every factor of the offset table size against the file size so that the product can not overflow
+  bool headerValid = (filePOCMax >= -1 && fileNrTypes <= quint32(std::numeric_limits<int>::max()) && offsetTablePos <= dataSize);
+  if (headerValid && fileNrTypes > 0)
+    headerValid = (qint64(filePOCMax) + 1 <= (dataSize - offsetTablePos) / STAT_BINARY_OFFSET_ENTRY_SIZE / fileNrTypes);
+  if (!headerValid)
+  {
+    errorString = "The header of the binary statistics file is invalid.";
+    close();
+    return false;
+  }
+
+  headerText = QByteArray((const char*)data + STAT_BINARY_FILE_HEADER_SIZE, headerTextSize);
+  maxPOC = filePOCMax;
+  nrTypes = fileNrTypes;
+  for (int i = 0; i < nrTypes; i++)
+    typeIndex.insert(qFromLittleEndian<qint32>(data + typeTablePos + i * 4), i);
+  offsetTable = data + offsetTablePos;
+  return true;
+}
+
+void statisticsBinaryFile::close()
+{
+  if (data)
+    file.unmap(const_cast<uchar*>(data));
+  data = nullptr;
+  dataSize = 0;
+  file.close();
+  headerText.clear();
+  maxPOC = -1;
+  nrTypes = 0;
+  typeIndex.clear();
+  offsetTable = nullptr;
+}
+
+const uchar *statisticsBinaryFile::getOffsetTableEntry(int poc, int typeID) const
+{
+  if (data == nullptr || poc < 0 || poc > maxPOC || !typeIndex.contains(typeID))
+    return nullptr;
+  return offsetTable + (qint64(poc) * nrTypes + typeIndex.value(typeID)) * STAT_BINARY_OFFSET_ENTRY_SIZE;
+}
+
+bool statisticsBinaryFile::hasStatistics(int poc, int typeID) const
+{
+  const uchar *entry = getOffsetTableEntry(poc, typeID);
+  return entry != nullptr && qFromLittleEndian<quint64>(entry) != 0;
+}
+
+bool statisticsBinaryFile::readStatistics(int poc, int typeID, statisticsData &statsData) const
+{
+  const uchar *entry = getOffsetTableEntry(poc, typeID);
+  if (entry == nullptr)
+    return false;
+  const quint64 offset = qFromLittleEndian<quint64>(entry);
+  const quint32 nrValues = qFromLittleEndian<quint32>(entry + 8);
+  const quint32 nrVectors = qFromLittleEndian<quint32>(entry + 12);
+  // The records are behind the offset table. Offsets into the header or the tables are invalid.
+  const quint64 recordsPos = quint64(offsetTable - data) + quint64(maxPOC + 1) * nrTypes * STAT_BINARY_OFFSET_ENTRY_SIZE;
+  const quint64 recordsSize = quint64(nrValues) * STAT_BINARY_VALUE_RECORD_SIZE + quint64(nrVectors) * STAT_BINARY_VECTOR_RECORD_SIZE;
+  if (offset == 0 || offset < recordsPos || offset > quint64(dataSize) || recordsSize > quint64(dataSize) - offset)
+    return false;
+
+  const uchar *p = data + offset;
+  statsData.reserve(nrValues, nrVectors);
+  for (quint32 i = 0; i < nrValues; i++, p += STAT_BINARY_VALUE_RECORD_SIZE)
+    statsData.addBlockValue(qFromLittleEndian<quint16>(p), qFromLittleEndian<quint16>(p + 2), qFromLittleEndian<quint16>(p + 4), qFromLittleEndian<quint16>(p + 6), qFromLittleEndian<qint32>(p + 8));
+
+  for (quint32 i = 0; i < nrVectors; i++, p += STAT_BINARY_VECTOR_RECORD_SIZE)
+  {
+    const quint16 x = qFromLittleEndian<quint16>(p);
+    const quint16 y = qFromLittleEndian<quint16>(p + 2);
+    const quint16 w = qFromLittleEndian<quint16>(p + 4);
+    const quint16 h = qFromLittleEndian<quint16>(p + 6);
+    if (qFromLittleEndian<quint32>(p + 24) & 1)
+      statsData.addLine(x, y, w, h, qFromLittleEndian<qint32>(p + 8), qFromLittleEndian<qint32>(p + 12), qFromLittleEndian<qint32>(p + 16), qFromLittleEndian<qint32>(p + 20));
+    else
+      statsData.addBlockVector(x, y, w, h, qFromLittleEndian<qint32>(p + 8), qFromLittleEndian<qint32>(p + 12));
+  }
+  return true;
+}
+
+// --------- statisticsBinaryFile::writer -------------------------------------
+
+bool statisticsBinaryFile::writer::start(const QString &fileName, const QByteArray &headerText, const QList<int> &typeIDs, int maxPOC)
+{
+  this->typeIDs = typeIDs;
+  this->maxPOC = maxPOC;
+
+  const qint64 offsetTableSize = (qint64(maxPOC) + 1) * typeIDs.count() * STAT_BINARY_OFFSET_ENTRY_SIZE;
+  if (maxPOC < -1 || offsetTableSize > std::numeric_limits<int>::max())
+  {
+    errorString = "There are too many POCs and statistics types for a binary statistics file.";
+    return false;
+  }
+
+  file.setFileName(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    errorString = QString("Error opening the output file: ") + file.errorString();
+    return false;
+  }
+
+  QByteArray fileHeader(STAT_BINARY_FILE_HEADER_SIZE, 0);
+  uchar *h = (uchar*)fileHeader.data();
+  std::memcpy(h, STAT_BINARY_MAGIC, 8);
+  qToLittleEndian<quint32>(STAT_BINARY_VERSION, h + 8);
+  qToLittleEndian<quint32>(headerText.size(), h + 12);
+  qToLittleEndian<quint32>(typeIDs.count(), h + 16);
+  qToLittleEndian<qint32>(maxPOC, h + 20);
+
+  QByteArray typeTable(typeIDs.count() * 4, 0);
+  for (int i = 0; i < typeIDs.count(); i++)
+    qToLittleEndian<qint32>(typeIDs[i], (uchar*)typeTable.data() + i * 4);
+
+  // The offset table is written by finish(). Until then, reserve the space for it.
+  offsetTablePos = fileHeader.size() + headerText.size() + typeTable.size();
+  offsetTable = QByteArray(int(offsetTableSize), 0);
+
+  if (file.write(fileHeader) != fileHeader.size() || file.write(headerText) != headerText.size() ||
+      file.write(typeTable) != typeTable.size() || file.write(offsetTable) != offsetTable.size())
+  {
+    errorString = QString("Error writing the output file: ") + file.errorString();
+    return false;
+  }
+  return true;
+}
+
+bool statisticsBinaryFile::writer::addFrame(int poc, const QHash<int, statisticsData> &frameStatistics)
+{
+  if (poc < 0 || poc > maxPOC)
+    return false;
+
+  for (int t = 0; t < typeIDs.count(); t++)
+  {
+    if (!frameStatistics.contains(typeIDs[t]))
+      continue;
+    const statisticsData &statsData = frameStatistics[typeIDs[t]];
+    if (statsData.valueData.isEmpty() && statsData.vectorData.isEmpty())
+      continue;
+
+    QByteArray records(statsData.valueData.count() * STAT_BINARY_VALUE_RECORD_SIZE + statsData.vectorData.count() * STAT_BINARY_VECTOR_RECORD_SIZE, 0);
+    uchar *p = (uchar*)records.data();
+    const statisticsValueBlocks &values = statsData.valueData;
+    for (int i = 0; i < values.count(); i++)
+    {
+      qToLittleEndian<quint16>(values.posX[i], p);
+      qToLittleEndian<quint16>(values.posY[i], p + 2);
+      qToLittleEndian<quint16>(values.width[i], p + 4);
+      qToLittleEndian<quint16>(values.height[i], p + 6);
+      qToLittleEndian<qint32>(values.value[i], p + 8);
+      p += STAT_BINARY_VALUE_RECORD_SIZE;
+    }
+    const statisticsVectorBlocks &vectors = statsData.vectorData;
+    for (int i = 0; i < vectors.count(); i++)
+    {
+      qToLittleEndian<quint16>(vectors.posX[i], p);
+      qToLittleEndian<quint16>(vectors.posY[i], p + 2);
+      qToLittleEndian<quint16>(vectors.width[i], p + 4);
+      qToLittleEndian<quint16>(vectors.height[i], p + 6);
+      qToLittleEndian<qint32>(vectors.x1[i], p + 8);
+      qToLittleEndian<qint32>(vectors.y1[i], p + 12);
+      qToLittleEndian<qint32>(vectors.x2[i], p + 16);
+      qToLittleEndian<qint32>(vectors.y2[i], p + 20);
+      qToLittleEndian<quint32>(vectors.isLine[i] ? 1 : 0, p + 24);
+      p += STAT_BINARY_VECTOR_RECORD_SIZE;
+    }
+
+    uchar *entry = (uchar*)offsetTable.data() + (qint64(poc) * typeIDs.count() + t) * STAT_BINARY_OFFSET_ENTRY_SIZE;
+    qToLittleEndian<quint64>(file.pos(), entry);
+    qToLittleEndian<quint32>(statsData.valueData.count(), entry + 8);
+    qToLittleEndian<quint32>(statsData.vectorData.count(), entry + 12);
+
+    if (file.write(records) != records.size())
+    {
+      errorString = QString("Error writing the output file: ") + file.errorString();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool statisticsBinaryFile::writer::finish()
+{
+  if (!file.seek(offsetTablePos) || file.write(offsetTable) != offsetTable.size())
+  {
+    errorString = QString("Error writing the output file: ") + file.errorString();
+    file.close();
+    return false;
+  }
+  file.close();
+  return true;
+}
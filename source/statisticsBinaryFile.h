@@ -0,0 +1,113 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATISTICSBINARYFILE_H
+#define STATISTICSBINARYFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include "statisticsExtensions.h"
+
+/* The binary statistics file format (*.ystat). Reading the statistics of a frame from a CSV file means parsing every
+ * line of text. In the binary format, the blocks of each frame/type are stored as packed records so that they can be
+ * copied into a statisticsData directly. All values are little endian.
+ *
+ *  - File header (32 bytes): magic "YUVSTAT1", version, size of the header text, number of types, max POC, reserved
+ *  - Header text: The header lines of the CSV file (types, colors, seq-specs ...). These are parsed like in a CSV file.
+ *  - Type table: The typeID of each type (int32)
+ *  - Offset table: For each POC (0 to maxPOC) and each type: offset of the records (uint64), number of value records
+ *    (uint32) and number of vector records (uint32). So the position of the data of a POC/type is found in O(1).
+ *  - Records: The value records (x, y, w, h as uint16 and the value as int32) followed by the vector records
+ *    (x, y, w, h as uint16, 4 int32 and uint32 flags (1: the vector is a line)).
+ */
+class statisticsBinaryFile
+{
+public:
+  statisticsBinaryFile();
+  ~statisticsBinaryFile();
+
+  // Is the file a binary statistics file? This only checks the magic at the start of the file.
+  static bool isBinaryStatisticsFile(const QString &fileName);
+  static QString getFileExtension() { return "ystat"; }
+
+  // Open the file and map it into memory. Return false if the file could not be opened or is not valid.
+  bool openFile(const QString &fileName);
+  void close();
+  bool isOpen() const { return data != nullptr; }
+  QString getErrorString() const { return errorString; }
+
+  // The header lines of the original CSV file
+  QByteArray getHeaderText() const { return headerText; }
+  int getMaxPOC() const { return maxPOC; }
+  // Are there any statistics for the given POC/type in the file?
+  bool hasStatistics(int poc, int typeID) const;
+  // Put the statistics of the given POC/type into statsData. Return false if there are none in the file.
+  bool readStatistics(int poc, int typeID, statisticsData &statsData) const;
+
+  // Write a binary statistics file. First call start() with the header and all typeIDs, then add the statistics of all
+  // frames in the order of their POC (every POC at most once) and finally call finish().
+  class writer
+  {
+  public:
+    bool start(const QString &fileName, const QByteArray &headerText, const QList<int> &typeIDs, int maxPOC);
+    bool addFrame(int poc, const QHash<int, statisticsData> &frameStatistics);
+    bool finish();
+    QString getErrorString() const { return errorString; }
+  private:
+    QFile file;
+    QList<int> typeIDs;
+    int maxPOC;
+    qint64 offsetTablePos;
+    QByteArray offsetTable;
+    QString errorString;
+  };
+
+private:
+  // Where is the offset table entry of the POC/type? Return nullptr if the POC/type is not in the file.
+  const uchar *getOffsetTableEntry(int poc, int typeID) const;
+
+  QFile file;
+  const uchar *data;
+  qint64 dataSize;
+
+  QByteArray headerText;
+  int maxPOC;
+  // The index of each typeID in the type table
+  QHash<int, int> typeIndex;
+  int nrTypes;
+  const uchar *offsetTable;
+  QString errorString;
+};
+
+#endif // STATISTICSBINARYFILE_H
@@ -32,9 +32,15 @@
 
 #include "statisticsExtensions.h"
 
+#include <algorithm>
 #include <cmath>
+#include <numeric>
 #include "typedef.h"
 
+// The minimum and maximum number of entries in the lookup table of a gradient or complex colorMapper
+#define COLORMAPPER_LUT_MIN_SIZE 1024
+#define COLORMAPPER_LUT_MAX_SIZE 65536
+
 // All types that are supported by the getColor() function.
 QStringList colorMapper::supportedComplexTypes = QStringList() << "jet" << "heat" << "hsv" << "hot" << "cool" << "spring" << "summer" << "autumn" << "winter" << "gray" << "bone" << "copper" << "pink" << "lines" << "col3_gblr" << "col3_gwr" << "col3_bblr" << "col3_bwr" << "col3_bblg" << "col3_bwg";
 
@@ -305,47 +311,147 @@ QString StatisticsType::getValueTxt(int val)
   return QString("%1").arg(val);
 }
 
+void statisticsBlocks::reserveBlocks(int size)
+{
+  posX.reserve(size);
+  posY.reserve(size);
+  width.reserve(size);
+  height.reserve(size);
+}
+
+void statisticsBlocks::appendBlock(unsigned short x, unsigned short y, unsigned short w, unsigned short h)
+{
+  posX.append(x);
+  posY.append(y);
+  width.append(w);
+  height.append(h);
+}
+
+void statisticsBlocks::updateIndex()
+{
+  const int n = count();
+  if (n == nrBlocksIndexed)
+    return;
+
+  // Get the size of the grid and the size of the biggest block
+  int maxX = 0, maxY = 0;
+  maxBlockWidth = 0;
+  maxBlockHeight = 0;
+  for (int i = 0; i < n; i++)
+  {
+    maxX = qMax(maxX, int(posX[i]));
+    maxY = qMax(maxY, int(posY[i]));
+    maxBlockWidth = qMax(maxBlockWidth, int(width[i]));
+    maxBlockHeight = qMax(maxBlockHeight, int(height[i]));
+  }
+  nrCellsX = maxX / STATISTICS_INDEX_CELL_SIZE + 1;
+  nrCellsY = maxY / STATISTICS_INDEX_CELL_SIZE + 1;
+
+  // Sort the blocks into the cells (counting sort). Within a cell, the blocks stay in their order.
+  cellStart.fill(0, nrCellsX * nrCellsY + 1);
+  for (int i = 0; i < n; i++)
+    cellStart[(posY[i] / STATISTICS_INDEX_CELL_SIZE) * nrCellsX + posX[i] / STATISTICS_INDEX_CELL_SIZE + 1]++;
+  for (int c = 0; c < nrCellsX * nrCellsY; c++)
+    cellStart[c + 1] += cellStart[c];
+  QVector<int> cellFill = cellStart;
+  cellBlocks.resize(n);
+  for (int i = 0; i < n; i++)
+    cellBlocks[cellFill[(posY[i] / STATISTICS_INDEX_CELL_SIZE) * nrCellsX + posX[i] / STATISTICS_INDEX_CELL_SIZE]++] = i;
+
+  nrBlocksIndexed = n;
+}
+
+QVector<int> statisticsBlocks::getBlocksInRect(const QRect &rect) const
+{
+  QVector<int> blocks;
+  if (nrBlocksIndexed == count() && (count() == 0 || rect.isEmpty() || rect.right() < 0 || rect.bottom() < 0))
+    return blocks;
+
+  // A block which starts left of/above the rect can still reach into it
+  const int cellXMin = qMax(rect.left() - maxBlockWidth + 1, 0) / STATISTICS_INDEX_CELL_SIZE;
+  const int cellYMin = qMax(rect.top() - maxBlockHeight + 1, 0) / STATISTICS_INDEX_CELL_SIZE;
+  const int cellXMax = qMin(rect.right() / STATISTICS_INDEX_CELL_SIZE, nrCellsX - 1);
+  const int cellYMax = qMin(rect.bottom() / STATISTICS_INDEX_CELL_SIZE, nrCellsY - 1);
+
+  if (nrBlocksIndexed != count() || (cellXMin == 0 && cellYMin == 0 && cellXMax == nrCellsX - 1 && cellYMax == nrCellsY - 1))
+  {
+    // The index is not up to date or the rect covers all cells. All blocks are returned (no need to collect and sort them).
+    blocks.resize(count());
+    std::iota(blocks.begin(), blocks.end(), 0);
+    return blocks;
+  }
+
+  for (int cy = cellYMin; cy <= cellYMax; cy++)
+    for (int cx = cellXMin; cx <= cellXMax; cx++)
+    {
+      const int c = cy * nrCellsX + cx;
+      for (int j = cellStart[c]; j < cellStart[c + 1]; j++)
+        blocks.append(cellBlocks[j]);
+    }
+
+  // Keep the order in which the blocks were added (this is the order in which they are drawn)
+  std::sort(blocks.begin(), blocks.end());
+  return blocks;
+}
+
+void statisticsValueBlocks::reserve(int size)
+{
+  reserveBlocks(size);
+  value.reserve(size);
+}
+
+void statisticsValueBlocks::append(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int val)
+{
+  appendBlock(x, y, w, h);
+  value.append(val);
+}
+
+void statisticsVectorBlocks::reserve(int size)
+{
+  reserveBlocks(size);
+  x1.reserve(size);
+  y1.reserve(size);
+  x2.reserve(size);
+  y2.reserve(size);
+  isLine.reserve(size);
+}
+
+void statisticsVectorBlocks::append(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int vx1, int vy1, int vx2, int vy2, bool line)
+{
+  appendBlock(x, y, w, h);
+  x1.append(vx1);
+  y1.append(vy1);
+  x2.append(vx2);
+  y2.append(vy2);
+  isLine.append(line);
+}
+
+void statisticsData::reserve(int nrValueBlocks, int nrVectorBlocks)
+{
+  valueData.reserve(valueData.count() + nrValueBlocks);
+  vectorData.reserve(vectorData.count() + nrVectorBlocks);
+}
+
 void statisticsData::addBlockValue(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int val)
 {
-  statisticsItem_Value value;
-  value.pos[0] = x;
-  value.pos[1] = y;
-  value.size[0] = w;
-  value.size[1] = h;
-  value.value = val;
+  valueData.append(x, y, w, h, val);
 
   // Always keep the biggest block size updated.
   unsigned int wh = w*h;
   if (wh > maxBlockSize)
     maxBlockSize = wh;
-
-  valueData.append(value);
 }
 
 void statisticsData::addBlockVector(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int vecX, int vecY)
 {
-  statisticsItem_Vector vec;
-  vec.pos[0] = x;
-  vec.pos[1] = y;
-  vec.size[0] = w;
-  vec.size[1] = h;
-  vec.point[0] = QPoint(vecX,vecY);
-  vec.isLine = false;
-  vectorData.append(vec);
+  vectorData.append(x, y, w, h, vecX, vecY, 0, 0, false);
 }
 
 void statisticsData::addLine(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int x1, int y1, int x2, int y2)
 {
-  statisticsItem_Vector vec;
-  vec.pos[0] = x;
-  vec.pos[1] = y;
-  vec.size[0] = w;
-  vec.size[1] = h;
-  vec.point[0] = QPoint(x1,y1);
-  vec.point[1] = QPoint(x2,y2);
-  vec.isLine = true;
-  vectorData.append(vec);
+  vectorData.append(x, y, w, h, x1, y1, x2, y2, true);
 }
+
 // Setup an invalid (uninitialized color mapper)
 colorMapper::colorMapper()
 {
@@ -353,10 +459,15 @@ colorMapper::colorMapper()
   rangeMax = 0;
   colorMapOther = Qt::black;
   type = none;
+  lutMin = 0;
+  lutStep = 1.0;
+  lutType = none;
+  lutRangeMin = 0;
+  lutRangeMax = 0;
 }
 
 // Setup a color mapper with a gradient
-colorMapper::colorMapper(int min, const QColor &colMin, int max, const QColor &colMax)
+colorMapper::colorMapper(int min, const QColor &colMin, int max, const QColor &colMax) : colorMapper()
 {
   rangeMin = min;
   rangeMax = max;
@@ -366,7 +477,7 @@ colorMapper::colorMapper(int min, const QColor &colMin, int max, const QColor &c
   type = gradient;
 }
 
-colorMapper::colorMapper(const QString &rangeName, int min, int max)
+colorMapper::colorMapper(const QString &rangeName, int min, int max) : colorMapper()
 {
   if (supportedComplexTypes.contains(rangeName))
   {
@@ -384,7 +495,7 @@ colorMapper::colorMapper(const QString &rangeName, int min, int max)
   colorMapOther = Qt::black;
 }
 
-QColor colorMapper::getColor(int value)
+QColor colorMapper::getColor(int value) const
 {
   if (type == map)
   {
@@ -399,7 +510,7 @@ QColor colorMapper::getColor(int value)
   }
 }
 
-QColor colorMapper::getColor(float value)
+QColor colorMapper::getColor(float value) const
 {
   if (type == map)
     // Round and use the integer value to get the value from the map
@@ -645,6 +756,92 @@ QColor colorMapper::getColor(float value)
   return QColor();
 }
 
+void colorMapper::updateLUT()
+{
+  if (!lut.isEmpty() && lutType == type && lutRangeMin == rangeMin && lutRangeMax == rangeMax && lutMinColor == minColor &&
+      lutMaxColor == maxColor && lutColorMap == colorMap && lutColorMapOther == colorMapOther && lutComplexType == complexType)
+    // The table is up to date
+    return;
+
+  lut.clear();
+  lutMin = 0;
+  lutStep = 1.0;
+  if (type == map && !colorMap.isEmpty())
+  {
+    // One entry for every value from the first to the last value in the map. Other values get colorMapOther.
+    const qint64 size = qint64(colorMap.lastKey()) - colorMap.firstKey() + 1;
+    if (size <= COLORMAPPER_LUT_MAX_SIZE)
+    {
+      lutMin = colorMap.firstKey();
+      lut.fill(colorMapOther.rgba(), int(size));
+      for (auto it = colorMap.constBegin(); it != colorMap.constEnd(); it++)
+        lut[it.key() - lutMin] = it.value().rgba();
+    }
+  }
+  else if (type == gradient || type == complex)
+  {
+    // One entry for every integer in the range. Small ranges (e.g. 0 to 1) get more entries so that the interpolation
+    // of non-integer values is still exact enough. If the range is too big, fewer entries are used.
+    const qint64 rangeSize = qint64(rangeMax) - rangeMin;
+    int size = 1;
+    if (rangeSize > 0)
+      size = int(qBound(qint64(COLORMAPPER_LUT_MIN_SIZE), rangeSize + 1, qint64(COLORMAPPER_LUT_MAX_SIZE)));
+    lutMin = rangeMin;
+    lutStep = (size > 1) ? double(rangeSize) / (size - 1) : 1.0;
+    lut.resize(size);
+    for (int i = 0; i < size; i++)
+      lut[i] = getColor(float(rangeMin + i * lutStep)).rgba();
+  }
+
+  lutType = type;
+  lutRangeMin = rangeMin;
+  lutRangeMax = rangeMax;
+  lutMinColor = minColor;
+  lutMaxColor = maxColor;
+  lutColorMap = colorMap;
+  lutColorMapOther = colorMapOther;
+  lutComplexType = complexType;
+}
+
+QRgb colorMapper::getColorRgba(int value) const
+{
+  if (lut.isEmpty())
+    return getColor(value).rgba();
+
+  if (type == map)
+  {
+    const qint64 idx = qint64(value) - lutMin;
+    return (idx < 0 || idx >= lut.count()) ? colorMapOther.rgba() : lut[int(idx)];
+  }
+  if (lutStep == 1.0)
+    // Every entry is exactly one integer
+    return lut[qBound(0, int(qint64(value) - lutMin), lut.count() - 1)];
+  return getColorRgba(float(value));
+}
+
+QRgb colorMapper::getColorRgba(float value) const
+{
+  if (lut.isEmpty())
+    return getColor(value).rgba();
+
+  if (type == map)
+    // Round and use the integer value to get the value from the map
+    return getColorRgba(int(value+0.5));
+
+  // Interpolate between the two closest entries
+  const double pos = qBound(0.0, (value - lutMin) / lutStep, double(lut.count() - 1));
+  const int idx = int(pos);
+  if (idx >= lut.count() - 1)
+    return lut.last();
+  const double f = pos - idx;
+  const QRgb c0 = lut[idx];
+  const QRgb c1 = lut[idx + 1];
+  return qRgba(int(qRed(c0)   + f * (qRed(c1)   - qRed(c0))   + 0.5),
+               int(qGreen(c0) + f * (qGreen(c1) - qGreen(c0)) + 0.5),
+               int(qBlue(c0)  + f * (qBlue(c1)  - qBlue(c0))  + 0.5),
+               int(qAlpha(c0) + f * (qAlpha(c1) - qAlpha(c0)) + 0.5));
+}
+
 int colorMapper::getMinVal()
 {
   if (type == gradient || type == complex)
@@ -34,11 +34,17 @@
 #define STATISTICSEXTENSIONS_H
 
 #include <QColor>
+#include <QImage>
 #include <QMap>
 #include <QPen>
+#include <QRect>
+#include <QVector>
 
 class QDomElementYUView;
 
+// The size of the cells of the grid index of the statistics blocks (the size of a CTU in HEVC)
+#define STATISTICS_INDEX_CELL_SIZE 64
+
 /* This class knows how to map values to color.
  * There are 3 types of mapping:
  * 1: gradient - We use a min and max value (rangeMin, rangeMax) and two colors (minColor, maxColor).
@@ -56,8 +62,14 @@ public:
   colorMapper(int min, const QColor &colMin, int max, const QColor &colMax);
   colorMapper(const QString &rangeName, int min, int max);
 
-  QColor getColor(int value);
-  QColor getColor(float value);
+  QColor getColor(int value) const;
+  QColor getColor(float value) const;
+  // For getting the colors of many values (e.g. of all blocks of a frame), a lookup table can be used. Call
+  // updateLUT() before the loop (the table is only built again if the mapper changed) and then getColorRgba().
+  // If the range is too big, the table has fewer entries and the colors in between are interpolated.
+  void updateLUT();
+  QRgb getColorRgba(int value) const;
+  QRgb getColorRgba(float value) const;
   int getMinVal();
   int getMaxVal();
 
@@ -84,6 +96,20 @@ public:
 
   mappingType type;
   static QStringList supportedComplexTypes;
+
+private:
+  // The lookup table with the colors of the values lutMin, lutMin + lutStep, lutMin + 2*lutStep ...
+  // (for the map type, all values from lutMin to the last value in the map).
+  QVector<QRgb> lut;
+  int lutMin;
+  double lutStep;
+  // The settings that the lookup table was built for
+  mappingType lutType;
+  int lutRangeMin, lutRangeMax;
+  QColor lutMinColor, lutMaxColor;
+  QMap<int,QColor> lutColorMap;
+  QColor lutColorMapOther;
+  QString lutComplexType;
 };
 
 /* This class defines a type of statistic to render. Each statistics type entry defines the name and and ID of a statistic. It also defines
@@ -175,25 +201,76 @@ private:
   initialState init;
 };
 
-struct statisticsItem_Value
+// The positions of the blocks of a statisticsData. The blocks are kept as a structure of arrays: Block i is at
+// index i of every array. The position and size of each block are limited to 65535.
+// For drawing only a part of the frame, there is a grid index (cells of STATISTICS_INDEX_CELL_SIZE pixels). Each block
+// is listed in the cell that contains its top left corner. The index is built by updateIndex() and not updated when
+// blocks are added.
+struct statisticsBlocks
 {
-  // The position and size of the item. (max 65535)
-  unsigned short pos[2];
-  unsigned short size[2];
+  statisticsBlocks() : nrCellsX(0), nrCellsY(0), maxBlockWidth(0), maxBlockHeight(0), nrBlocksIndexed(0) {}
+
+  QVector<unsigned short> posX, posY;
+  QVector<unsigned short> width, height;
 
+  int count() const { return posX.count(); }
+  bool isEmpty() const { return posX.isEmpty(); }
+  QRect getRect(int i) const { return QRect(posX[i], posY[i], width[i], height[i]); }
+
+  // Build the grid index if blocks were added since it was last built
+  void updateIndex();
+  // Get the indices of all blocks which may intersect the given rect (in ascending order). If the index is
+  // not up to date, all blocks are returned.
+  QVector<int> getBlocksInRect(const QRect &rect) const;
+
+protected:
+  void reserveBlocks(int size);
+  void appendBlock(unsigned short x, unsigned short y, unsigned short w, unsigned short h);
+
+private:
+  int nrCellsX, nrCellsY;
+  int maxBlockWidth, maxBlockHeight;
+  int nrBlocksIndexed;
+  // The blocks of cell c are cellBlocks[cellStart[c]] to cellBlocks[cellStart[c+1]-1]
+  QVector<int> cellStart;
+  QVector<int> cellBlocks;
+};
+
+// The value blocks of a statisticsData
+struct statisticsValueBlocks : statisticsBlocks
+{
   // The actual value
-  int value;
+  QVector<int> value;
+
+  void reserve(int size);
+  void append(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int val);
 };
 
-struct statisticsItem_Vector
+// The vector blocks of a statisticsData
+struct statisticsVectorBlocks : statisticsBlocks
 {
-  // The position and size of the item. (max 65535)
-  unsigned short pos[2];
-  unsigned short size[2];
+  // The vector (x1, y1). If the vector is a line, it is specified by two points (x1, y1) and (x2, y2) relative
+  // to the block. Otherwise x2 and y2 are 0.
+  QVector<int> x1, y1, x2, y2;
+  QVector<bool> isLine;
 
-  bool isLine; // the vector is specified by two points
-  // The actual vector value
-  QPoint point[2];
+  void reserve(int size);
+  void append(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int vx1, int vy1, int vx2, int vy2, bool line);
+};
+
+// The value blocks of a statisticsData drawn into images (see statisticHandler::paintStatistics()). In level 0, one
+// pixel corresponds to pixelSize x pixelSize pixels of the statistics. Each further level has half the width and
+// height of the previous level (the blocks are averaged).
+struct statisticsValueLayer
+{
+  statisticsValueLayer() : pixelSize(1), alphaFactor(-1), scaleValueToBlockSize(false), nrBlocks(-1) {}
+  QList<QImage> levels;
+  int pixelSize;
+  // The layer was drawn with these settings. If one of them changes, it has to be drawn again.
+  colorMapper colMapper;
+  int alphaFactor;
+  bool scaleValueToBlockSize;
+  int nrBlocks;
 };
 
 // A collection of statistics data (value and vector) for a certain context (for example for a certain type and a certain POC).
@@ -204,8 +281,12 @@ public:
   void addBlockValue(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int val);
   void addBlockVector(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int vecX, int vecY);
   void addLine(unsigned short x, unsigned short y, unsigned short w, unsigned short h, int x1, int y1, int x2, int y2);
-  QList<statisticsItem_Value> valueData;
-  QList<statisticsItem_Vector> vectorData;
+  // If the number of blocks is known before adding them, reserve the memory first
+  void reserve(int nrValueBlocks, int nrVectorBlocks);
+  statisticsValueBlocks valueData;
+  statisticsVectorBlocks vectorData;
+  // The value blocks drawn into images. This is created by the statisticHandler when the statistics are drawn.
+  statisticsValueLayer valueLayer;
 
   // What is the size (area) of the biggest block)? This is needed for scaling the blocks according to their size.
   unsigned int maxBlockSize;
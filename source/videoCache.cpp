@@ -33,6 +33,10 @@
 #include "videoCache.h"
 
 #include <algorithm>
+#include <cstdlib>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QPainter>
 #include <QScrollArea>
 #include <QSettings>
@@ -59,9 +63,37 @@
 #define DEBUG_CACHING_DETAIL(fmt,...) ((void)0)
 #endif
 
+// The weights used to decide which cached frames are removed first (see videoCache::sortCacheDeQueue())
+#define CACHE_EVICTION_PRIORITY_WEIGHT   3.0    // The last frames in the playlist order are worth up to 4 times as much
+#define CACHE_EVICTION_PROXIMITY_WEIGHT  4.0    // Frames at the current position are worth up to 5 times as much ...
+#define CACHE_EVICTION_DISTANCE_SCALE    25     // ... and half of the extra value is left 25 frames away
+#define CACHE_EVICTION_RECENCY_WEIGHT    2.0    // Frames that were just drawn are worth up to 3 times as much ...
+#define CACHE_EVICTION_RECENCY_SCALE_MS  10000  // ... and half of the extra value is left after 10 seconds
+
+// While an interactive load is running, a caching worker waits at most this long before it caches the next frame
+#define CACHING_INTERACTIVE_MAX_WAIT_MS 50
+
+// Prefetching of the selected item (see videoCache::getPrefetchRanges())
+#define CACHE_PREFETCH_LEAD_MS          500  // While playing, start caching the frames that are shown in 0.5 seconds
+#define CACHE_PREFETCH_BACKWARD_FRAMES  64   // When moving backwards, first cache this many frames before the current frame ...
+#define CACHE_PREFETCH_BACKWARD_BLOCK   16   // ... in blocks of 16 frames (each block in forward order)
+#define CACHE_PREFETCH_CHECK_FRAMES     16   // After a jump, only update the queue if one of the next 16 frames is not cached
+#define CACHE_PREFETCH_JUMP_DELAY_MS    50   // Wait for the user to stop jumping (e.g. dragging the slider)
+
+// Is the frame in one of the ranges?
+static bool rangesContain(const QList<indexRange> &ranges, int frameIdx)
+{
+  for (const indexRange &r : ranges)
+    if (frameIdx >= r.first && frameIdx <= r.second)
+      return true;
+  return false;
+}
+
 videoCache::cacheJob::cacheJob(playlistItem *item, indexRange range) :
   plItem(item),
-  frameRange(range)
+  frameRange(range),
+  frameSize(item->getCachingFrameSize()),
+  rangeStarts(item->getCachingRangeStarts())
 {
 }
 
@@ -131,7 +163,7 @@ void videoCacheStatusWidget::updateStatus(PlaylistTreeWidget *playlist, unsigned
   for (int i = 0; i < allItems.count(); i++)
   {
     playlistItem *item = allItems.at(i);
-    int nrFrames = item->getCachedFrames().count();
+    int nrFrames = item->getNumberCachedFrames();
     qint64 frameSize = item->getCachingFrameSize();
     qint64 itemCacheSize = nrFrames * frameSize;
     DEBUG_CACHING_DETAIL("videoCacheStatusWidget::updateStatus Item %d frames %d * size %d = %d", i, nrFrames, frameSize, itemCacheSize);
@@ -153,11 +185,16 @@ class loadingWorker : public QObject
 {
   Q_OBJECT
 public:
-  loadingWorker(QObject *parent) : QObject(parent) { currentCacheItem = nullptr; working = false; id = id_counter++; }
+  loadingWorker(videoCache *cache) : QObject(nullptr), cache(cache) { currentCacheItem = nullptr; working = false; id = id_counter++; }
   playlistItem *getCacheItem() { return currentCacheItem; }
-  void setJob(playlistItem *item, int frame) { currentCacheItem = item; currentFrame = frame; }
+  // Set the job. For caching, a range of frames (up to and including lastFrame) can be given.
+  void setJob(playlistItem *item, int frame, int lastFrame=-1) { currentCacheItem = item; currentFrame = frame; lastCacheFrame = qMax(frame, lastFrame); interruptRequested = 0; }
+  void clearJob() { currentCacheItem = nullptr; }
   void setWorking(bool state) { working = state; }
   bool isWorking() { return working; }
+  // Stop caching a range of frames after the current frame
+  void interruptCaching() { interruptRequested = 1; }
+  bool isInterruptRequested() { return interruptRequested.load(); }
   QString getStatus() { return QString("T%1: %2\n").arg(id).arg(working ? QString::number(currentFrame) : QString("-")); }
   // Process the job in the thread that this worker was moved to. This function can be directly
   // called from the main thread. It will still process the call in the separate thread.
@@ -165,12 +202,17 @@ public:
   void processLoadingJob(bool playing, bool loadRawData) { QMetaObject::invokeMethod(this, "processLoadingJobInternal", Q_ARG(bool, playing), Q_ARG(bool, loadRawData)); }
 signals:
   void loadingFinished();
+  // A caching job (a range of frames) is done. The worker may already work on the next job.
+  void cachingJobDone();
 private slots:
   void processCacheJobInternal();
   void processLoadingJobInternal(bool playing, bool loadRawData);
 private:
+  videoCache *cache;
   playlistItem *currentCacheItem;
   int currentFrame;
+  int lastCacheFrame;
+  QAtomicInt interruptRequested;
   bool working;
   int id;   // A static ID of the thread. Only used in getStatus().
   static int id_counter;
@@ -182,18 +224,22 @@ void loadingWorker::processCacheJobInternal()
 {
   Q_ASSERT_X(currentCacheItem != nullptr && currentFrame >= 0, "processCacheJobInternal", "Invalid Job");
 
-  // Just cache the frame that was given to us.
+  // Cache the frame (or the range of frames) that was given to us. When done, get the next job from the cache
+  // queue directly. We only return to the main thread if there is nothing more to do for this worker.
   // This is performed in the thread that this worker is currently placed in.
-  currentCacheItem->cacheFrame(currentFrame);
-
-  // After caching, the frame should be in the cache.
-  QList<int> frames = currentCacheItem->getCachedFrames();
-
-  //DEBUG: This can actually happen if we change the resolution and the frame we just loaded to the cache was already
-  // cleared from the cache again.
-  //Q_ASSERT_X(frames.contains(currentFrame), "caching frame", "The frame we just cached is not in the list of cached frames.");
+  do
+  {
+    while (true)
+    {
+      cache->waitForInteractiveLoading();
+      currentCacheItem->cacheFrame(currentFrame);
+      if (currentFrame == lastCacheFrame || interruptRequested.load())
+        break;
+      currentFrame++;
+    }
+    emit cachingJobDone();
+  } while (cache->takeNextCacheJob(this, true));
 
-  currentCacheItem = nullptr;
   emit loadingFinished();
 }
 
@@ -212,10 +258,10 @@ class videoCache::loadingThread : public QThread
 {
   Q_OBJECT
 public:
-  loadingThread(QObject *parent) : QThread(parent)
+  loadingThread(videoCache *parent) : QThread(parent)
   {
     // Create a new worker and move it to this thread
-    threadWorker.reset(new loadingWorker(nullptr));
+    threadWorker.reset(new loadingWorker(parent));
     threadWorker->moveToThread(this);
     quitting = false;
   }
@@ -253,6 +299,9 @@ videoCache::videoCache(PlaylistTreeWidget *playlistTreeWidget, PlaybackControlle
   deleteNrThreads = 0;
   watchingItem = nullptr;
   workerState = workerIdle;
+  cacheLevelCurrent = 0;
+  cachingThreadLimit = -1;
+  nrCachingWorkersBusy = 0;
 
   // Create the interactive threads
   for (int i=0; i<2; i++)
@@ -274,6 +323,10 @@ videoCache::videoCache(PlaylistTreeWidget *playlistTreeWidget, PlaybackControlle
   connect(playlist, &PlaylistTreeWidget::signalItemClearedCache, this, &videoCache::playlistChanged);
   connect(playback, &PlaybackController::waitForItemCaching, this, &videoCache::watchItemForCachingFinished);
   connect(playback, &PlaybackController::signalPlaybackStarting, this, &videoCache::updateCacheQueue);
+  connect(playback, &PlaybackController::signalFrameJump, this, &videoCache::currentFrameJumped);
+  prefetchTimer.setSingleShot(true);
+  prefetchTimer.setInterval(CACHE_PREFETCH_JUMP_DELAY_MS);
+  connect(&prefetchTimer, &QTimer::timeout, this, &videoCache::updatePrefetch);
   connect(&statusUpdateTimer, &QTimer::timeout, this, [=]{ updateCacheStatus(); });
 }
 
@@ -281,7 +334,8 @@ videoCache::~videoCache()
 {
   DEBUG_CACHING("videoCache::~videoCache Terminate all workers and threads");
 
-  // Tell all threads to quit
+  // Tell all threads to quit. The caching workers should not take another job.
+  interruptCachingWorkers();
   for (loadingThread *t : cachingThreadList)
     t->quitWhenDone();
   interactiveThread[0]->quitWhenDone();
@@ -322,6 +376,7 @@ void videoCache::startWorkerThreads(int nrThreads)
 
     // Connect the signals/slots to communicate with the cacheWorker.
     connect(newThread->worker(), &loadingWorker::loadingFinished, this, &videoCache::threadCachingFinished);
+    connect(newThread->worker(), &loadingWorker::cachingJobDone, this, &videoCache::threadCachingJobDone);
 
     DEBUG_CACHING("videoCache::startWorkerThreads Started thread %p with worker %p", newThread, newWorker);
 
@@ -355,6 +410,7 @@ void videoCache::updateSettings()
     nrThreadsPlayback = settings.value("PlaybackCachingThreadLimit", 1).toInt();
   else
     nrThreadsPlayback = 0;
+  updateCachingThreadLimit();
 
   if (targetNrThreads > cachingThreadList.count())
     // Create new threads
@@ -381,8 +437,10 @@ void videoCache::updateSettings()
     if (nrThreadsToRemove > 0)
     {
       // We need to remove more threads but the workers in these threads are still running. Do this when the workers finish.
+      // The workers would keep taking new jobs so interrupt them. The ones that are not deleted get a new job when they return.
       DEBUG_CACHING("videoCache::updateSettings Deleting %d threads later", nrThreadsToRemove);
       deleteNrThreads = nrThreadsToRemove;
+      interruptCachingWorkers();
     }
   }
 
@@ -408,6 +466,7 @@ void videoCache::loadFrame(playlistItem * item, int frameIndex, int loadingSlot)
     bool loadRawData = splitView->showRawData() && !playback->playing();
     interactiveThread[loadingSlot]->worker()->setJob(item, frameIndex);
     interactiveThread[loadingSlot]->worker()->setWorking(true);
+    nrInteractiveLoadsRunning.ref();
     interactiveThread[loadingSlot]->worker()->processLoadingJob(playback->playing(), loadRawData);
     DEBUG_CACHING_DETAIL("videoCache::loadFrame %d started - slot %d", frameIndex, loadingSlot);
 
@@ -437,8 +496,14 @@ void videoCache::interactiveLoaderFinished()
     interactiveItemQueued_Idx[threadID] = -1;
   }
   else
+  {
     // No scheduled job waiting
     interactiveThread[threadID]->worker()->setWorking(false);
+    QMutexLocker locker(&interactiveLoadingMutex);
+    if (!nrInteractiveLoadsRunning.deref())
+      // Let the caching workers continue
+      interactiveLoadingDone.wakeAll();
+  }
 
   updateCachingInfoLabel();
 }
@@ -450,6 +515,7 @@ void videoCache::playlistChanged()
   {
     // First the worker has to stop. Request a stop and an update of the queue.
     workerState = workerIntReqRestart;
+    interruptCachingWorkers();
     DEBUG_CACHING("videoCache::playlistChanged new state %d (workerIntReqRestart)", workerState);
     return;
   }
@@ -478,9 +544,16 @@ void videoCache::updateCacheQueue()
   // Now calculate the new list of frames to cache and run the cacher
   DEBUG_CACHING("videoCache::updateCacheQueue");
 
+  // The caching workers may still be running (e.g. if playback starts). They must not take jobs while we rebuild the queues.
+  // Frames that the workers marked for removal must be gone before we count the frames in the cache.
+  updateCachingThreadLimit();
+  removeEvictedFrames();
+  QMutexLocker locker(&cacheQueueMutex);
+
   // Firstly clear the old cache queues
   cacheQueue.clear();
   cacheDeQueue.clear();
+  cachingFrameSizes.clear();
 
   // Get all items from the playlist. There are two lists. For the caching status (how full is the cache) we have to consider
   // all items in the playlist. However, we only cache top level items and no child items.
@@ -529,7 +602,9 @@ void videoCache::updateCacheQueue()
   for (playlistItem *item : allItems)
   {
     qint64 cachingFrameSize = item->getCachingFrameSize();
-    cacheLevel += item->getCachedFrames().count() * cachingFrameSize;
+    cacheLevel += item->getNumberCachedFrames() * cachingFrameSize;
+    // The caching workers need the frame size when they remove frames of the item from the cache
+    cachingFrameSizes.insert(item, item->getCachingFrameSize());
   }
   if (cacheLevel > cacheLevelMax)
   {
@@ -567,7 +642,7 @@ void videoCache::updateCacheQueue()
   indexRange range = selection[0]->getFrameIndexRange(); // These are the frames that we want to cache
   qint64 cachingFrameSize = selection[0]->getCachingFrameSize();
   qint64 itemSpaceNeeded = (range.second - range.first + 1) * cachingFrameSize;
-  qint64 alreadyCached = selection[0]->getCachedFrames().count() * cachingFrameSize;
+  qint64 alreadyCached = selection[0]->getNumberCachedFrames() * cachingFrameSize;
   qint64 additionalItemSpaceNeeded = itemSpaceNeeded - alreadyCached;
 
   if (play)
@@ -594,7 +669,11 @@ void videoCache::updateCacheQueue()
           if (newCacheLevel + itemCacheSize <= cacheLevelMax)
           {
             // All frames of the item fit and there is even more space. We remain in "adding" mode.
-            enqueueCacheJob(allItems[i], itemRange);
+            // The current item is cached starting at the current position.
+            if (i == itemPos)
+              enqueueCacheJobsPrefetch(allItems[i], itemRange, -1, true);
+            else
+              enqueueCacheJob(allItems[i], itemRange);
             newCacheLevel += itemCacheSize;
           }
           else
@@ -603,14 +682,20 @@ void videoCache::updateCacheQueue()
             qint64 availableSpace = cacheLevelMax - newCacheLevel;
             qint64 nrFramesCachable = availableSpace / allItems[i]->getCachingFrameSize() + 1;
 
-            // These frames should be added...
-            indexRange addFrames = indexRange(itemRange.first, itemRange.first + nrFramesCachable - 1);
-            enqueueCacheJob(allItems[i], addFrames);
+            // These frames should be added (the current item starting at the current position) ...
+            QList<indexRange> addRanges;
+            if (i == itemPos)
+              addRanges = enqueueCacheJobsPrefetch(allItems[i], itemRange, nrFramesCachable, true);
+            else
+            {
+              addRanges.append(indexRange(itemRange.first, itemRange.first + nrFramesCachable - 1));
+              enqueueCacheJob(allItems[i], addRanges.first());
+            }
             newCacheLevel += nrFramesCachable * allItems[i]->getCachingFrameSize();
             // ... and the rest should be removed (if they are cached)
             QList<int> cachedFrames = allItems[i]->getCachedFrames();
             for (int f : cachedFrames)
-              if (f < addFrames.first || f > addFrames.second)
+              if (!rangesContain(addRanges, f))
                 cacheDeQueue.enqueue(plItemFrame(allItems[i], f));
 
             // The cache is now full. We switch to "deleting" mode.
@@ -653,11 +738,14 @@ void videoCache::updateCacheQueue()
         }
       }
 
-      // Adjust the range so that only the number of frames are cached that will fit
+      // Only cache as many frames as will fit, starting at the current position. The other cached frames
+      // of this item can be removed.
       qint64 nrFramesCachable = cacheLevelMax / selection[0]->getCachingFrameSize();
-      range.second = range.first + nrFramesCachable - 1;
-
-      enqueueCacheJob(selection[0], range);
+      QList<indexRange> addRanges = enqueueCacheJobsPrefetch(selection[0], range, nrFramesCachable, false);
+      QList<int> cachedFrames = selection[0]->getCachedFrames();
+      for (int f : cachedFrames)
+        if (!rangesContain(addRanges, f))
+          cacheDeQueue.enqueue(plItemFrame(selection[0], f));
     }
     else if (selection[0]->isCachable() && additionalItemSpaceNeeded > (cacheLevelMax - cacheLevel) && additionalItemSpaceNeeded > 0)
     {
@@ -665,96 +753,34 @@ void videoCache::updateCacheQueue()
       // There is currently not enough space in the cache to cache all remaining frames but in general the cache can hold all frames.
       // Delete frames from the cache until it fits.
 
-      // We go through all other items and get the frames that we will delete.
+      // Mark the cached frames of all other items as "can be removed if required". Frames are only removed when space is
+      // needed and sortCacheDeQueue() decides which ones go first. The item order is used as one weight for this:
       // We start with the item before the one before the currently selected one and go back through the list,
       // wrap around and keep going until we are at the current selected item. Then (as the last resort) we
       // go to the item before the currently selected one.
-      int i = itemPos - 1;
-      // Go back in the list to the previous item that is indexed
-      while(true)
-      {
-        if (i < 0)
-          i = allItems.count() - 1;
-        if (allItems[i]->isIndexedByFrame())
-          break;
-        i--;
-      }
-      // Go back one item further to the one before the one before the currently selected one.
-      i--;
-      while(true)
+      QList<playlistItem*> removeOrder;
+      playlistItem *previousItem = nullptr;
+      for (int j = 1; j < allItems.count(); j++)
       {
-        if (i < 0)
-          i = allItems.count() - 1;
-        if (allItems[i]->isIndexedByFrame())
-          break;
-        i--;
+        playlistItem *item = allItems[(itemPos - j + allItems.count()) % allItems.count()];
+        if (previousItem == nullptr && item->isIndexedByFrame())
+          previousItem = item;
+        else
+          removeOrder.append(item);
       }
+      if (previousItem)
+        removeOrder.append(previousItem);
 
-      // Get the cache level without the current item (frames from the current item do not really occupy space in the cache. We want to cache them anyways)
-      qint64 cacheLevelWithoutCurrent = cacheLevel - selection[0]->getCachedFrames().count() * qint64(selection[0]->getCachingFrameSize());
-      while ((itemSpaceNeeded + cacheLevelWithoutCurrent) > cacheLevelMax)
+      for (playlistItem *item : removeOrder)
       {
-        if (i == itemPos)
-          // We went through the whole list and arrived back at the beginning.
-          // If playback is running, we go to the previous item at last.
-          i--;
-        if (i < 0)
-        {
-          // There is no previous item or the previous item is the first one in the list
-          i = allItems.count() - 1;
-        }
-        if (allItems[i]->getCachedFrames().count() == 0)
-        {
-          i--;
-          continue;  // Nothing to delete for this item
-        }
-
-        // Which frames are cached for the item at position i?
-        QList<int> cachedFrames = allItems[i]->getCachedFrames();
-        qint64 cachedFramesSize = cachedFrames.count() * qint64(allItems[i]->getCachingFrameSize());
-
-        if (additionalItemSpaceNeeded < cachedFramesSize)
-        {
-          // If we delete all frames from item i, there is more than enough space. So we only delete as many frames as needed.
-          qint64 nrFrames = additionalItemSpaceNeeded / allItems[i]->getCachingFrameSize() + 1;
-
-          // Delete nrFrames frames from the back
-          for (int f = cachedFrames.count() - 1; f >= 0 && nrFrames > 0 ; f--)
-          {
-            cacheDeQueue.enqueue(plItemFrame(allItems[i], cachedFrames[f]));
-            cacheLevelWithoutCurrent -= allItems[i]->getCachingFrameSize();
-            if ((cacheLevelWithoutCurrent + itemSpaceNeeded) <= cacheLevelMax)
-              // Now there is enough space
-              break;
-          }
-        }
-        else
-        {
-          // Deleting all frames from this item will not be enough.
-          // Mark all frames of this item as "can be removed if required"
-          QList<int> cachedFrames = allItems[i]->getCachedFrames();
-          for (int f : cachedFrames)
-          {
-            cacheDeQueue.enqueue(plItemFrame(allItems[i], f));
-          }
-          cacheLevelWithoutCurrent -= cachedFramesSize;
-        }
-
-        if (i == itemPos-1)
-        {
-          // We went through all items and tried to delete frames but there is still not enough space.
-          // That is not possible because we determined that the curretn item should fit if we just delete enough frames.
-          DEBUG_CACHING("videoCache::updateCacheQueue ERROR! Deleting loop processed all frames but still not enough space in the cache.");
-          break;
-        }
-
-        // Go to the next (previous) item
-        i--;
+        QList<int> cachedFrames = item->getCachedFrames();
+        for (int f : cachedFrames)
+          cacheDeQueue.enqueue(plItemFrame(item, f));
       }
 
-      // Enqueue the job. This is the only job.
+      // Enqueue the job (starting at the current position). This is the only job.
       // We will not delete any frames from any other items to cache frames from other items.
-      enqueueCacheJob(selection[0], range);
+      enqueueCacheJobsPrefetch(selection[0], range, -1, false);
     }
     else
     {
@@ -764,7 +790,7 @@ void videoCache::updateCacheQueue()
         // All frames from the current item will fit and there is probably even space for more items.
         // In case of playback, we will continue with the next items and delete all frames that were already
         // played out. Otherwise, we don't delete any frames from the cache but we will cache as many items as possible.
-        enqueueCacheJob(selection[0], range);
+        enqueueCacheJobsPrefetch(selection[0], range, -1, false);
         cacheLevel = cacheLevel + additionalItemSpaceNeeded;
       }
 
@@ -795,7 +821,7 @@ void videoCache::updateCacheQueue()
         DEBUG_CACHING("videoCache::updateCacheQueue Attempt caching of next item %s.", allItems[i]->getName().toLatin1().data());
         // How much space is there in the cache (excluding what is cached from the current item)?
         // Get the cache level without the current item (frames from the current item do not really occupy space in the cache. We want to cache them anyways)
-        qint64 cacheLevelWithoutCurrent = cacheLevel - allItems[i]->getCachedFrames().count() * qint64(allItems[i]->getCachingFrameSize());
+        qint64 cacheLevelWithoutCurrent = cacheLevel - allItems[i]->getNumberCachedFrames() * qint64(allItems[i]->getCachingFrameSize());
         // How much space do we need to cache the entire item?
         range = allItems[i]->getFrameIndexRange();
         qint64 itemCacheSize = (range.second - range.first + 1) * qint64(allItems[i]->getCachingFrameSize());
@@ -827,6 +853,8 @@ void videoCache::updateCacheQueue()
     }
   }
 
+  sortCacheDeQueue(selection[0], play);
+
 #if CACHING_DEBUG_OUTPUT && !NDEBUG
   if (!cacheQueue.isEmpty())
   {
@@ -863,17 +891,145 @@ void videoCache::updateCacheQueue()
 #endif
 }
 
+void videoCache::sortCacheDeQueue(playlistItem *currentItem, bool playing)
+{
+  if (cacheDeQueue.count() < 2)
+    return;
+
+  // Every frame gets a value that describes how much we lose if it is removed. The frames with the lowest value are removed first.
+  // - The time it took to load the frame. A raw YUV frame is cheap to reload but an HEVC frame deep in a GOP is expensive.
+  // - The order in which updateCacheQueue() put the frames into the queue (the playlist priority).
+  // - The distance to the current position in the current item. Frames that were already played are not worth more.
+  // - When the frame was drawn (or cached) last.
+  const int currentFrame = playback->getCurrentFrame();
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  const int n = cacheDeQueue.count();
+  QVector<QPair<double, plItemFrame>> frameValues;
+  frameValues.reserve(n);
+  for (int i = 0; i < n; i++)
+  {
+    const plItemFrame &f = cacheDeQueue[i];
+    if (f.first.isNull())
+      continue;
+
+    double cost = qMax(f.first->getCachedFrameReloadCost(f.second), qint64(1));
+    double priorityWeight = 1.0 + CACHE_EVICTION_PRIORITY_WEIGHT * i / n;
+    double proximityWeight = 1.0;
+    if (f.first == currentItem && (!playing || f.second >= currentFrame))
+      proximityWeight += CACHE_EVICTION_PROXIMITY_WEIGHT / (1.0 + std::abs(f.second - currentFrame) / double(CACHE_EVICTION_DISTANCE_SCALE));
+    double recencyWeight = 1.0;
+    qint64 lastAccess = f.first->getCachedFrameLastAccess(f.second);
+    if (lastAccess >= 0)
+      recencyWeight += CACHE_EVICTION_RECENCY_WEIGHT / (1.0 + (now - lastAccess) / double(CACHE_EVICTION_RECENCY_SCALE_MS));
+
+    frameValues.append(qMakePair(cost * priorityWeight * proximityWeight * recencyWeight, f));
+  }
+
+  std::stable_sort(frameValues.begin(), frameValues.end(), [](const QPair<double, plItemFrame> &a, const QPair<double, plItemFrame> &b) { return a.first < b.first; });
+
+  cacheDeQueue.clear();
+  for (const auto &v : frameValues)
+    cacheDeQueue.enqueue(v.second);
+}
+
 void videoCache::enqueueCacheJob(playlistItem* item, indexRange range)
 {
+  if (!item->isCachable())
+    return;
+
   // Only schedule frames for caching that were not yet cached.
   QList<int> cachedFrames = item->getCachedFrames();
   int i = range.first;
   while (cachedFrames.contains(i) && i < range.second)
     range.first = ++i;
-  if (range.first != range.second)
+  if (range.first < range.second || (range.first == range.second && !cachedFrames.contains(range.first)))
     cacheQueue.append(cacheJob(item, range));
 }
 
+QList<indexRange> videoCache::getPrefetchRanges(playlistItem *item, indexRange range, bool playing) const
+{
+  QList<indexRange> ranges;
+  const int currentFrame = playback->getCurrentFrame();
+  if (currentFrame < range.first || currentFrame > range.second)
+  {
+    ranges.append(range);
+    return ranges;
+  }
+
+  if (playback->getNavigationDirection() < 0)
+  {
+    // The user is moving backwards. Cache the frames before the current frame first. Each block is cached
+    // in forward order because the decoders can only decode forward. Then cache the frames after the current frame.
+    const int backwardEnd = std::max(range.first, currentFrame - CACHE_PREFETCH_BACKWARD_FRAMES + 1);
+    for (int blockEnd = currentFrame; blockEnd >= backwardEnd; blockEnd -= CACHE_PREFETCH_BACKWARD_BLOCK)
+      ranges.append(indexRange(std::max(backwardEnd, blockEnd - CACHE_PREFETCH_BACKWARD_BLOCK + 1), blockEnd));
+    if (currentFrame < range.second)
+      ranges.append(indexRange(currentFrame + 1, range.second));
+    if (backwardEnd > range.first)
+      ranges.append(indexRange(range.first, backwardEnd - 1));
+    return ranges;
+  }
+
+  // Moving forward. While playing, the next few frames are loaded (interactively) before the caching threads could
+  // cache them. Start caching ahead of the playback (depending on the frame rate) so that the cache overtakes it.
+  int startFrame = currentFrame;
+  if (playing)
+    startFrame = std::min(range.second, currentFrame + int(item->getFrameRate() * CACHE_PREFETCH_LEAD_MS / 1000));
+  ranges.append(indexRange(startFrame, range.second));
+  if (startFrame > range.first)
+    // Wrap around
+    ranges.append(indexRange(range.first, startFrame - 1));
+  return ranges;
+}
+
+QList<indexRange> videoCache::enqueueCacheJobsPrefetch(playlistItem *item, indexRange range, qint64 maxFrames, bool playing)
+{
+  QList<indexRange> enqueuedRanges;
+  for (indexRange r : getPrefetchRanges(item, range, playing))
+  {
+    if (maxFrames == 0)
+      break;
+    if (maxFrames > 0)
+    {
+      if (r.second - r.first + 1 > maxFrames)
+        r.second = r.first + int(maxFrames) - 1;
+      maxFrames -= r.second - r.first + 1;
+    }
+    enqueueCacheJob(item, r);
+    enqueuedRanges.append(r);
+  }
+  return enqueuedRanges;
+}
+
+void videoCache::updatePrefetch()
+{
+  if (!cachingEnabled)
+    return;
+
+  auto selection = playlist->getSelectedItems();
+  if (selection[0] == nullptr || !selection[0]->isCachable())
+    return;
+
+  // If the next frames (in the navigation direction) are already cached, the cache queue does not have to change.
+  const int direction = playback->getNavigationDirection();
+  const indexRange range = selection[0]->getFrameIndexRange();
+  const QList<int> cachedFrames = selection[0]->getCachedFrames();
+  bool allCached = true;
+  for (int i = 0, f = playback->getCurrentFrame(); i < CACHE_PREFETCH_CHECK_FRAMES && f >= range.first && f <= range.second; i++, f += direction)
+    if (!cachedFrames.contains(f))
+    {
+      allCached = false;
+      break;
+    }
+  if (allCached)
+    return;
+
+  // Stop the running jobs (they are probably caching frames far away from the current position) and restart caching
+  // from the current position.
+  DEBUG_CACHING("videoCache::updatePrefetch frames at %d are not cached. Update the cache queue.", playback->getCurrentFrame());
+  playlistChanged();
+}
+
 void videoCache::startCaching()
 {
   DEBUG_CACHING("videoCache::startCaching");
@@ -885,36 +1041,33 @@ void videoCache::startCaching()
   }
   else
   {
-    // Push a task to all the threads and start them.
+    // Push a task to all the threads and start them. From then on, the workers take new jobs from the queue themselves.
+    updateCachingThreadLimit();
     bool jobStarted = false;
     for (int i = 0; i < cachingThreadList.count(); i++)
       jobStarted |= pushNextJobToThread(cachingThreadList[i]);
 
     workerState = jobStarted ? workerRunning : workerIdle;
   }
+
+  if (workerState == workerRunning && !statusUpdateTimer.isActive())
+  {
+    // Update the caching status widget and the debug stuff regularly while caching is running
+    statusUpdateTimer.start(100);
+    updateCacheStatus();
+  }
 }
 
 void videoCache::watchItemForCachingFinished(playlistItem *item)
 {
   watchingItem = item;
+  updateCachingThreadLimit();
   if (watchingItem)
   {
     // Check if any frame of the item is schedueld for caching.
     // If not, there is nothing to wait for and the wait is over now.
-    bool waitOver = true;
-    for (auto j : cacheQueue)
-      if (j.plItem == watchingItem)
-      {
-        waitOver = false;
-        break;
-      }
-    if (waitOver)
-    {
-      DEBUG_CACHING("videoCache::watchItemForCachingFinished item not in cache");
-      playback->itemCachingFinished(watchingItem);
-      watchingItem = nullptr;
-    }
-    else if (workerState == workerIdle)
+    checkWatchedItemCachingDone();
+    if (watchingItem && workerState == workerIdle)
     {
       // If the caching is currently not running, start it. Otherwise we will wait forever.
       DEBUG_CACHING("videoCache::watchItemForCachingFinished waiting for item. Start caching.");
@@ -936,6 +1089,7 @@ void videoCache::threadCachingFinished()
   DEBUG_CACHING_DETAIL("videoCache::threadCachingFinished - state %d - worker %p", workerState, worker);
 
   // Check the list of items that are scheduled for deletion. Because a thread finished, maybe now we can delete the item(s).
+  QMutexLocker locker(&cacheQueueMutex);
   for (auto it = itemsToDelete.begin(); it != itemsToDelete.end();)
   {
     bool itemCaching = false;
@@ -955,26 +1109,10 @@ void videoCache::threadCachingFinished()
     else
       ++it;
   }
+  locker.unlock();
 
-  if (watchingItem)
-  {
-    // See if there is more to be done for the item we are waiting for. If not, signal that caching of the item is done.
-    bool waitOver = true;
-    for (auto j : cacheQueue)
-    {
-      if (j.plItem == watchingItem)
-      {
-        waitOver = false;
-        break;
-      }
-    }
-    if (waitOver)
-    {
-      DEBUG_CACHING_DETAIL("videoCache::threadCachingFinished caching of requested item done");
-      playback->itemCachingFinished(watchingItem);
-      watchingItem = nullptr;
-    }
-  }
+  // See if there is more to be done for the item we are waiting for
+  checkWatchedItemCachingDone();
 
   // Also check if the worker is in the cachingWorkerList. If not, do not push a new job to it.
   if (deleteNrThreads > 0)
@@ -994,7 +1132,9 @@ void videoCache::threadCachingFinished()
   }
   else if (workerState == workerRunning)
   {
-    // Get the thread of the worker and push the next cache job to it
+    // The worker did not find another job itself. Maybe it stopped because of the thread limit during playback which
+    // may have changed. Get the thread of the worker and push the next cache job to it.
+    updateCachingThreadLimit();
     for (loadingThread *t : cachingThreadList)
       if (t->worker() == worker)
         pushNextJobToThread(t);
@@ -1043,105 +1183,197 @@ void videoCache::threadCachingFinished()
 
 bool videoCache::pushNextJobToThread(loadingThread *thread)
 {
-  if (cacheQueue.isEmpty() || thread->isQuittint())
-    // No more jobs in the cache queue or the job does not accept new jobs.
+  if (thread->isQuittint())
+    // The thread does not accept new jobs.
     return false;
 
-  // If playback is running and playback is not waiting for a specific item to cache,
-  // only start caching of a new job if caching is enabled while playback is running.
-  if (playback->playing() && watchingItem == nullptr)
-  {
-    auto selection = playlist->getSelectedItems();
-    if (selection[0] && selection[0]->isIndexedByFrame())
-    {
-      // Playback is running and the item that is currently being shown is indexed by frame.
-      // In this case, obey the restriction on nr threads while playback is running.
+  if (!takeNextCacheJob(thread->worker(), false))
+    return false;
 
-      if (nrThreadsPlayback == 0)
-      {
-        // No caching while playback is running
-        DEBUG_CACHING_DETAIL("videoCache::pushNextJobToThread no new job started nrThreadsPlayback=0");
-        return false;
-      }
+  // Start the worker. It will continue with the next jobs in the queue by itself.
+  thread->worker()->setWorking(true);
+  thread->worker()->processCacheJob();
+  return true;
+}
 
-      // Check if there is a limit on the number of threads to use while playback is running.
-      int threadsWorking = 0;
-      for (loadingThread *t : cachingThreadList)
-      {
-        if (t->worker()->isWorking())
-          threadsWorking++;
-      }
+bool videoCache::takeNextCacheJob(loadingWorker *worker, bool continueWorking)
+{
+  QMutexLocker locker(&cacheQueueMutex);
+
+  playlistItem *plItem = nullptr;
+  int frameToCache = -1;
+  int lastFrameToCache = -1;
+  bool jobFound = false;
+
+  // A worker that is already busy counts against the thread limit itself.
+  const int otherWorkersBusy = nrCachingWorkersBusy - (continueWorking ? 1 : 0);
+  if (continueWorking && worker->isInterruptRequested())
+    // The main thread wants this worker to stop (the queue needs updating, an item is deleted or we are quitting)
+    DEBUG_CACHING_DETAIL("videoCache::takeNextCacheJob worker %p was interrupted", worker);
+  else if (cachingThreadLimit >= 0 && otherWorkersBusy >= cachingThreadLimit)
+    // Playback is running and the maximum number (or more) of threads are already working.
+    DEBUG_CACHING_DETAIL("videoCache::takeNextCacheJob no new job started cachingThreadLimit=%d threadsWorking=%d", cachingThreadLimit, otherWorkersBusy);
+  else
+    jobFound = dequeueNextCacheJob(plItem, frameToCache, lastFrameToCache);
 
-      if (nrThreadsPlayback <= threadsWorking)
-      {
-        // The maximum number (or more) of threads are already working.
-        // Do not start another one.
-        DEBUG_CACHING_DETAIL("videoCache::pushNextJobToThread no new job started nrThreadsPlayback=%d threadsWorking=%d", nrThreadsPlayback, threadsWorking);
-        return false;
-      }
+  if (!jobFound)
+  {
+    if (continueWorking)
+    {
+      worker->clearJob();
+      nrCachingWorkersBusy--;
     }
+    return false;
   }
 
-  // Get the top item from the queue but don't remove it yet.
-  playlistItem *plItem   = cacheQueue.head().plItem;
-  indexRange    range    = cacheQueue.head().frameRange;
-  unsigned int frameSize = plItem->getCachingFrameSize();
+  Q_ASSERT_X(plItem != nullptr && frameToCache >= 0, "take next cache job", "Invalid job.");
+  worker->setJob(plItem, frameToCache, lastFrameToCache);
+  if (!continueWorking)
+    nrCachingWorkersBusy++;
+  DEBUG_CACHING_DETAIL("videoCache::takeNextCacheJob - %d-%d of %s - worker %p", frameToCache, lastFrameToCache, plItem->getName().toStdString().c_str(), worker);
+  return true;
+}
 
-  // Remove all the items from the queue that are not cachable (anymore)
-  while (!plItem->isCachable())
-  {
+bool videoCache::dequeueNextCacheJob(playlistItem *&plItem, int &frameToCache, int &lastFrameToCache)
+{
+  // This is called by the caching workers. Only the information that was gathered from the items in the main thread
+  // (when the job was enqueued) is used here. The items themselves are not accessed.
+
+  // Remove the jobs of items that were deleted in the meantime
+  while (!cacheQueue.isEmpty() && cacheQueue.head().plItem.isNull())
     cacheQueue.dequeue();
+  if (cacheQueue.isEmpty())
+    // No more jobs in the cache queue
+    return false;
 
-    if (cacheQueue.isEmpty())
-      // No more items.
-      return false;
+  // Get the top item from the queue but don't remove it yet.
+  const cacheJob &job = cacheQueue.head();
+  plItem = job.plItem;
+  indexRange range = job.frameRange;
+  unsigned int frameSize = job.frameSize;
+
+  // We found an item. Cache the first frame of it (or all frames up to the start of the next caching range).
+  frameToCache = range.first;
+  lastFrameToCache = frameToCache;
+  if (!job.rangeStarts.isEmpty())
+  {
+    auto nextStart = std::upper_bound(job.rangeStarts.begin(), job.rangeStarts.end(), frameToCache);
+    lastFrameToCache = (nextStart == job.rangeStarts.end()) ? range.second : qBound(frameToCache, *nextStart - 1, range.second);
+  }
 
-    plItem = cacheQueue.head().plItem;
-    range  = cacheQueue.head().frameRange;
-    frameSize = plItem->getCachingFrameSize();
+  // First check if we need to free up space to cache these frames. The frames are removed from the items in the
+  // main thread (see removeEvictedFrames()).
+  qint64 jobSize = qint64(frameSize) * (lastFrameToCache - frameToCache + 1);
+  while (cacheLevelCurrent + jobSize >= cacheLevelMax && !cacheDeQueue.isEmpty())
+  {
+    plItemFrame frameToRemove = cacheDeQueue.dequeue();
+    if (frameToRemove.first.isNull())
+      continue;
+
+    DEBUG_CACHING_DETAIL("videoCache::dequeueNextCacheJob Remove frame %d", frameToRemove.second);
+    if (framesToRemove.isEmpty())
+      QMetaObject::invokeMethod(this, "removeEvictedFrames", Qt::QueuedConnection);
+    framesToRemove.append(frameToRemove);
+    cacheLevelCurrent -= cachingFrameSizes.value(frameToRemove.first.data(), 0);
   }
 
-  // We found an item. Cache the first frame of it.
-  int frameToCache = range.first;
+  if (cacheDeQueue.isEmpty() && cacheLevelCurrent + jobSize > cacheLevelMax)
+  {
+    // There is still not enough space but there are no more frames that we can remove.
+    // Only cache as many frames as still fit.
+    lastFrameToCache = frameToCache + int((cacheLevelMax - cacheLevelCurrent) / qMax(frameSize, 1u)) - 1;
+    jobSize = qint64(frameSize) * (lastFrameToCache - frameToCache + 1);
+    if (lastFrameToCache < frameToCache)
+      // The updateCacheQueue function should never create a situation where this is possible ...
+      // We are done here.
+      return false;
+  }
 
   // Update the cache queue
-  if (range.first == range.second)
+  if (lastFrameToCache == range.second)
     // All frames of the item are now cached.
     cacheQueue.dequeue();
   else
     // Update the frame range of the head item in the cache queue
-    cacheQueue.head().frameRange.first = range.first + 1;
+    cacheQueue.head().frameRange.first = lastFrameToCache + 1;
 
-  // First check if we need to free up space to cache this frame.
-  while (cacheLevelCurrent + frameSize >= cacheLevelMax && !cacheDeQueue.isEmpty())
-  {
-    plItemFrame frameToRemove = cacheDeQueue.dequeue();
-    unsigned int frameToRemoveSize = frameToRemove.first->getCachingFrameSize();
+  // Update the cache level
+  cacheLevelCurrent += jobSize;
+
+  return true;
+}
+
+void videoCache::removeEvictedFrames()
+{
+  QMutexLocker locker(&cacheQueueMutex);
+  QList<plItemFrame> frames;
+  frames.swap(framesToRemove);
+  locker.unlock();
+
+  for (const plItemFrame &f : frames)
+    if (!f.first.isNull())
+      f.first->removeFrameFromCache(f.second);
+}
+
+void videoCache::interruptCachingWorkers()
+{
+  // Lock the queue so that no worker can miss the interrupt while it takes the next job
+  QMutexLocker locker(&cacheQueueMutex);
+  for (loadingThread *t : cachingThreadList)
+    t->worker()->interruptCaching();
+}
 
-    DEBUG_CACHING_DETAIL("videoCache::pushNextJobToThread Remove frame %d of %s", frameToRemove.second, frameToRemove.first->getName().toStdString().c_str());
-    frameToRemove.first->removeFrameFromCache(frameToRemove.second);
-    cacheLevelCurrent -= frameToRemoveSize;
+void videoCache::updateCachingThreadLimit()
+{
+  // If playback is running and playback is not waiting for a specific item to cache,
+  // only cache while playback is running if this is enabled (with a limit on the number of threads).
+  int limit = -1;
+  if (playback->playing() && watchingItem == nullptr)
+  {
+    auto selection = playlist->getSelectedItems();
+    if (selection[0] && selection[0]->isIndexedByFrame())
+      // Playback is running and the item that is currently being shown is indexed by frame.
+      // In this case, obey the restriction on nr threads while playback is running.
+      limit = nrThreadsPlayback;
   }
 
-  if (cacheDeQueue.isEmpty() && cacheLevelCurrent + frameSize > cacheLevelMax)
+  QMutexLocker locker(&cacheQueueMutex);
+  cachingThreadLimit = limit;
+}
+
+void videoCache::waitForInteractiveLoading()
+{
+  // Interactive loading has priority. Give it the CPU (and the decoders) for a moment before the next frame is cached.
+  if (nrInteractiveLoadsRunning.load() == 0)
+    return;
+
+  QElapsedTimer waitTimer;
+  waitTimer.start();
+  QMutexLocker locker(&interactiveLoadingMutex);
+  while (nrInteractiveLoadsRunning.load() > 0)
   {
-    // There is still not enough space but there are no more frames that we can remove.
-    // The updateCacheQueue function should never create a situation where this is possible ...
-    // We are done here.
-    return false;
+    qint64 remaining = CACHING_INTERACTIVE_MAX_WAIT_MS - waitTimer.elapsed();
+    if (remaining <= 0 || !interactiveLoadingDone.wait(&interactiveLoadingMutex, remaining))
+      break;
   }
+}
 
-  // Push the job to the thread
-  Q_ASSERT_X(plItem != nullptr && frameToCache >= 0, "push next job to cache", "Invalid job.");
-  thread->worker()->setJob(plItem, frameToCache);
-  thread->worker()->setWorking(true);
-  thread->worker()->processCacheJob();
-  DEBUG_CACHING_DETAIL("videoCache::pushNextJobToThread - %d of %s - worker %p", frameToCache, plItem->getName().toStdString().c_str(), worker);
+void videoCache::checkWatchedItemCachingDone()
+{
+  if (!watchingItem)
+    return;
 
-  // Update the cache level
-  cacheLevelCurrent += frameSize;
+  // See if there is more to be done for the item we are waiting for. If not, signal that caching of the item is done.
+  QMutexLocker locker(&cacheQueueMutex);
+  for (const cacheJob &j : cacheQueue)
+    if (j.plItem == watchingItem)
+      return;
+  locker.unlock();
 
-  return true;
+  DEBUG_CACHING_DETAIL("videoCache::checkWatchedItemCachingDone caching of requested item done");
+  playback->itemCachingFinished(watchingItem);
+  watchingItem = nullptr;
+  updateCachingThreadLimit();
 }
 
 void videoCache::itemAboutToBeDeleted(playlistItem* item)
@@ -1150,11 +1382,16 @@ void videoCache::itemAboutToBeDeleted(playlistItem* item)
   // and then we can re-think our caching strategy.
   if (workerState != workerIdle)
   {
+    // Stop the caching workers after their current frame. They will not take another job.
+    interruptCachingWorkers();
+
     // Are we currently caching a frame from this item?
     bool cachingItem = false;
+    QMutexLocker locker(&cacheQueueMutex);
     for(loadingThread *t : cachingThreadList)
       if (t->worker()->getCacheItem() == item)
         cachingItem = true;
+    locker.unlock();
 
     if (cachingItem)
       // The item can be deleted when all caching threads of the item returned.
@@ -33,14 +33,19 @@
 #ifndef VIDEOCACHE_H
 #define VIDEOCACHE_H
 
+#include <QAtomicInt>
 #include <QDockWidget>
+#include <QHash>
 #include <QLabel>
+#include <QMutex>
 #include <QPointer>
 #include <QQueue>
 #include <QTimer>
+#include <QWaitCondition>
 #include <QWidget>
 #include "playlistTreeWidget.h"
 
+class loadingWorker;
 class videoHandler;
 class videoCache;
 
@@ -101,6 +106,9 @@ private slots:
   // The interactiveWorker finished loading a frame
   void interactiveLoaderFinished();
 
+  // A caching worker finished a job (a range of frames). It may already work on the next one.
+  void threadCachingJobDone() { checkWatchedItemCachingDone(); }
+
   // An item is about to be deleted. If we are currently caching something (especially from this item),
   // abort that operation immediately.
   void itemAboutToBeDeleted(playlistItem*);
@@ -114,15 +122,26 @@ private slots:
   // Analyze the current situation and decide which items are to be cached next (in which order) and
   // which frames can be removed from the cache.
   void updateCacheQueue();
+
+  // The playback controller jumped to another frame. Caching should continue at the new position (see prefetchTimer).
+  void currentFrameJumped() { prefetchTimer.start(); }
+  // If the frames after the current position are not cached, update the cache queue to cache them first.
+  void updatePrefetch();
+
+  // Remove the frames from the cache that the caching workers selected to make space for new frames (see framesToRemove).
+  void removeEvictedFrames();
   
 private:
-  // A cache job. Has a pointer to a playlist item and a range of frames to be cached.
+  // A cache job. Has a pointer to a playlist item and a range of frames to be cached. The caching workers do not
+  // access the item when they take a job. So the frame size and the caching ranges of the item are saved here.
   struct cacheJob
   {
     cacheJob() {}
     cacheJob(playlistItem *item, indexRange range);
     QPointer<playlistItem> plItem;
     indexRange frameRange;
+    unsigned int frameSize;
+    QList<int> rangeStarts;  //< See playlistItem::getCachingRangeStarts()
   };
   typedef QPair<QPointer<playlistItem>, int> plItemFrame;
 
@@ -135,16 +154,34 @@ private:
 
   // Is caching even enabled?
   bool cachingEnabled;
+  // The caching workers take their next job from the cacheQueue themselves (in their thread) when they finished a job.
+  // This mutex protects the cacheQueue, the cacheDeQueue, framesToRemove, cachingFrameSizes, cacheLevelCurrent, nrCachingWorkersBusy, cachingThreadLimit
+  // and the jobs of the caching workers. It must be locked when the caching workers are interrupted.
+  QMutex cacheQueueMutex;
   // The queue of caching jobs that are scheduled
   QQueue<cacheJob> cacheQueue;
   // The queue with a list of frames/items that can be removed from the queue if necessary
   QQueue<plItemFrame> cacheDeQueue;
+  // The caching frame size of the items in the playlist (updated in updateCacheQueue())
+  QHash<playlistItem*, unsigned int> cachingFrameSizes;
+  // The frames that a caching worker took from the cacheDeQueue. They are removed from the items in the main thread.
+  QList<plItemFrame> framesToRemove;
   // If a frame is removed can be determined by the following cache states:
   qint64 cacheLevelMax;
   qint64 cacheLevelCurrent;
 
   // Enqueue the job in the queue. If all frames within the range are already cached in the item, do nothing.
   void enqueueCacheJob(playlistItem* item, indexRange range);
+  // The frames of the range in the order in which the user will probably need them. This starts at the current frame
+  // (or a bit ahead of it when playing) in the current navigation direction and wraps around.
+  QList<indexRange> getPrefetchRanges(playlistItem *item, indexRange range, bool playing) const;
+  // Enqueue up to maxFrames frames (-1: all) of the item in the prefetch order. Return the ranges that were enqueued.
+  QList<indexRange> enqueueCacheJobsPrefetch(playlistItem *item, indexRange range, qint64 maxFrames, bool playing);
+  // When the user jumps (e.g. drags the slider), wait for a moment before the cache queue is updated
+  QTimer prefetchTimer;
+  // Sort the cacheDeQueue so that the frames which are cheapest to lose are removed first. This considers the time
+  // it took to load each frame, the order of updateCacheQueue(), the distance to the current frame and the last use.
+  void sortCacheDeQueue(playlistItem *currentItem, bool playing);
 
   unsigned int cacheRateInBytesPerMs;
 
@@ -154,6 +191,19 @@ private:
   int deleteNrThreads;
   // How many threads are to be used when playback is running?
   int nrThreadsPlayback;
+  // The maximum number of caching workers that may work at the same time (-1 if there is no limit). This is evaluated
+  // in the main thread by updateCachingThreadLimit() so that the workers do not have to access the playlist or playback.
+  int cachingThreadLimit;
+  void updateCachingThreadLimit();
+  // The number of caching workers that currently have a job
+  int nrCachingWorkersBusy;
+
+  // Interactive loading has priority over caching. While an interactive load is running, the caching workers wait
+  // (for a limited time) before they start caching the next frame.
+  QAtomicInt nrInteractiveLoadsRunning;
+  QMutex interactiveLoadingMutex;
+  QWaitCondition interactiveLoadingDone;
+  void waitForInteractiveLoading();
 
   // Our tiny internal state machine for the worker
   enum workerStateEnum
@@ -182,6 +232,18 @@ private:
   // Get the next item and frame to cache from the queue and push it to the given worker.
   // Return false if there are no more jobs to be pushed.
   bool pushNextJobToThread(loadingThread *thread);
+  // Get the next job from the cache queue and set it in the given worker. This is thread safe and is called by the caching
+  // workers when they finished a job so that they can continue without going through the main thread. If continueWorking
+  // is set, the worker is already busy. Return false if the worker should stop (no job, interrupted or thread limit reached).
+  bool takeNextCacheJob(loadingWorker *worker, bool continueWorking);
+  // Take the next range of frames from the head of the cacheQueue and free up the space for it. cacheQueueMutex must be locked.
+  bool dequeueNextCacheJob(playlistItem *&plItem, int &frameToCache, int &lastFrameToCache);
+  // Interrupt all caching workers after their current frame
+  void interruptCachingWorkers();
+  friend class loadingWorker;
+
+  // If the item that we are watching has no more jobs in the cacheQueue, tell the playback controller
+  void checkWatchedItemCachingDone();
   
   bool updateCacheQueueAndRestartWorker;
 
@@ -32,6 +32,8 @@
 
 #include "videoHandler.h"
 
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QPainter>
 #include "signalsSlots.h"
 
@@ -43,6 +45,97 @@
 #define DEBUG_VIDEO(fmt,...) ((void)0)
 #endif
 
+// --------- cachedFramesIndex --------------------------------
+
+cachedFramesIndex::cachedFramesIndex()
+{
+  for (int i = 0; i < maxNrBlocks; i++)
+    blocks[i].store(nullptr);
+}
+
+cachedFramesIndex::~cachedFramesIndex()
+{
+  for (int i = 0; i < maxNrBlocks; i++)
+    delete[] blocks[i].load();
+}
+
+void cachedFramesIndex::setCached(int frameIdx, bool cached)
+{
+  if (!isInIndexRange(frameIdx))
+  {
+    if (cached)
+      framesOutsideIndex.store(1);
+    return;
+  }
+
+  QAtomicInteger<quint32> *block = blocks[frameIdx / framesPerBlock].loadAcquire();
+  if (block == nullptr)
+  {
+    if (!cached)
+      return;
+    // The new block is zero initialized before it is published
+    block = new QAtomicInteger<quint32>[wordsPerBlock];
+    blocks[frameIdx / framesPerBlock].storeRelease(block);
+  }
+
+  QAtomicInteger<quint32> &word = block[(frameIdx % framesPerBlock) / 32];
+  const quint32 mask = 1u << (frameIdx % 32);
+  if (cached)
+  {
+    if ((word.fetchAndOrRelease(mask) & mask) == 0)
+      nrFramesCached.ref();
+  }
+  else
+  {
+    if ((word.fetchAndAndRelease(~mask) & mask) != 0)
+      nrFramesCached.deref();
+  }
+}
+
+void cachedFramesIndex::clear()
+{
+  for (int i = 0; i < maxNrBlocks; i++)
+  {
+    QAtomicInteger<quint32> *block = blocks[i].loadAcquire();
+    if (block)
+      for (int w = 0; w < wordsPerBlock; w++)
+        block[w].storeRelease(0);
+  }
+  nrFramesCached.store(0);
+  framesOutsideIndex.store(0);
+}
+
+bool cachedFramesIndex::contains(int frameIdx) const
+{
+  if (!isInIndexRange(frameIdx))
+    return false;
+  const QAtomicInteger<quint32> *block = blocks[frameIdx / framesPerBlock].loadAcquire();
+  if (block == nullptr)
+    return false;
+  return (block[(frameIdx % framesPerBlock) / 32].loadAcquire() & (1u << (frameIdx % 32))) != 0;
+}
+
+QList<int> cachedFramesIndex::getFrames() const
+{
+  QList<int> frames;
+  for (int i = 0; i < maxNrBlocks; i++)
+  {
+    const QAtomicInteger<quint32> *block = blocks[i].loadAcquire();
+    if (block == nullptr)
+      continue;
+    for (int w = 0; w < wordsPerBlock; w++)
+    {
+      const quint32 bits = block[w].loadAcquire();
+      if (bits == 0)
+        continue;
+      for (int b = 0; b < 32; b++)
+        if (bits & (1u << b))
+          frames.append(i * framesPerBlock + w * 32 + b);
+    }
+  }
+  return frames;
+}
+
 // --------- videoHandler -------------------------------------
 
 videoHandler::videoHandler()
@@ -94,9 +187,6 @@ itemLoadingState videoHandler::needsLoading(int frameIdx, bool loadRawValues)
       return state;
   }
 
-  // Lock the mutex for checking the cache
-  QMutexLocker lock(&imageCacheAccess);
-
   // The raw values are not needed. 
   if (frameIdx == currentImageIdx)
   {
@@ -105,7 +195,7 @@ itemLoadingState videoHandler::needsLoading(int frameIdx, bool loadRawValues)
       DEBUG_VIDEO("videoHandler::needsLoading %d is current and %d found in double buffer", frameIdx, frameIdx+1);
       return LoadingNotNeeded;
     }
-    else if (imageCache.contains(frameIdx + 1))
+    else if (cacheIndexContains(frameIdx + 1))
     {
       DEBUG_VIDEO("videoHandler::needsLoading %d is current and %d found in cache", frameIdx, frameIdx+1);
       return LoadingNotNeeded;
@@ -122,7 +212,7 @@ itemLoadingState videoHandler::needsLoading(int frameIdx, bool loadRawValues)
   if (doubleBufferImageFrameIdx == frameIdx)
   {
     // The frame in question is in the double buffer...
-    if (imageCache.contains(frameIdx + 1))
+    if (cacheIndexContains(frameIdx + 1))
     {
       // ... and the one after that is in the cache.
       DEBUG_VIDEO("videoHandler::needsLoading %d found in double buffer. Next frame in cache.", frameIdx);
@@ -139,7 +229,7 @@ itemLoadingState videoHandler::needsLoading(int frameIdx, bool loadRawValues)
   }
 
   // Check the cache
-  if (imageCache.contains(frameIdx))
+  if (cacheIndexContains(frameIdx))
   {
     // What about the next frame? Is it also in the cache or in the double buffer?
     if (doubleBufferImageFrameIdx == frameIdx + 1)
@@ -147,7 +237,7 @@ itemLoadingState videoHandler::needsLoading(int frameIdx, bool loadRawValues)
       DEBUG_VIDEO("videoHandler::needsLoading %d in cache and %d found in double buffer", frameIdx, frameIdx+1);
       return LoadingNotNeeded;
     }
-    else if (imageCache.contains(frameIdx + 1))
+    else if (cacheIndexContains(frameIdx + 1))
     {
       DEBUG_VIDEO("videoHandler::needsLoading %d in cache and %d found in cache", frameIdx, frameIdx+1);
       return LoadingNotNeeded;
@@ -179,15 +269,29 @@ void videoHandler::drawFrame(QPainter *painter, int frameIdx, double zoomFactor,
       currentImageIdx = frameIdx;
       DEBUG_VIDEO("videoHandler::drawFrame %d loaded from double buffer", frameIdx);
     }
-    else
+    else if (cacheIndexContains(frameIdx))
     {
       QMutexLocker lock(&imageCacheAccess);
+      if (cacheFrameInfo.contains(frameIdx))
+        cacheFrameInfo[frameIdx].lastAccess = QDateTime::currentMSecsSinceEpoch();
       if (imageCache.contains(frameIdx))
       {
         currentImage = imageCache[frameIdx];
         currentImageIdx = frameIdx;
         DEBUG_VIDEO("videoHandler::drawFrame %d loaded from cache", frameIdx);
       }
+      else if (rawDataCache.contains(frameIdx))
+      {
+        // Only the raw data is cached. Convert it now.
+        QByteArray rawData = rawDataCache[frameIdx];
+        lock.unlock();
+        QImage newImage;
+        convertCachedRawData(frameIdx, rawData, newImage);
+        QMutexLocker setLock(&currentImageSetMutex);
+        currentImage = newImage;
+        currentImageIdx = frameIdx;
+        DEBUG_VIDEO("videoHandler::drawFrame %d converted from raw data cache", frameIdx);
+      }
     }
   }
 
@@ -233,8 +337,10 @@ QRgb videoHandler::getPixelVal(int x, int y)
 
 int videoHandler::getNrFramesCached() const
 {
+  if (!cachedFrames.hasFramesOutsideIndex())
+    return cachedFrames.count();
   QMutexLocker lock(&imageCacheAccess);
-  return imageCache.size();
+  return imageCache.size() + rawDataCache.size();
 }
 
 // Put the frame into the cache (if it is not already in there)
@@ -249,6 +355,32 @@ void videoHandler::cacheFrame(int frameIdx)
     return;
   }
 
+  if (cacheFrameFromDiskCache(frameIdx))
+  {
+    DEBUG_VIDEO("videoHandler::cacheFrame frame %i loaded from disk cache", frameIdx);
+    return;
+  }
+
+  QElapsedTimer loadingTimer;
+  loadingTimer.start();
+
+  if (useRawDataCache())
+  {
+    // Only load the raw data. It is converted when the frame is drawn.
+    QByteArray cacheData;
+    if (loadRawDataForCaching(frameIdx, cacheData))
+    {
+      DEBUG_VIDEO("videoHandler::cacheFrame insert raw data of frame %i into cache", frameIdx);
+      QMutexLocker imageCacheLock(&imageCacheAccess);
+      rawDataCache.insert(frameIdx, cacheData);
+      cachedFrames.setCached(frameIdx, true);
+      setCachedFrameInfo(frameIdx, loadingTimer.elapsed());
+    }
+    else
+      DEBUG_VIDEO("videoHandler::cacheFrame loading raw data of frame %i for caching failed", frameIdx);
+    return;
+  }
+
   // Load the frame. While this is happening in the background the frame size must not change.
   QImage cacheImage;
   loadFrameForCaching(frameIdx, cacheImage);
@@ -259,37 +391,166 @@ void videoHandler::cacheFrame(int frameIdx)
     DEBUG_VIDEO("videoHandler::cacheFrame insert frame %i into cache", frameIdx);
     QMutexLocker imageCacheLock(&imageCacheAccess);
     imageCache.insert(frameIdx, cacheImage);
+    cachedFrames.setCached(frameIdx, true);
+    setCachedFrameInfo(frameIdx, loadingTimer.elapsed());
   }
   else
     DEBUG_VIDEO("videoHandler::cacheFrame loading frame %i for caching failed", frameIdx);
 }
 
+void videoHandler::cacheFrameFromRawData(int frameIdx, const QByteArray &rawData, qint64 decodingCost)
+{
+  DEBUG_VIDEO("videoHandler::cacheFrameFromRawData %d", frameIdx);
+
+  if (isInCache(frameIdx))
+    // No need to add it again
+    return;
+
+  if (useRawDataCache())
+  {
+    QMutexLocker imageCacheLock(&imageCacheAccess);
+    rawDataCache.insert(frameIdx, rawData);
+    cachedFrames.setCached(frameIdx, true);
+    setCachedFrameInfo(frameIdx, decodingCost);
+    return;
+  }
+
+  QElapsedTimer conversionTimer;
+  conversionTimer.start();
+  QImage cacheImage;
+  convertRawDataForCaching(rawData, cacheImage);
+  if (!cacheImage.isNull())
+  {
+    QMutexLocker imageCacheLock(&imageCacheAccess);
+    imageCache.insert(frameIdx, cacheImage);
+    cachedFrames.setCached(frameIdx, true);
+    setCachedFrameInfo(frameIdx, decodingCost + conversionTimer.elapsed());
+  }
+}
+
+void videoHandler::setCachedFrameInfo(int frameIdx, qint64 reloadCost)
+{
+  cachedFrameInfo info;
+  info.reloadCost = reloadCost;
+  info.lastAccess = QDateTime::currentMSecsSinceEpoch();
+  cacheFrameInfo.insert(frameIdx, info);
+}
+
+qint64 videoHandler::getCachedFrameReloadCost(int idx) const
+{
+  QMutexLocker lock(&imageCacheAccess);
+  return cacheFrameInfo.contains(idx) ? cacheFrameInfo[idx].reloadCost : -1;
+}
+
+qint64 videoHandler::getCachedFrameLastAccess(int idx) const
+{
+  QMutexLocker lock(&imageCacheAccess);
+  return cacheFrameInfo.contains(idx) ? cacheFrameInfo[idx].lastAccess : -1;
+}
+
 unsigned int videoHandler::getCachingFrameSize() const
 {
+  if (useRawDataCache())
+    return getRawDataCachingFrameSize();
   auto bytes = bytesPerPixel(platformImageFormat());
   return frameSize.width() * frameSize.height() * bytes;
 }
 
 QList<int> videoHandler::getCachedFrames() const
 {
+  if (!cachedFrames.hasFramesOutsideIndex())
+    return cachedFrames.getFrames();
   QMutexLocker lock(&imageCacheAccess);
-  return imageCache.keys();
+  return imageCache.keys() + rawDataCache.keys();
 }
 
 bool videoHandler::isInCache(int idx) const
 {
+  return cacheIndexContains(idx);
+}
+
+bool videoHandler::cacheIndexContains(int frameIdx) const
+{
+  if (cachedFramesIndex::isInIndexRange(frameIdx))
+    return cachedFrames.contains(frameIdx);
   QMutexLocker lock(&imageCacheAccess);
-  return imageCache.contains(idx);
+  return cacheContains(frameIdx);
 }
 
 void videoHandler::removefromCache(int idx)
 {
   QMutexLocker lock(&imageCacheAccess);
   if (idx == -1)
+  {
     imageCache.clear();
+    rawDataCache.clear();
+    cacheFrameInfo.clear();
+    cachedFrames.clear();
+  }
+  else
+  {
+    // The frame is still valid. Move it to the disk cache so that it does not have to be loaded again. This is
+    // done after unlocking because it may have to wait for the disk. If clearCache() is called in the meantime,
+    // the generation of the disk cache changes and the frame is discarded.
+    QByteArray rawData = rawDataCache.take(idx);
+    QImage image = imageCache.take(idx);
+    cacheFrameInfo.remove(idx);
+    cachedFrames.setCached(idx, false);
+    const int diskCacheGeneration = diskCache.getGeneration();
+    lock.unlock();
+    diskCache.addFrame(idx, rawData, image, diskCacheGeneration);
+  }
+}
+
+bool videoHandler::cacheFrameFromDiskCache(int frameIdx)
+{
+  QElapsedTimer loadingTimer;
+  loadingTimer.start();
+  QByteArray rawData;
+  QImage cacheImage;
+  if (!diskCache.getFrame(frameIdx, rawData, cacheImage))
+    return false;
+
+  if (!rawData.isEmpty())
+  {
+    // Put the raw data in the cache (or convert it if the raw data cache was disabled in the meantime)
+    cacheFrameFromRawData(frameIdx, rawData, loadingTimer.elapsed());
+    return true;
+  }
+
+  QMutexLocker imageCacheLock(&imageCacheAccess);
+  imageCache.insert(frameIdx, cacheImage);
+  cachedFrames.setCached(frameIdx, true);
+  setCachedFrameInfo(frameIdx, loadingTimer.elapsed());
+  return true;
+}
+
+bool videoHandler::loadFrameFromDiskCache(int frameIndex, bool loadToDoubleBuffer, bool allowImage)
+{
+  QByteArray rawData;
+  QImage newImage;
+  if (!diskCache.getFrame(frameIndex, rawData, newImage))
+    return false;
+  if (!rawData.isEmpty())
+    convertCachedRawData(frameIndex, rawData, newImage);
+  else if (!allowImage)
+    return false;
+  if (newImage.isNull())
+    return false;
+
+  DEBUG_VIDEO("videoHandler::loadFrameFromDiskCache %d %s", frameIndex, (loadToDoubleBuffer) ? "toDoubleBuffer" : "");
+  if (loadToDoubleBuffer)
+  {
+    doubleBufferImage = newImage;
+    doubleBufferImageFrameIdx = frameIndex;
+  }
   else
-    imageCache.remove(idx);
-  lock.unlock();
+  {
+    QMutexLocker imageLock(&currentImageSetMutex);
+    currentImage = newImage;
+    currentImageIdx = frameIndex;
+  }
+  return true;
 }
 
 void videoHandler::removeFrameFromCache(int frameIdx)
@@ -304,7 +565,12 @@ void videoHandler::clearCache()
   {
     QMutexLocker lock(&imageCacheAccess);
     imageCache.clear();
+    rawDataCache.clear();
+    cacheFrameInfo.clear();
+    cachedFrames.clear();
   }
+  // The frames in the disk cache are not valid anymore either
+  diskCache.clear();
   emit signalCacheCleared();
 }
 
@@ -312,6 +578,9 @@ void videoHandler::loadFrame(int frameIndex, bool loadToDoubleBuffer)
 {
   DEBUG_VIDEO("videoHandler::loadFrame %d %s\n", frameIndex, (loadToDoubleBuffer) ? "toDoubleBuffer" : "");
 
+  if (requestedFrame_idx != frameIndex && loadFrameFromDiskCache(frameIndex, loadToDoubleBuffer))
+    return;
+
   if (requestedFrame_idx != frameIndex)
   {
     // Lock the mutex for requesting raw data (we share the requestedFrame buffer with the caching function)
@@ -33,11 +33,44 @@
 #ifndef VIDEOHANDLER_H
 #define VIDEOHANDLER_H
 
+#include "frameDiskCache.h"
 #include "frameHandler.h"
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QAtomicPointer>
 #include <QBasicTimer>
 #include <QFileInfo>
 #include <QMutex>
 
+// An index of the frames that are in the cache of a videoHandler which can be read from any thread without locking.
+// Only one thread at a time may modify it (the videoHandler does this with the imageCacheAccess mutex locked). The flags
+// are kept in blocks of bits which are allocated when needed and only freed in the destructor, so a reader never
+// accesses a deleted block. Frame indices that are too big for the index are only counted in hasFramesOutsideIndex().
+class cachedFramesIndex
+{
+public:
+  cachedFramesIndex();
+  ~cachedFramesIndex();
+
+  void setCached(int frameIdx, bool cached);
+  void clear();
+
+  bool contains(int frameIdx) const;
+  int count() const { return nrFramesCached.load(); }
+  QList<int> getFrames() const;
+  // If a frame index was too big for the index, the reader must check the cache itself.
+  bool hasFramesOutsideIndex() const { return framesOutsideIndex.load() != 0; }
+  static bool isInIndexRange(int frameIdx) { return frameIdx >= 0 && frameIdx < maxNrBlocks * framesPerBlock; }
+
+private:
+  static const int wordsPerBlock = 256;
+  static const int framesPerBlock = wordsPerBlock * 32;
+  static const int maxNrBlocks = 1024;
+  QAtomicPointer<QAtomicInteger<quint32>> blocks[maxNrBlocks];
+  QAtomicInt nrFramesCached;
+  QAtomicInt framesOutsideIndex;
+};
+
 /* TODO
 */
 class videoHandler : public frameHandler
@@ -56,14 +89,29 @@ public:
   virtual void drawFrame(QPainter *painter, int frameIdx, double zoomFactor, bool drawRawValues);
 
   // --- Caching ----
-  // These methods are all thread-safe and can be invoked from any thread.
+  // These methods are all thread-safe and can be invoked from any thread. getNrFramesCached(), getCachedFrames() and
+  // isInCache() only read the cachedFramesIndex so they never wait for the caching threads.
+  // A frame is either cached as a converted image (fast drawing) or, if the handler supports it and useRawDataCache()
+  // is set, as the raw data (less memory). A frame from the raw data cache is converted when it is drawn.
   int getNrFramesCached() const;
   void cacheFrame(int frameIdx);
-  unsigned int getCachingFrameSize() const; // How much bytes will be used when caching one frame?
+  // Cache the frame from the given raw data instead of requesting the data. Items that can load the data of multiple
+  // frames at the same time (e.g. using multiple decoders) use this. The handler has to support raw data (convertRawDataForCaching).
+  // The decodingCost is the time (in ms) it took the item to get the raw data (see getCachedFrameReloadCost()).
+  void cacheFrameFromRawData(int frameIdx, const QByteArray &rawData, qint64 decodingCost=0);
+  unsigned int getCachingFrameSize() const; // How much bytes will be used when caching one frame (in the current cache mode)?
   QList<int> getCachedFrames() const;
   bool isInCache(int idx) const;
+  // For every cached frame, the time (in ms) it took to load it and the time it was last drawn (or cached) are recorded.
+  // The videoCache uses these to decide which frames are removed first. Return -1 if the frame is not cached.
+  qint64 getCachedFrameReloadCost(int idx) const;
+  qint64 getCachedFrameLastAccess(int idx) const;
+  // Remove the frame from the cache. If the disk cache is enabled, the frame is moved to the disk cache.
   void removefromCache(int idx);
   void clearCache();
+  // If the frame was moved to the disk cache, load it from there back into the cache. Return false if the frame
+  // is not in the disk cache. Items that cache frames themselves (cacheFrameFromRawData) should try this first.
+  bool cacheFrameFromDiskCache(int frameIdx);
     
   // Same as the calculateDifference in frameHandler. For a video we have to make sure that the right frame is loaded first.
   virtual QImage calculateDifference(frameHandler *item2, const int frame, QList<infoItem> &differenceInfoList, const int amplificationFactor, const bool markDifference) Q_DECL_OVERRIDE;
@@ -134,6 +182,20 @@ protected:
   // the requested frame. No other internal state of the specific video format handler should be changed.
   // currentFrame/currentFrameIdx is still the frame on screen. This is called from a background thread.
   virtual void loadFrameForCaching(int frameIndex, QImage &frameToCache);
+
+  // --- Raw data caching: The default implementation does not support this. A video handler that works on raw data
+  // (like YUV) can override these to cache the raw data instead of the converted image.
+  // Should new frames be put into the raw data cache?
+  virtual bool useRawDataCache() const { return false; }
+  // How many bytes does one frame in the raw data cache use?
+  virtual unsigned int getRawDataCachingFrameSize() const { return 0; }
+  // Same as loadFrameForCaching but get the raw data. Return false if loading failed. This is called from a background thread.
+  virtual bool loadRawDataForCaching(int frameIndex, QByteArray &rawDataToCache) { Q_UNUSED(frameIndex); Q_UNUSED(rawDataToCache); return false; }
+  // Convert the raw data of the given frame from the raw data cache to an image. This is called when the frame is drawn.
+  virtual void convertCachedRawData(int frameIndex, const QByteArray &rawData, QImage &outputImage) { Q_UNUSED(frameIndex); Q_UNUSED(rawData); Q_UNUSED(outputImage); }
+  // Convert the given raw data to an image for caching. Like loadFrameForCaching, no other internal state may be changed.
+  // This is called from a background thread.
+  virtual void convertRawDataForCaching(const QByteArray &rawData, QImage &frameToCache) { Q_UNUSED(rawData); Q_UNUSED(frameToCache); }
     
   // Only one thread at a time should request something to be loaded. 
   QMutex requestDataMutex;
@@ -148,10 +210,35 @@ protected:
   QImage doubleBufferImage;
   int    doubleBufferImageFrameIdx;
 
+  // If the frame is in the disk cache, set it as the current frame (or in the double buffer) and return true.
+  // Frames from the disk cache that were cached as an image do not update the raw values of the handler.
+  // If allowImage is false, these are not used.
+  bool loadFrameFromDiskCache(int frameIndex, bool loadToDoubleBuffer, bool allowImage=true);
+
 private:
   // --- Caching
-  QMutex mutable     imageCacheAccess;
-  QMap<int, QImage>  imageCache;
+  // Both caches are protected by the imageCacheAccess mutex. A frame is only in one of them.
+  QMutex mutable         imageCacheAccess;
+  QMap<int, QImage>      imageCache;
+  QMap<int, QByteArray>  rawDataCache;
+  // Is the frame in one of the caches? The imageCacheAccess mutex must be locked.
+  bool cacheContains(int frameIdx) const { return imageCache.contains(frameIdx) || rawDataCache.contains(frameIdx); }
+  // Which frames are in imageCache or rawDataCache? This is updated together with the caches (imageCacheAccess locked).
+  cachedFramesIndex cachedFrames;
+  // Is the frame in one of the caches? This does not need the imageCacheAccess mutex.
+  bool cacheIndexContains(int frameIdx) const;
+  // The reload cost and the last access time (QDateTime::currentMSecsSinceEpoch()) of each cached frame.
+  // Also protected by the imageCacheAccess mutex.
+  struct cachedFrameInfo
+  {
+    qint64 reloadCost;
+    qint64 lastAccess;
+  };
+  QMap<int, cachedFrameInfo> cacheFrameInfo;
+  void setCachedFrameInfo(int frameIdx, qint64 reloadCost);
+
+  // The frames that were removed from the cache (if enabled in the settings)
+  frameDiskCache diskCache;
 
 private slots:
   // Override the slotVideoControlChanged slot. For a videoHandler, also the number of frames might have changed.
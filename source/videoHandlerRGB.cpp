@@ -429,6 +429,11 @@ void videoHandlerRGB::loadFrame(int frameIndex, bool loadToDoubleBuffer)
     // We cannot load a frame if the format is not known
     return;
 
+  // A frame that was moved to the disk cache does not have to be loaded again. If it was cached as an image, it does
+  // not contain the raw RGB values. Only use these for the double buffer (playback) where no raw values are shown.
+  if (currentFrameRawRGBData_frameIdx != frameIndex && loadFrameFromDiskCache(frameIndex, loadToDoubleBuffer, loadToDoubleBuffer))
+    return;
+
   // Does the data in currentFrameRawRGBData need to be updated?
   if (!loadRawRGBData(frameIndex))
     // Loading failed or it is still being performed in the background
@@ -1192,6 +1197,12 @@ QImage videoHandlerRGB::calculateDifference(frameHandler *item2, const int frame
 
 void videoHandlerRGB::invalidateAllBuffers()
 {
+  // Release the data. It may point into a memory mapped file that is about to be reopened.
+  QMutexLocker lock(&requestDataMutex);
   currentFrameRawRGBData_frameIdx = -1;
+  currentFrameRawRGBData.clear();
+  rawRGBData_frameIdx = -1;
+  rawRGBData.clear();
+  lock.unlock();
   videoHandler::invalidateAllBuffers();
 }
@@ -37,8 +37,13 @@
 #include <xmmintrin.h>
 #include <QDir>
 #include <QPainter>
+#include <QSettings>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QVector>
 #include "fileInfoWidget.h"
 #include "signalsSlots.h"
+#include "yuvConversionSIMD.h"
 
 using namespace YUV_Internals;
 
@@ -1511,6 +1516,11 @@ void videoHandlerYUV::loadFrame(int frameIndex, bool loadToDoubleBuffer)
     // We cannot load a frame if the format is not known
     return;
 
+  // A frame that was moved to the disk cache does not have to be loaded again. If it was cached as an image, it does
+  // not contain the raw YUV values. Only use these for the double buffer (playback) where no raw values are shown.
+  if (currentFrameRawYUVData_frameIdx != frameIndex && loadFrameFromDiskCache(frameIndex, loadToDoubleBuffer, loadToDoubleBuffer))
+    return;
+
   // Does the data in currentFrameRawYUVData need to be updated?
   if (!loadRawYUVData(frameIndex))
     // Loading failed or it is still being performed in the background
@@ -1518,17 +1528,18 @@ void videoHandlerYUV::loadFrame(int frameIndex, bool loadToDoubleBuffer)
 
   // The data in currentFrameRawYUVData is now up to date. If necessary
   // convert the data to RGB.
+  // This is an interactive request. Convert the frame using multiple threads.
   if (loadToDoubleBuffer)
   {
     QImage newImage;
-    convertYUVToImage(currentFrameRawYUVData, newImage, srcPixelFormat, frameSize);
+    convertYUVToImage(currentFrameRawYUVData, newImage, srcPixelFormat, frameSize, true);
     doubleBufferImage = newImage;
     doubleBufferImageFrameIdx = frameIndex;
   }
   else if (currentImageIdx != frameIndex)
   {
     QImage newImage;
-    convertYUVToImage(currentFrameRawYUVData, newImage, srcPixelFormat, frameSize);
+    convertYUVToImage(currentFrameRawYUVData, newImage, srcPixelFormat, frameSize, true);
     QMutexLocker setLock(&currentImageSetMutex);
     currentImage = newImage;
     currentImageIdx = frameIndex;
@@ -1543,20 +1554,61 @@ void videoHandlerYUV::loadFrameForCaching(int frameIndex, QImage &frameToCache)
   yuvPixelFormat yuvFormat = srcPixelFormat;
   const QSize curFrameSize = frameSize;
 
-  requestDataMutex.lock();
+  QByteArray tmpBufferRawYUVDataCaching;
+  if (!loadRawDataForCaching(frameIndex, tmpBufferRawYUVDataCaching))
+    return;
+
+  // Convert YUV to image. This can then be cached. The caching threads already work in parallel (one frame per thread)
+  // so the conversion itself is not split up.
+  convertYUVToImage(tmpBufferRawYUVDataCaching, frameToCache, yuvFormat, curFrameSize);
+}
+
+void videoHandlerYUV::convertRawDataForCaching(const QByteArray &rawData, QImage &frameToCache)
+{
+  DEBUG_YUV("videoHandlerYUV::convertRawDataForCaching");
+
+  yuvPixelFormat yuvFormat = srcPixelFormat;
+  const QSize curFrameSize = frameSize;
+  if (rawData.size() < yuvFormat.bytesPerFrame(curFrameSize))
+    // The format was changed since the data was loaded
+    return;
+
+  convertYUVToImage(rawData, frameToCache, yuvFormat, curFrameSize);
+}
+
+bool videoHandlerYUV::loadRawDataForCaching(int frameIndex, QByteArray &rawDataToCache)
+{
+  DEBUG_YUV("videoHandlerYUV::loadRawDataForCaching %d", frameIndex);
+
+  QMutexLocker lock(&requestDataMutex);
   emit signalRequestRawData(frameIndex, true);
-  QByteArray tmpBufferRawYUVDataCaching = rawYUVData;
-  requestDataMutex.unlock();
 
   if (frameIndex != rawYUVData_frameIdx)
   {
     // Loading failed
-    DEBUG_YUV("videoHandlerYUV::loadFrameForCaching Loading failed");
-    return;
+    DEBUG_YUV("videoHandlerYUV::loadRawDataForCaching Loading failed");
+    return false;
   }
 
-  // Convert YUV to image. This can then be cached.
-  convertYUVToImage(tmpBufferRawYUVDataCaching, frameToCache, yuvFormat, curFrameSize);
+  rawDataToCache = rawYUVData;
+  return true;
+}
+
+void videoHandlerYUV::convertCachedRawData(int frameIndex, const QByteArray &rawData, QImage &outputImage)
+{
+  DEBUG_YUV("videoHandlerYUV::convertCachedRawData %d", frameIndex);
+
+  // The frame is about to be shown. Convert it using multiple threads.
+  convertYUVToImage(rawData, outputImage, srcPixelFormat, frameSize, true);
+
+  // This runs in the main thread. The interactive loader sets the same buffer (loadRawYUVData()). Don't wait if a caching
+  // thread is loading a frame right now. The raw values are loaded again when they are needed.
+  if (requestDataMutex.tryLock())
+  {
+    currentFrameRawYUVData = rawData;
+    currentFrameRawYUVData_frameIdx = frameIndex;
+    requestDataMutex.unlock();
+  }
 }
 
 // Load the raw YUV data for the given frame index into currentFrameRawYUVData.
@@ -1570,9 +1622,8 @@ bool videoHandlerYUV::loadRawYUVData(int frameIndex)
 
   // The function loadFrameForCaching also uses the signalRequesRawYUVData to request raw data.
   // However, only one thread can use this at a time.
-  requestDataMutex.lock();
+  QMutexLocker lock(&requestDataMutex);
   emit signalRequestRawData(frameIndex, false);
-  requestDataMutex.unlock();
 
   if (frameIndex != rawYUVData_frameIdx)
   {
@@ -1583,7 +1634,8 @@ bool videoHandlerYUV::loadRawYUVData(int frameIndex)
 
   currentFrameRawYUVData = rawYUVData;
   currentFrameRawYUVData_frameIdx = frameIndex;
-  
+  lock.unlock();
+
   DEBUG_YUV("videoHandlerYUV::loadRawYUVData %d Done", frameIndex);
   return true;
 }
@@ -2156,8 +2208,8 @@ inline void YUVPlaneToRGB_440(const int w, const int h, const yuvMathParameters
     for (int y = 0; y < (h/2)-1; y++)
     {
       // Get the next U/V sample
-      int nextUSample = getValueFromSource(srcU, y*w+x, bps, bigEndian);
-      int nextVSample = getValueFromSource(srcV, y*w+x, bps, bigEndian);
+      int nextUSample = getValueFromSource(srcU, (y+1)*w+x, bps, bigEndian);
+      int nextVSample = getValueFromSource(srcV, (y+1)*w+x, bps, bigEndian);
       if (applyMathChroma)
       {
         nextUSample = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextUSample, inMax);
@@ -2505,17 +2557,24 @@ inline void YUVPlaneToRGB_410(const int w, const int h, const yuvMathParameters
     {
       // We process 4*4 values per U/V value
 
-      // Get the next U/V sample for this line and the next one
-      int nextU    = (x < wq-1) ? getValueFromSource(srcU, y*wq+x+1, bps, bigEndian) : curU;
-      int nextV    = (x < wq-1) ? getValueFromSource(srcV, y*wq+x+1, bps, bigEndian) : curV;
-      int nextU_NL = (x < wq-1) ? getValueFromSource(srcU, (y+1)*wq+x+1, bps, bigEndian) : curU_NL;
-      int nextV_NL = (x < wq-1) ? getValueFromSource(srcV, (y+1)*wq+x+1, bps, bigEndian) : curV_NL;
-      if (applyMathChroma)
+      // Get the next U/V sample for this line and the next one. At the right border, there is no next sample (sample and hold).
+      int nextU    = curU;
+      int nextV    = curV;
+      int nextU_NL = curU_NL;
+      int nextV_NL = curV_NL;
+      if (x < wq-1)
       {
-        nextU    = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextU, inMax);
-        nextV    = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextV, inMax);
-        nextU_NL = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextU_NL, inMax);
-        nextV_NL = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextV_NL, inMax);
+        nextU    = getValueFromSource(srcU, y*wq+x+1, bps, bigEndian);
+        nextV    = getValueFromSource(srcV, y*wq+x+1, bps, bigEndian);
+        nextU_NL = (y < hq-1) ? getValueFromSource(srcU, (y+1)*wq+x+1, bps, bigEndian) : nextU;
+        nextV_NL = (y < hq-1) ? getValueFromSource(srcV, (y+1)*wq+x+1, bps, bigEndian) : nextV;
+        if (applyMathChroma)
+        {
+          nextU    = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextU, inMax);
+          nextV    = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextV, inMax);
+          nextU_NL = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextU_NL, inMax);
+          nextV_NL = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextV_NL, inMax);
+        }
       }
 
       // Now we interpolate and set the RGB values for the 4x4 pixels
@@ -2677,6 +2736,220 @@ inline void YUVPlaneToRGB_411(const int w, const int h, const yuvMathParameters
   }
 }
 
+// Read one line of chroma samples from src into dst and apply the YUV math (if required).
+inline void readChromaLine(const unsigned char * restrict src, int * restrict dst, const int wC, const yuvMathParameters math, const int inMax, const int bps, const bool bigEndian)
+{
+  const bool applyMath = math.yuvMathRequired();
+  for (int x = 0; x < wC; x++)
+  {
+    dst[x] = getValueFromSource(src, x, bps, bigEndian);
+    if (applyMath)
+      dst[x] = transformYUV(math.invert, math.scale, math.offset, dst[x], inMax);
+  }
+}
+
+// Up-sample the chroma of one line (luma line y) to full resolution (one value per luma sample).
+// curLine is the chroma line y/subV and nextLine is the line below it (or identical to curLine for the last line).
+// The interpolation is identical to the one in the YUVPlaneToRGB_4xx functions.
+inline void upsampleChromaLine(const int * restrict curLine, const int * restrict nextLine, int * restrict tmpLine, int * restrict dst, const int w, const int y,
+                               const int subH, const int subV, const InterpolationMode interpolation)
+{
+  const int wC = w / subH;
+  const int yPos = y % subV;
+
+  // First, perform the vertical interpolation
+  const int * restrict verLine = curLine;
+  if (yPos != 0 && nextLine != curLine)
+  {
+    for (int x = 0; x < wC; x++)
+      tmpLine[x] = (subV == 2) ? interpolateUVSample(interpolation, curLine[x], nextLine[x]) : interpolateUVSampleQ(interpolation, curLine[x], nextLine[x], yPos);
+    verLine = tmpLine;
+  }
+
+  // Horizontal interpolation. For the last chroma sample there is no next sample. Just sample and hold.
+  if (subH == 1)
+  {
+    memcpy(dst, verLine, w * sizeof(int));
+    return;
+  }
+  for (int x = 0; x < wC; x++)
+  {
+    dst[x*subH] = verLine[x];
+    const int next = (x < wC-1) ? verLine[x+1] : verLine[x];
+    for (int xPos = 1; xPos < subH; xPos++)
+      dst[x*subH+xPos] = (subH == 2) ? interpolateUVSample(interpolation, verLine[x], next) : interpolateUVSampleQ(interpolation, verLine[x], next, xPos);
+  }
+
+  if (subH == 2 && subV == 2 && yPos == 1 && nextLine != curLine)
+  {
+    // For 4:2:0, the samples between 4 chroma samples are interpolated in 2D (and not separately)
+    for (int x = 0; x < wC-1; x++)
+      dst[x*2+1] = interpolateUVSample2D(interpolation, curLine[x], curLine[x+1], nextLine[x], nextLine[x+1]);
+  }
+}
+
+// All parameters for the line based conversion of planar YUV data to RGB (YUVPlaneToRGB_Lines)
+struct lineConversionParameters
+{
+  int w, h;
+  yuvPixelFormat format;
+  yuvMathParameters mathY, mathC;
+  const unsigned char *srcY, *srcU, *srcV;
+  unsigned char *dst;
+  int RGBConv[5];
+  int inMax;
+  InterpolationMode interpolation;
+  // The vectorized line conversion function (see yuvConversionSIMD.h). If this is nullptr, the scalar conversion is used.
+  YUV_SIMD::convertLineFunction convertLine;
+};
+
+// Convert the lines yStart to yEnd (exclusive) of the planar YUV data to RGB line by line. The chroma is up-sampled to
+// a full resolution line first. Every line only depends on the source data so the lines can be converted in parallel.
+// The output is bit-identical to the YUVPlaneToRGB_4xx functions.
+void YUVPlaneToRGB_Lines(const lineConversionParameters &p, const int yStart, const int yEnd)
+{
+  const int w = p.w;
+  const int bps = p.format.bitsPerSample;
+  const bool bigEndian = p.format.bigEndian;
+  const int subH = p.format.getSubsamplingHor();
+  const int subV = p.format.getSubsamplingVer();
+  const int wC = w / subH;
+  const int hC = p.h / subV;
+  const int bytesPerSample = (bps > 8) ? 2 : 1;
+
+  // The line conversion function reads luma samples directly from the source if they are in the right format (8 bit
+  // or 16 bit little endian). Otherwise, we convert each line into this format first.
+  const bool applyMathLuma = p.mathY.yuvMathRequired();
+  const bool convertLumaLine = applyMathLuma || (bps > 8 && bigEndian);
+
+  // Line buffers for the U/V chroma lines (current and next), the vertical interpolation and the up-sampled lines
+  QVector<int> chromaBuffer(wC * 6 + w * 2);
+  int *curU = chromaBuffer.data();
+  int *curV = curU + wC;
+  int *nextU = curV + wC;
+  int *nextV = nextU + wC;
+  int *tmpU = nextV + wC;
+  int *tmpV = tmpU + wC;
+  int *lineU = tmpV + wC;
+  int *lineV = lineU + w;
+  QByteArray lumaLine(convertLumaLine ? w * bytesPerSample : 0, 0);
+
+  int loadedChromaLine = -1;
+  for (int y = yStart; y < yEnd; y++)
+  {
+    const int yC = y / subV;
+    const bool hasNextLine = (yC < hC-1);
+    if (yC != loadedChromaLine)
+    {
+      readChromaLine(p.srcU + yC * wC * bytesPerSample, curU, wC, p.mathC, p.inMax, bps, bigEndian);
+      readChromaLine(p.srcV + yC * wC * bytesPerSample, curV, wC, p.mathC, p.inMax, bps, bigEndian);
+      if (subV > 1 && hasNextLine)
+      {
+        readChromaLine(p.srcU + (yC+1) * wC * bytesPerSample, nextU, wC, p.mathC, p.inMax, bps, bigEndian);
+        readChromaLine(p.srcV + (yC+1) * wC * bytesPerSample, nextV, wC, p.mathC, p.inMax, bps, bigEndian);
+      }
+      loadedChromaLine = yC;
+    }
+    upsampleChromaLine(curU, hasNextLine ? nextU : curU, tmpU, lineU, w, y, subH, subV, p.interpolation);
+    upsampleChromaLine(curV, hasNextLine ? nextV : curV, tmpV, lineV, w, y, subH, subV, p.interpolation);
+
+    const unsigned char * restrict lumaSrc = p.srcY + y * w * bytesPerSample;
+    if (convertLumaLine)
+    {
+      unsigned char *lumaDst = (unsigned char*)lumaLine.data();
+      for (int x = 0; x < w; x++)
+      {
+        int valY = getValueFromSource(lumaSrc, x, bps, bigEndian);
+        if (applyMathLuma)
+          valY = transformYUV(p.mathY.invert, p.mathY.scale, p.mathY.offset, valY, p.inMax);
+        if (bps > 8)
+        {
+          lumaDst[x*2] = valY & 0xff;
+          lumaDst[x*2+1] = valY >> 8;
+        }
+        else
+          lumaDst[x] = valY;
+      }
+      lumaSrc = lumaDst;
+    }
+
+    // Convert as much as possible using the vectorized function. Convert the rest of the line here.
+    unsigned char * restrict dstLine = p.dst + y * w * 4;
+    const int nrConverted = (p.convertLine != nullptr) ? p.convertLine(lumaSrc, lineU, lineV, dstLine, w, p.RGBConv, bps) : 0;
+    for (int x = nrConverted; x < w; x++)
+    {
+      int valR, valG, valB;
+      convertYUVToRGB8Bit(getValueFromSource(lumaSrc, x, bps, false), lineU[x], lineV[x], valR, valG, valB, p.RGBConv, bps);
+      dstLine[x*4  ] = valB;
+      dstLine[x*4+1] = valG;
+      dstLine[x*4+2] = valR;
+      dstLine[x*4+3] = 255;
+    }
+  }
+}
+
+// The thread pool that is shared by all videoHandlerYUV instances for the stripe-parallel conversion.
+Q_GLOBAL_STATIC(QThreadPool, conversionThreadPool)
+// The maximum number of threads (including the calling thread) that work on the conversion of one frame.
+static QAtomicInt nrConversionThreads(1);
+// Cache the raw YUV data instead of the converted image?
+static QAtomicInt cacheRawYUVData(0);
+
+// Each stripe should at least have this many lines. For smaller stripes, the overhead of the threading is too big.
+#define CONVERSION_MIN_LINES_PER_STRIPE 64
+
+// How many stripes should a frame with the given height be split into?
+int getNrConversionStripes(const int h, const bool multiThreaded)
+{
+  if (!multiThreaded)
+    return 1;
+  return clip(h / CONVERSION_MIN_LINES_PER_STRIPE, 1, int(nrConversionThreads.load()));
+}
+
+// Convert the frame in nrStripes horizontal stripes. The borders of the stripes are aligned to the vertical chroma
+// subsampling. The first stripe is converted in the calling thread. All others are converted in the conversionThreadPool.
+void YUVPlaneToRGB_Stripes(const lineConversionParameters &p, const int nrStripes)
+{
+  const int subV = p.format.getSubsamplingVer();
+  const int linesPerStripe = ((p.h / subV + nrStripes - 1) / nrStripes) * subV;
+
+  QList<QFuture<void>> stripeFutures;
+  for (int i = 1; i < nrStripes; i++)
+  {
+    const int yStart = i * linesPerStripe;
+    const int yEnd = std::min(yStart + linesPerStripe, p.h);
+    if (yStart < yEnd)
+      stripeFutures.append(QtConcurrent::run(conversionThreadPool(), YUVPlaneToRGB_Lines, p, yStart, yEnd));
+  }
+
+  YUVPlaneToRGB_Lines(p, 0, std::min(linesPerStripe, p.h));
+  for (QFuture<void> &f : stripeFutures)
+    f.waitForFinished();
+}
+
+void videoHandlerYUV::updateConversionSettings()
+{
+  QSettings settings;
+  settings.beginGroup("VideoCache");
+  int nrThreads = settings.value("ConversionThreads", getOptimalThreadCount()).toInt();
+  const bool cacheRawData = settings.value("CacheRawData", false).toBool();
+  settings.endGroup();
+  if (nrThreads < 1)
+    nrThreads = 1;
+
+  // The calling thread converts one of the stripes
+  nrConversionThreads.store(nrThreads);
+  conversionThreadPool()->setMaxThreadCount(std::max(nrThreads - 1, 1));
+
+  // Frames that are already cached stay in the cache they are in. Only new frames are affected.
+  cacheRawYUVData.store(cacheRawData ? 1 : 0);
+}
+
+bool videoHandlerYUV::useRawDataCache() const
+{
+  return cacheRawYUVData.load() != 0;
+}
+
 bool videoHandlerYUV::convertYUVPackedToPlanar(const QByteArray &sourceBuffer, QByteArray &targetBuffer, const QSize &curFrameSize, yuvPixelFormat &sourceBufferFormat)
 {
   const yuvPixelFormat format = sourceBufferFormat;
@@ -2790,7 +3063,7 @@ bool videoHandlerYUV::convertYUVPackedToPlanar(const QByteArray &sourceBuffer, Q
   return true;
 }
 
-bool videoHandlerYUV::convertYUVPlanarToRGB(const QByteArray &sourceBuffer, uchar *targetBuffer, const QSize &curFrameSize, const yuvPixelFormat &sourceBufferFormat) const
+bool videoHandlerYUV::convertYUVPlanarToRGB(const QByteArray &sourceBuffer, uchar *targetBuffer, const QSize &curFrameSize, const yuvPixelFormat &sourceBufferFormat, bool multiThreaded) const
 {
   // These are constant for the runtime of this function. This way, the compiler can optimize the
   // hell out of this function.
@@ -2866,15 +3139,6 @@ bool videoHandlerYUV::convertYUVPlanarToRGB(const QByteArray &sourceBuffer, ucha
     const bool uPlaneFirst = (format.planeOrder == Order_YUV || format.planeOrder == Order_YUVA);
 
     // We are displaying all components, so we have to perform conversion to RGB (possibly including interpolation and YUV math)
-    if (format.chromaOffset[0] != 0 || format.chromaOffset[1])
-    {
-      // We have to perform pre-filtering for the U and V positions, because there is an offset between the pixel positions of Y and U/V
-      unsigned char * restrict srcY = (unsigned char*)sourceBuffer.data();
-      unsigned char * restrict srcU = uPlaneFirst ? srcY + nrBytesLumaPlane : srcY + nrBytesLumaPlane + nrBytesChromaPlane;
-      unsigned char * restrict srcV = uPlaneFirst ? srcY + nrBytesLumaPlane + nrBytesChromaPlane: srcY + nrBytesLumaPlane;
-      UVPlaneResamplingChromaOffset(format, w / format.getSubsamplingHor(), h / format.getSubsamplingVer(), srcU, srcV);
-    }
-
     // Get/set the parameters used for YUV -> RGB conversion
     const int RGBConv[5] = { 76309,                                                                                                                 //yMult
       (yuvColorConversionType == BT601) ? 104597 : (yuvColorConversionType == BT2020) ? 110013 : 117489,  //rvMult
@@ -2888,7 +3152,30 @@ bool videoHandlerYUV::convertYUVPlanarToRGB(const QByteArray &sourceBuffer, ucha
     const unsigned char * restrict srcU = uPlaneFirst ? srcY + nrBytesLumaPlane : srcY + nrBytesLumaPlane + nrBytesChromaPlane;
     const unsigned char * restrict srcV = uPlaneFirst ? srcY + nrBytesLumaPlane + nrBytesChromaPlane: srcY + nrBytesLumaPlane;
 
-    if (format.subsampling == YUV_444)
+    QByteArray resampledChroma;
+    if (format.chromaOffset[0] != 0 || format.chromaOffset[1])
+    {
+      // We have to perform pre-filtering for the U and V positions, because there is an offset between the pixel positions of Y and U/V.
+      // The resampling works in place. Do it on a copy of the chroma planes so that the source buffer (which may be shared with
+      // the raw data in the cache) is not modified.
+      resampledChroma = QByteArray((const char*)srcY + nrBytesLumaPlane, nrBytesChromaPlane * 2);
+      unsigned char *resampledU = (unsigned char*)resampledChroma.data() + (uPlaneFirst ? 0 : nrBytesChromaPlane);
+      unsigned char *resampledV = (unsigned char*)resampledChroma.data() + (uPlaneFirst ? nrBytesChromaPlane : 0);
+      UVPlaneResamplingChromaOffset(format, w / format.getSubsamplingHor(), h / format.getSubsamplingVer(), resampledU, resampledV);
+      srcU = resampledU;
+      srcV = resampledV;
+    }
+
+    // Use the line based conversion if the CPU supports the vectorized conversion or if the frame is converted
+    // in multiple stripes in parallel. The result is identical.
+    const YUV_SIMD::convertLineFunction convertLine = YUV_SIMD::getConvertLineFunction();
+    const int nrStripes = getNrConversionStripes(h, multiThreaded);
+    if ((convertLine != nullptr || nrStripes > 1) && format.subsampling != YUV_400)
+    {
+      const lineConversionParameters p = {w, h, format, mathY, mathC, srcY, srcU, srcV, dst, {RGBConv[0], RGBConv[1], RGBConv[2], RGBConv[3], RGBConv[4]}, inputMax, interpolation, convertLine};
+      YUVPlaneToRGB_Stripes(p, nrStripes);
+    }
+    else if (format.subsampling == YUV_444)
       YUVPlaneToRGB_444(componentSizeLuma, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, inputMax, bps, format.bigEndian);
     else if (format.subsampling == YUV_422)
       YUVPlaneToRGB_422(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, inputMax, interpolation, bps, format.bigEndian);
@@ -2911,7 +3198,7 @@ bool videoHandlerYUV::convertYUVPlanarToRGB(const QByteArray &sourceBuffer, ucha
 
 // Convert the given raw YUV data in sourceBuffer (using srcPixelFormat) to image (RGB-888), using the
 // buffer tmpRGBBuffer for intermediate RGB values.
-void videoHandlerYUV::convertYUVToImage(const QByteArray &sourceBuffer, QImage &outputImage, const yuvPixelFormat &yuvFormat, const QSize &curFrameSize)
+void videoHandlerYUV::convertYUVToImage(const QByteArray &sourceBuffer, QImage &outputImage, const yuvPixelFormat &yuvFormat, const QSize &curFrameSize, bool multiThreaded)
 {
   if (!canConvertToRGB(yuvFormat, curFrameSize))
   {
@@ -2953,9 +3240,9 @@ void videoHandlerYUV::convertYUVToImage(const QByteArray &sourceBuffer, QImage &
         !mathParameters[Luma].yuvMathRequired() && !mathParameters[Chroma].yuvMathRequired() )
       // 8 bit 4:2:0, nearest neighbor, chroma offset (0,1) (the default for 4:2:0), all components displayed and no yuv math.
       // We can use a specialized function for this.
-      convOK = convertYUV420ToRGB(sourceBuffer, outputImage.bits(), curFrameSize, yuvFormat);
+      convOK = convertYUV420ToRGB(sourceBuffer, outputImage.bits(), curFrameSize, yuvFormat, multiThreaded);
     else
-      convOK = convertYUVPlanarToRGB(sourceBuffer, outputImage.bits(), curFrameSize, yuvFormat);
+      convOK = convertYUVPlanarToRGB(sourceBuffer, outputImage.bits(), curFrameSize, yuvFormat, multiThreaded);
   }
   else
   {
@@ -2966,7 +3253,7 @@ void videoHandlerYUV::convertYUVToImage(const QByteArray &sourceBuffer, QImage &
     convOK &= convertYUVPackedToPlanar(sourceBuffer, tmpPlanarYUVSource, curFrameSize, bufferPixelFormat);
 
     if (convOK)
-      convOK &= convertYUVPlanarToRGB(tmpPlanarYUVSource, outputImage.bits(), curFrameSize, bufferPixelFormat);
+      convOK &= convertYUVPlanarToRGB(tmpPlanarYUVSource, outputImage.bits(), curFrameSize, bufferPixelFormat, multiThreaded);
   }
 
   assert(convOK);
@@ -3056,7 +3343,7 @@ void videoHandlerYUV::getPixelValue(const QPoint &pixelPos, unsigned int &Y, uns
 #if SSE_CONVERSION
 bool videoHandlerYUV::convertYUV420ToRGB(const byteArrayAligned &sourceBuffer, byteArrayAligned &targetBuffer)
 #else
-bool videoHandlerYUV::convertYUV420ToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &size, const yuvPixelFormat format)
+bool videoHandlerYUV::convertYUV420ToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &size, const yuvPixelFormat format, bool multiThreaded)
 #endif
 {
   const int frameWidth = size.width();
@@ -3192,6 +3479,17 @@ bool videoHandlerYUV::convertYUV420ToRGB(const QByteArray &sourceBuffer, unsigne
   const unsigned char * restrict srcU = uPplaneFirst ? srcY + componentLenghtY : srcY + componentLenghtY + componentLengthUV;
   const unsigned char * restrict srcV = uPplaneFirst ? srcY + componentLenghtY + componentLengthUV : srcY + componentLenghtY;
 
+  // Use the line based conversion (nearest neighbor, no YUV math) if the CPU supports the vectorized conversion or if
+  // the frame is converted in multiple stripes in parallel. The result is identical.
+  const YUV_SIMD::convertLineFunction convertLine = YUV_SIMD::getConvertLineFunction();
+  const int nrStripes = getNrConversionStripes(frameHeight, multiThreaded);
+  if (convertLine != nullptr || nrStripes > 1)
+  {
+    const lineConversionParameters p = {frameWidth, frameHeight, format, yuvMathParameters(), yuvMathParameters(), srcY, srcU, srcV, dst, {RGBConv[0], RGBConv[1], RGBConv[2], RGBConv[3], RGBConv[4]}, 255, NearestNeighborInterpolation, convertLine};
+    YUVPlaneToRGB_Stripes(p, nrStripes);
+    return true;
+  }
+
   int yh;
   for (yh=0; yh < frameHeight / 2; yh++)
   {
@@ -3648,8 +3946,13 @@ void videoHandlerYUV::setFrameSize(const QSize &size)
 
 void videoHandlerYUV::invalidateAllBuffers()
 {
+  // Release the data. It may point into a memory mapped file that is about to be reopened.
+  QMutexLocker lock(&requestDataMutex);
   currentFrameRawYUVData_frameIdx = -1;
+  currentFrameRawYUVData.clear();
   rawYUVData_frameIdx = -1;
+  rawYUVData.clear();
+  lock.unlock();
   videoHandler::invalidateAllBuffers();
 }
 
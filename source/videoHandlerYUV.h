@@ -231,6 +231,11 @@ public:
   virtual void setYUVPixelFormat(const YUV_Internals::yuvPixelFormat &fmt, bool emitSignal=false);
   virtual void setYUVColorConversion(YUV_Internals::ColorConversion conversion);
 
+  // Interactive requests (not caching) are converted in horizontal stripes by multiple threads from a shared thread pool.
+  // Load the maximum number of threads for this and whether the raw YUV data (instead of the converted image) is
+  // cached from the settings.
+  static void updateConversionSettings();
+
   // When loading a videoHandlerYUV from playlist file, this can be used to set all the parameters at once
   void loadValues(const QSize &frameSize, const QString &sourcePixelFormat);
 
@@ -312,6 +317,15 @@ protected:
   // will not be modified.
   virtual void loadFrameForCaching(int frameIndex, QImage &frameToCache) Q_DECL_OVERRIDE;
 
+  // Caching of the raw YUV data. A YUV frame (e.g. 4:2:0 8 bit) needs much less memory than the converted RGB32 image.
+  virtual bool useRawDataCache() const Q_DECL_OVERRIDE;
+  virtual unsigned int getRawDataCachingFrameSize() const Q_DECL_OVERRIDE { return getBytesPerFrame(); }
+  virtual bool loadRawDataForCaching(int frameIndex, QByteArray &rawDataToCache) Q_DECL_OVERRIDE;
+  // Convert the cached raw data. If no other thread is loading raw data, this also sets currentFrameRawYUVData so the
+  // values can be drawn without reloading.
+  virtual void convertCachedRawData(int frameIndex, const QByteArray &rawData, QImage &outputImage) Q_DECL_OVERRIDE;
+  virtual void convertRawDataForCaching(const QByteArray &rawData, QImage &frameToCache) Q_DECL_OVERRIDE;
+
 private:
 
   // Load the raw YUV data for the given frame index into currentFrameRawYUVData.
@@ -319,7 +333,8 @@ private:
   bool loadRawYUVData(int frameIndex);
 
   // Convert from YUV (which ever format is selected) to image (RGB-888)
-  void convertYUVToImage(const QByteArray &sourceBuffer, QImage &outputImage, const YUV_Internals::yuvPixelFormat &yuvFormat, const QSize &curFrameSize);
+  // If multiThreaded is set, the frame is converted in horizontal stripes in parallel (see updateConversionSettings()).
+  void convertYUVToImage(const QByteArray &sourceBuffer, QImage &outputImage, const YUV_Internals::yuvPixelFormat &yuvFormat, const QSize &curFrameSize, bool multiThreaded=false);
 
   // Set the new pixel format thread save (lock the mutex). We should also emit that something changed (can be disabled).
   void setSrcPixelFormat(YUV_Internals::yuvPixelFormat newFormat, bool emitChangedSignal=true);
@@ -329,11 +344,11 @@ private:
 #if SSE_CONVERSION
   bool convertYUV420ToRGB(const byteArrayAligned &sourceBuffer, byteArrayAligned &targetBuffer);
 #else
-  bool convertYUV420ToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &size, const YUV_Internals::yuvPixelFormat format);
+  bool convertYUV420ToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &size, const YUV_Internals::yuvPixelFormat format, bool multiThreaded=false);
 #endif
 
   bool convertYUVPackedToPlanar(const QByteArray &sourceBuffer, QByteArray &targetBuffer, const QSize &frameSize, YUV_Internals::yuvPixelFormat &sourceBufferFormat);
-  bool convertYUVPlanarToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &frameSize, const YUV_Internals::yuvPixelFormat &sourceBufferFormat) const;
+  bool convertYUVPlanarToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &frameSize, const YUV_Internals::yuvPixelFormat &sourceBufferFormat, bool multiThreaded=false) const;
   bool markDifferencesYUVPlanarToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &frameSize, const YUV_Internals::yuvPixelFormat &sourceBufferFormat) const;
 
 #if SSE_CONVERSION_420_ALT
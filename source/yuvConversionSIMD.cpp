@@ -0,0 +1,235 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "yuvConversionSIMD.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define YUV_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define YUV_SIMD_X86 0
+#endif
+
+// GCC and clang only allow the use of intrinsics of instruction sets that are enabled for the function.
+// Enable them per function so that the rest of YUView can still run on any x86 CPU.
+#if YUV_SIMD_X86 && defined(__GNUC__)
+#define YUV_SIMD_TARGET(set) __attribute__((target(set)))
+#else
+#define YUV_SIMD_TARGET(set)
+#endif
+
+namespace YUV_SIMD
+{
+
+  typedef enum
+  {
+    InstructionSet_Scalar,  // No vectorized kernels available. Use the scalar conversion.
+    InstructionSet_SSE41,
+    InstructionSet_AVX2
+  } InstructionSet;
+
+#if YUV_SIMD_X86
+
+  // Read 4 luma samples (8 or 16 bit) and zero extend them to 32 bit
+  YUV_SIMD_TARGET("sse4.1")
+  inline __m128i loadLuma4(const unsigned char *srcY, const bool sixteenBit)
+  {
+    if (sixteenBit)
+      return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)srcY));
+    int samples;
+    memcpy(&samples, srcY, 4);
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(samples));
+  }
+
+  // This kernel mirrors convertYUVToRGB8Bit for 4 pixels at a time. All products are calculated with
+  // 32 bit integers (_mm_mullo_epi32) and an arithmetic right shift, just like the scalar code.
+  YUV_SIMD_TARGET("sse4.1")
+  int convertLine_SSE41(const unsigned char *srcY, const int *srcU, const int *srcV, unsigned char *dst, int w, const int RGBConv[5], int bps)
+  {
+    // For more than 14 bit, the scalar conversion drops the two least significant bits of each sample first.
+    const int inputShift = (bps > 14) ? 2 : 0;
+    const int bpsConv = bps - inputShift;
+    const bool sixteenBit = (bps > 8);
+    const int bytesPerSample = sixteenBit ? 2 : 1;
+
+    const __m128i inShift  = _mm_cvtsi32_si128(inputShift);
+    const __m128i outShift = _mm_cvtsi32_si128(16 + bpsConv - 8);
+    const __m128i yOffset  = _mm_set1_epi32(16 << (bpsConv - 8));
+    const __m128i cZero    = _mm_set1_epi32(128 << (bpsConv - 8));
+    const __m128i yMult    = _mm_set1_epi32(RGBConv[0]);
+    const __m128i rvMult   = _mm_set1_epi32(RGBConv[1]);
+    const __m128i guMult   = _mm_set1_epi32(RGBConv[2]);
+    const __m128i gvMult   = _mm_set1_epi32(RGBConv[3]);
+    const __m128i buMult   = _mm_set1_epi32(RGBConv[4]);
+    const __m128i zero     = _mm_setzero_si128();
+    const __m128i max8Bit  = _mm_set1_epi32(255);
+    const __m128i alpha    = _mm_slli_epi32(max8Bit, 24);
+
+    int x = 0;
+    for (; x + 4 <= w; x += 4)
+    {
+      __m128i valY = _mm_srl_epi32(loadLuma4(srcY + x * bytesPerSample, sixteenBit), inShift);
+      __m128i valU = _mm_srl_epi32(_mm_loadu_si128((const __m128i*)(srcU + x)), inShift);
+      __m128i valV = _mm_srl_epi32(_mm_loadu_si128((const __m128i*)(srcV + x)), inShift);
+
+      const __m128i Y_tmp = _mm_mullo_epi32(_mm_sub_epi32(valY, yOffset), yMult);
+      const __m128i U_tmp = _mm_sub_epi32(valU, cZero);
+      const __m128i V_tmp = _mm_sub_epi32(valV, cZero);
+
+      __m128i R = _mm_sra_epi32(_mm_add_epi32(Y_tmp, _mm_mullo_epi32(V_tmp, rvMult)), outShift);
+      __m128i G = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(Y_tmp, _mm_mullo_epi32(U_tmp, guMult)), _mm_mullo_epi32(V_tmp, gvMult)), outShift);
+      __m128i B = _mm_sra_epi32(_mm_add_epi32(Y_tmp, _mm_mullo_epi32(U_tmp, buMult)), outShift);
+
+      R = _mm_min_epi32(_mm_max_epi32(R, zero), max8Bit);
+      G = _mm_min_epi32(_mm_max_epi32(G, zero), max8Bit);
+      B = _mm_min_epi32(_mm_max_epi32(B, zero), max8Bit);
+
+      // Each 32 bit value is one pixel in BGRA byte order
+      const __m128i BGRA = _mm_or_si128(_mm_or_si128(B, _mm_slli_epi32(G, 8)), _mm_or_si128(_mm_slli_epi32(R, 16), alpha));
+      _mm_storeu_si128((__m128i*)(dst + x * 4), BGRA);
+    }
+    return x;
+  }
+
+  // Read 8 luma samples (8 or 16 bit) and zero extend them to 32 bit
+  YUV_SIMD_TARGET("avx2")
+  inline __m256i loadLuma8(const unsigned char *srcY, const bool sixteenBit)
+  {
+    if (sixteenBit)
+      return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)srcY));
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)srcY));
+  }
+
+  // The same as convertLine_SSE41 but for 8 pixels at a time. The rest of the line is converted by the SSE4.1 kernel.
+  YUV_SIMD_TARGET("avx2")
+  int convertLine_AVX2(const unsigned char *srcY, const int *srcU, const int *srcV, unsigned char *dst, int w, const int RGBConv[5], int bps)
+  {
+    const int inputShift = (bps > 14) ? 2 : 0;
+    const int bpsConv = bps - inputShift;
+    const bool sixteenBit = (bps > 8);
+    const int bytesPerSample = sixteenBit ? 2 : 1;
+
+    const __m128i inShift  = _mm_cvtsi32_si128(inputShift);
+    const __m128i outShift = _mm_cvtsi32_si128(16 + bpsConv - 8);
+    const __m256i yOffset  = _mm256_set1_epi32(16 << (bpsConv - 8));
+    const __m256i cZero    = _mm256_set1_epi32(128 << (bpsConv - 8));
+    const __m256i yMult    = _mm256_set1_epi32(RGBConv[0]);
+    const __m256i rvMult   = _mm256_set1_epi32(RGBConv[1]);
+    const __m256i guMult   = _mm256_set1_epi32(RGBConv[2]);
+    const __m256i gvMult   = _mm256_set1_epi32(RGBConv[3]);
+    const __m256i buMult   = _mm256_set1_epi32(RGBConv[4]);
+    const __m256i zero     = _mm256_setzero_si256();
+    const __m256i max8Bit  = _mm256_set1_epi32(255);
+    const __m256i alpha    = _mm256_slli_epi32(max8Bit, 24);
+
+    int x = 0;
+    for (; x + 8 <= w; x += 8)
+    {
+      __m256i valY = _mm256_srl_epi32(loadLuma8(srcY + x * bytesPerSample, sixteenBit), inShift);
+      __m256i valU = _mm256_srl_epi32(_mm256_loadu_si256((const __m256i*)(srcU + x)), inShift);
+      __m256i valV = _mm256_srl_epi32(_mm256_loadu_si256((const __m256i*)(srcV + x)), inShift);
+
+      const __m256i Y_tmp = _mm256_mullo_epi32(_mm256_sub_epi32(valY, yOffset), yMult);
+      const __m256i U_tmp = _mm256_sub_epi32(valU, cZero);
+      const __m256i V_tmp = _mm256_sub_epi32(valV, cZero);
+
+      __m256i R = _mm256_sra_epi32(_mm256_add_epi32(Y_tmp, _mm256_mullo_epi32(V_tmp, rvMult)), outShift);
+      __m256i G = _mm256_sra_epi32(_mm256_add_epi32(_mm256_add_epi32(Y_tmp, _mm256_mullo_epi32(U_tmp, guMult)), _mm256_mullo_epi32(V_tmp, gvMult)), outShift);
+      __m256i B = _mm256_sra_epi32(_mm256_add_epi32(Y_tmp, _mm256_mullo_epi32(U_tmp, buMult)), outShift);
+
+      R = _mm256_min_epi32(_mm256_max_epi32(R, zero), max8Bit);
+      G = _mm256_min_epi32(_mm256_max_epi32(G, zero), max8Bit);
+      B = _mm256_min_epi32(_mm256_max_epi32(B, zero), max8Bit);
+
+      const __m256i BGRA = _mm256_or_si256(_mm256_or_si256(B, _mm256_slli_epi32(G, 8)), _mm256_or_si256(_mm256_slli_epi32(R, 16), alpha));
+      _mm256_storeu_si256((__m256i*)(dst + x * 4), BGRA);
+    }
+
+    // Convert what is left (up to 7 pixels) with the SSE4.1 kernel
+    return x + convertLine_SSE41(srcY + x * bytesPerSample, srcU + x, srcV + x, dst + x * 4, w - x, RGBConv, bps);
+  }
+
+  InstructionSet detectInstructionSet()
+  {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    const bool sse41   = (info[2] & (1 << 19)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx     = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    // AVX2 also requires that the OS saves the YMM registers on a context switch
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+    {
+      __cpuidex(info, 7, 0);
+      avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    const bool sse41 = __builtin_cpu_supports("sse4.1");
+    const bool avx2  = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2)
+      return InstructionSet_AVX2;
+    if (sse41)
+      return InstructionSet_SSE41;
+    return InstructionSet_Scalar;
+  }
+
+#else
+
+  InstructionSet detectInstructionSet() { return InstructionSet_Scalar; }
+
+#endif
+
+  // Detected once when the program is loaded
+  static const InstructionSet detectedInstructionSet = detectInstructionSet();
+
+  convertLineFunction getConvertLineFunction()
+  {
+#if YUV_SIMD_X86
+    if (detectedInstructionSet == InstructionSet_AVX2)
+      return &convertLine_AVX2;
+    if (detectedInstructionSet == InstructionSet_SSE41)
+      return &convertLine_SSE41;
+#endif
+    return nullptr;
+  }
+}
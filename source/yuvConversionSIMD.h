@@ -0,0 +1,53 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef YUVCONVERSIONSIMD_H
+#define YUVCONVERSIONSIMD_H
+
+/* Vectorized kernels for the YUV to RGB conversion in videoHandlerYUV.
+ * The instruction set is chosen once at runtime (using CPUID). All kernels perform exactly the same
+ * integer arithmetic as the scalar conversion (convertYUVToRGB8Bit) so the output is bit-identical.
+ */
+namespace YUV_SIMD
+{
+  // Convert one line of w pixels from YUV to RGB (BGRA, 8 bit per component) using the RGBConv factors of videoHandlerYUV.
+  // srcY contains the luma samples (8 bit or, if bps > 8, 16 bit little endian). srcU and srcV contain one (already
+  // up-sampled) chroma value per luma sample. Only multiples of the vector width are converted. The number of converted
+  // pixels is returned. The remaining pixels at the end of the line have to be converted by the caller.
+  typedef int (*convertLineFunction)(const unsigned char *srcY, const int *srcU, const int *srcV, unsigned char *dst, int w, const int RGBConv[5], int bps);
+
+  // Get the fastest line conversion function for this CPU. Returns nullptr if no vectorized kernel can be used.
+  convertLineFunction getConvertLineFunction();
+}
+
+#endif // YUVCONVERSIONSIMD_H